@@ -0,0 +1,77 @@
+/*
+ * Ring_Buffer.h
+ *
+ *  Created on: Nov 28, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L1_RING_BUFFER_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L1_RING_BUFFER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h" // Include FreeRTOS main header
+#include "task.h"     // Include FreeRTOS task notifications
+
+/*
+ * Single-producer/single-consumer byte ring.
+ * The producer (an ISR) only writes head, the consumer (one task) only writes
+ * tail, so neither side needs a critical section. Indices run freely and are
+ * masked on access, which requires a power-of-two size.
+ */
+typedef struct {
+    uint8_t* buffer;          // Backing storage
+    uint32_t mask;            // Size - 1
+    volatile uint32_t head;   // Total bytes written (producer owned)
+    volatile uint32_t tail;   // Total bytes read (consumer owned)
+    volatile TaskHandle_t consumer; // Task notified when the ring becomes non-empty
+} RingBuffer;
+
+/**
+ * @brief Initializes a ring over caller-provided storage.
+ * @param ring The ring to initialize.
+ * @param storage Backing buffer.
+ * @param size Size of the backing buffer, must be a power of two.
+ */
+void ring_init(RingBuffer* ring, uint8_t* storage, uint32_t size);
+
+/**
+ * @brief Producer side: copies bytes into the ring. Safe to call from an ISR.
+ *        Wakes the consumer only when the ring goes from empty to non-empty.
+ * @return Number of bytes written, less than length if the ring was full.
+ */
+uint16_t ring_write_ISR(RingBuffer* ring, const uint8_t* data, uint16_t length,
+                        BaseType_t* pxHigherPriorityTaskWoken);
+
+/**
+ * @brief Consumer side: returns the largest contiguous readable span without copying.
+ *        The bytes stay in the ring until ring_consume() is called.
+ * @param span Set to the start of the span.
+ * @return Number of bytes in the span (0 when empty).
+ */
+uint16_t ring_read_span(RingBuffer* ring, const uint8_t** span);
+
+/**
+ * @brief Consumer side: releases bytes previously obtained with ring_read_span().
+ */
+void ring_consume(RingBuffer* ring, uint16_t length);
+
+/**
+ * @brief Consumer side: copies up to length bytes out of the ring.
+ * @return Number of bytes copied.
+ */
+uint16_t ring_read(RingBuffer* ring, uint8_t* data, uint16_t length);
+
+/**
+ * @brief Consumer side: blocks the calling task until the ring holds data.
+ * @return true if data is available, false on timeout.
+ */
+bool ring_wait(RingBuffer* ring, TickType_t timeout);
+
+/**
+ * @brief Number of bytes currently stored in the ring.
+ */
+uint32_t ring_count(const RingBuffer* ring);
+
+#endif /* INC_USER_L1_RING_BUFFER_H_ */
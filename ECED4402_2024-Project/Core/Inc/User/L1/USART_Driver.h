@@ -8,11 +8,101 @@
 #ifndef INC_USER_L1_USART_DRIVER_H_
 #define INC_USER_L1_USART_DRIVER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "FreeRTOS.h"
 #include "queue.h"
 
-extern QueueHandle_t Queue_extern_UART;
-extern QueueHandle_t Queue_hostPC_UART;
+// Receive modes for the external (sensor) USART
+#define USART_RX_MODE_IT    0 // One interrupt per received byte
+#define USART_RX_MODE_DMA   1 // Circular DMA, one event per idle line / half / full buffer (extern only)
+#define USART_RX_MODE_LL    2 // Register-level RXNE interrupt, HAL bypassed on receive
+
+// Set the receive mode used by configure_usart_extern() and configure_usart_hostPC()
+#define USART_EXTERN_RX_MODE USART_RX_MODE_DMA
+#define USART_HOSTPC_RX_MODE USART_RX_MODE_LL
+
+// Set to 1 to add USART1 as a second sensor bus. USART1 must first be enabled
+// in CubeMX (huart1, USART1_IRQn calling usart_irq_handler(USART_PORT_EXTERN2)).
+#define USART_EXTERN2_ENABLE  0
+#define USART_EXTERN2_RX_MODE USART_RX_MODE_LL
+
+// Set to 1 to measure USART interrupt handler cost with the DWT cycle counter
+#define USART_IRQ_PROFILING 0
+
+// Buffers carrying received bytes from the UART ISRs to the parser tasks
+#define USART_RX_BACKEND_QUEUE  0 // FreeRTOS queue, one kernel call per byte
+#define USART_RX_BACKEND_RING   1 // Lock-free SPSC ring, bulk reads
+#define USART_RX_BACKEND_STREAM 2 // FreeRTOS stream buffer, reader wakes at a trigger level
+
+// Set the receive backend used by both ports
+#define USART_RX_BACKEND USART_RX_BACKEND_RING
+
+// Stream buffer backend: bytes that must arrive before the parser task is woken
+#define USART_EXTERN_RX_TRIGGER_LEVEL 22 // One "$TURBD,03,00001234,*,xx\n" data frame
+#define USART_EXTERN2_RX_TRIGGER_LEVEL USART_EXTERN_RX_TRIGGER_LEVEL
+#define USART_HOSTPC_RX_TRIGGER_LEVEL 1  // Host commands are typed by hand
+
+// Stream buffer backend: longest a reader waits below the trigger level, so
+// frames shorter than the trigger level (acks, reset) are not held back
+#define USART_RX_STREAM_FLUSH_MS 10
+
+// Flow control on the sensor link
+#define USART_FLOW_NONE    0
+#define USART_FLOW_RTSCTS  1 // SensorRTS/SensorCTS GPIOs (PC8/PC9), active low
+#define USART_FLOW_XONXOFF 2 // In-band XON/XOFF, for boards without the extra wires
+
+#define USART_EXTERN_FLOW_CONTROL USART_FLOW_NONE
+
+// RX channel levels (bytes) at which the peer is throttled and released
+#define USART_RX_HIGH_WATERMARK 64
+#define USART_RX_LOW_WATERMARK  16
+
+// Ports in the driver's descriptor table
+enum UsartPort {
+	USART_PORT_EXTERN,  // Sensor link (USART6)
+	USART_PORT_HOSTPC,  // Host PC link (USART2)
+#if USART_EXTERN2_ENABLE
+	USART_PORT_EXTERN2, // Second sensor link (USART1)
+#endif
+	USART_PORT_COUNT
+};
+
+// Link health counters for one port, updated from the ISRs
+struct UsartStats {
+	uint32_t bytes_rx;       // Bytes handed to the RX channel
+	uint32_t bytes_tx;       // Bytes queued on the DMA transmit engine
+	uint32_t overrun_errors; // ORE: a byte arrived before the previous one was read
+	uint32_t framing_errors; // FE
+	uint32_t noise_errors;   // NE
+	uint32_t parity_errors;  // PE
+	uint32_t rx_dropped;     // Bytes lost because the RX channel was full
+	uint32_t tx_dropped;     // Bytes that could not be queued for transmission
+	uint32_t rx_peak_level;  // Highest RX channel occupancy seen, in bytes
+	uint32_t rearm_failures; // Receive restarts refused by the HAL
+	uint32_t rx_throttles;   // Times the peer was told to stop sending
+	uint32_t tx_pauses;      // Times the peer told us to stop sending
+	uint32_t tx_refused;     // DMA bursts the HAL refused to start, retried later
+};
+
+// One piece of an outgoing frame for usart_tx_writev()
+struct UsartTxSegment {
+	const uint8_t* data;
+	uint16_t length;
+};
+
+// Cycles spent in a port's USART interrupt handler (USART_IRQ_PROFILING)
+struct UsartIrqProfile {
+	uint32_t count;        // Interrupts handled
+	uint32_t total_cycles; // Sum of cycles over all interrupts
+	uint32_t max_cycles;   // Most expensive single interrupt
+};
+
+void configure_usart_port(enum UsartPort port);
+void request_usart_read(enum UsartPort port);
+uint16_t read_usart_bytes(enum UsartPort port, uint8_t* data, uint16_t length, TickType_t timeout);
+const char* usart_port_name(enum UsartPort port);
 
 void configure_usart_extern(void);
 void configure_usart_hostPC(void);
@@ -20,6 +110,25 @@ void configure_usart_hostPC(void);
 void request_sensor_read(void);
 void request_hostPC_read(void);
 
+uint16_t read_sensor_bytes(uint8_t* data, uint16_t length, TickType_t timeout);
+uint16_t read_hostPC_bytes(uint8_t* data, uint16_t length, TickType_t timeout);
+
 void printStr_extern(char * str);
 
+void get_usart_stats(enum UsartPort port, struct UsartStats* stats);
+
+uint32_t usart_get_baud(enum UsartPort port);
+uint32_t usart_max_baud(enum UsartPort port);
+bool usart_set_baud(enum UsartPort port, uint32_t baud, TickType_t timeout);
+
+void usart_irq_handler(enum UsartPort port);
+void get_usart_irq_profile(enum UsartPort port, struct UsartIrqProfile* profile);
+
+void configure_usart_tx(enum UsartPort port);
+bool usart_tx_write(enum UsartPort port, const uint8_t* data, uint16_t length, TickType_t timeout);
+bool usart_tx_writev(enum UsartPort port, const struct UsartTxSegment* segments, uint8_t count, TickType_t timeout);
+bool usart_tx_write_ISR(enum UsartPort port, const uint8_t* data, uint16_t length);
+bool usart_tx_flush(enum UsartPort port, TickType_t timeout);
+bool usart_tx_wait_ready(enum UsartPort port, TickType_t timeout);
+
 #endif /* INC_USER_L1_USART_DRIVER_H_ */
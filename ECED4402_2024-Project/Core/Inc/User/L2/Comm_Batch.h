@@ -0,0 +1,75 @@
+/*
+ * Comm_Batch.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_BATCH_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_BATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L2/Comm_Datalink.h"
+
+#define BATCH_MAX_COUNT     BINARY_BATCH_MAX // Readings the controller asks to have per frame, 0 or 1 disables batching
+#define BATCH_MAX_DELAY_MS  250 // Longest a reading may wait for the rest of its batch
+#define BATCH_DELAY_UNIT_MS 10  // Resolution of the delay in the batch request
+
+// The batch request carries both limits in its params field:
+// count in the low 4 bits, delay in BATCH_DELAY_UNIT_MS above them
+#define BATCH_PARAMS(count, delay_ms) ((uint16_t)(((delay_ms) / BATCH_DELAY_UNIT_MS) << 4 | ((count) & 0x0F)))
+#define BATCH_PARAMS_COUNT(params)    ((params) & 0x0F)
+#define BATCH_PARAMS_DELAY_MS(params) (((params) >> 4) * BATCH_DELAY_UNIT_MS)
+
+// Batching counters, kept on both sides
+struct BatchStats {
+    uint32_t max_count;     // Negotiated limits, 0 when off
+    uint32_t max_delay_ms;
+    uint32_t frames;        // Platform: batch frames sent. Controller: received
+    uint32_t readings;      // Readings carried in those frames
+    uint32_t flush_full;    // Platform: batches sent because they reached max_count
+    uint32_t flush_delay;   // Platform: batches sent because their first reading waited max_delay_ms
+};
+
+/**
+ * @brief Creates the flush timer. Called once from
+ *        initialize_sensor_datalink().
+ */
+void initialize_batching(void);
+
+/**
+ * @brief Platform side of the handshake: answers with the limits it accepts
+ *        and has the timer task send what is waiting, then apply them. Refused (0) on an ASCII link
+ *        and in reliable mode, where each frame is acknowledged on its own.
+ * @param params Count and delay, see BATCH_PARAMS().
+ */
+void batch_handle_request(uint16_t params);
+
+/**
+ * @brief Controller side: records the limits the platform accepted.
+ */
+void batch_start(uint16_t params);
+
+/**
+ * @brief Platform side: adds a data frame to the batch, sending the batch if
+ *        it is full. The first reading of a batch starts the delay timer.
+ * @param message The data frame, already delta coded.
+ * @return False if batching is off or the frame is numbered; send it alone.
+ */
+bool batch_add(const struct CommMessage* message);
+
+/**
+ * @brief Controller side: counts a batch frame received.
+ * @param readings Readings it carried.
+ */
+void batch_record_received(uint8_t readings);
+
+/**
+ * @brief Copies the batching counters.
+ * @param stats Destination.
+ */
+void get_batch_stats(struct BatchStats* stats);
+
+#endif /* INC_USER_L2_COMM_BATCH_H_ */
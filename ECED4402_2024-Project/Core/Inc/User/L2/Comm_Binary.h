@@ -0,0 +1,138 @@
+/*
+ * Comm_Binary.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_BINARY_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_BINARY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L2/Comm_Schema.h"
+
+struct CommMessage; // Comm_Datalink.h
+
+// Set to 0 when building for the host or a simulator: CRC-32 is then computed
+// with a lookup table instead of the STM32 CRC unit. Both give the same result.
+#ifndef COMM_CRC_HARDWARE
+#define COMM_CRC_HARDWARE 1
+#endif
+
+// Integrity check closing a binary frame
+enum BinaryIntegrity {
+    BINARY_CRC16, // CRC-16/CCITT-FALSE, computed in software
+    BINARY_CRC32  // CRC-32/MPEG-2, the polynomial of the STM32 CRC unit
+};
+
+// A binary frame before stuffing is
+//   [sensor ID | address flag][address, only if flagged]
+//   [message ID | field flags][params as varint, absent if none]
+//   [sequence number as varint][timestamp as varint][CRC, most significant byte first]
+// The sequence number and timestamp are only there when their flag is set,
+// and imply the params field. The delta flag marks a compressed data frame,
+// see Comm_Delta.h.
+// A batch frame carries several sensor readings:
+//   [CNTRL | address flag][address, only if flagged][BINARY_BATCH_MESSAGEID][reading count]
+//   then per reading [sensor ID | reading flags][params as varint][timestamp as varint]
+//   [CRC]
+// where the timestamp is only there when the reading's timestamp flag is set.
+// Either frame is COBS encoded so it contains no zero byte, then terminated
+// by a single 0x00.
+#define BINARY_FLAG_ADDRESS      0x80 // In the sensor ID byte: a platform address follows it
+#define BINARY_FLAG_SEQ          0x80 // Reliable mode sequence number follows params
+#define BINARY_FLAG_TIMESTAMP    0x40 // Sample timestamp follows
+#define BINARY_FLAG_DELTA        0x20 // Params and timestamp are differences from the sensor's last reading
+#define BINARY_MESSAGEID_MASK    0x1F
+#define BINARY_FRAME_DELIMITER   0x00
+#define BINARY_VARINT_MAX_LENGTH 5  // 32-bit value, 7 bits per byte
+#define BINARY_SEQ_MAX_LENGTH    2  // 8-bit sequence number
+#define BINARY_SINGLE_MAX_RAW    (3 + BINARY_VARINT_MAX_LENGTH + BINARY_SEQ_MAX_LENGTH + BINARY_VARINT_MAX_LENGTH + 4)
+
+#define BINARY_BATCH_MESSAGEID   COMM_MSG_BATCH
+#define BINARY_BATCH_MAX         8    // Readings per batch frame
+#define BINARY_READING_FLAG_DELTA     0x80 // Same meaning as BINARY_FLAG_DELTA, for one reading
+#define BINARY_READING_FLAG_TIMESTAMP 0x40
+#define BINARY_READING_SENSOR_MASK    0x3F
+#define BINARY_READING_MAX_LENGTH (1 + 3 + BINARY_VARINT_MAX_LENGTH) // Header, 16-bit params, timestamp
+#define BINARY_BATCH_MAX_RAW     (4 + BINARY_BATCH_MAX * BINARY_READING_MAX_LENGTH + 4)
+
+#define BINARY_FRAME_MAX_RAW     BINARY_BATCH_MAX_RAW // The larger of the two
+#define BINARY_FRAME_MAX_ENCODED (BINARY_FRAME_MAX_RAW + 1) // COBS adds one byte per 254
+#define BINARY_FRAME_MIN_RAW     4  // IDs and CRC-16, no params
+
+/**
+ * @brief Enables the CRC unit clock (COMM_CRC_HARDWARE) and checks the unit
+ *        against the software CRC. Called once from initialize_sensor_datalink().
+ */
+void initialize_binary_framing(void);
+
+/**
+ * @brief True if CRC-32 is computed by the CRC unit: COMM_CRC_HARDWARE is set
+ *        and the unit passed its self-test.
+ */
+bool crc32_is_hardware(void);
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ * @param crc The running CRC, 0xFFFF for a new computation.
+ * @param data Bytes to add to it.
+ * @param length Number of bytes.
+ */
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t* data, uint16_t length);
+
+/**
+ * @brief CRC-32/MPEG-2 (polynomial 0x04C11DB7, initial value 0xFFFFFFFF, no
+ *        reflection, no final XOR) of a whole buffer. Uses the CRC unit for
+ *        the complete 32-bit words when COMM_CRC_HARDWARE is set.
+ * @param data Bytes to check.
+ * @param length Number of bytes.
+ */
+uint32_t crc32_mpeg2(const uint8_t* data, uint16_t length);
+
+/**
+ * @brief Builds a COBS encoded binary frame, including its 0x00 terminator.
+ * @param out Destination, at least BINARY_FRAME_MAX_ENCODED + 1 bytes.
+ * @param message Address, sensor ID, message ID, params and, if HasSeq and
+ *        HasTimestamp, the sequence number and timestamp. IsDelta sets the
+ *        delta flag; the fields are sent as they are. Address 0 is left out.
+ * @param has_params False for frames without a params field (acks, reset).
+ *        The params field is always sent along with the optional fields.
+ * @param integrity The CRC closing the frame.
+ * @return Number of bytes written to out.
+ */
+uint16_t binary_frame_encode(uint8_t* out, const struct CommMessage* message, bool has_params,
+                             enum BinaryIntegrity integrity);
+
+/**
+ * @brief Builds a COBS encoded batch frame, including its 0x00 terminator.
+ * @param out Destination, at least BINARY_FRAME_MAX_ENCODED + 1 bytes.
+ * @param readings Data messages: sensor ID, params and, if HasTimestamp, the
+ *        timestamp. IsDelta is kept per reading; sequence numbers are not sent.
+ * @param count Number of readings, 1 to BINARY_BATCH_MAX.
+ * @param address Platform address of the frame, 0 for none.
+ * @param integrity The CRC closing the frame.
+ * @return Number of bytes written to out.
+ */
+uint16_t binary_batch_encode(uint8_t* out, const struct CommMessage* readings, uint8_t count,
+                             uint8_t address, enum BinaryIntegrity integrity);
+
+/**
+ * @brief Decodes one received frame, the bytes between two 0x00 delimiters.
+ *        The frame is unstuffed in place. Only the negotiated CRC is
+ *        checked: a frame closed by the other one is damaged as far as this
+ *        link is concerned. A batch frame is returned as one data message
+ *        (ID 03) per reading, each with the frame's address.
+ * @param frame The stuffed bytes, without the terminator.
+ * @param length Number of bytes in frame.
+ * @param integrity The CRC the link was negotiated to.
+ * @param messages Filled in when the frame is valid, room for BINARY_BATCH_MAX.
+ * @return Number of messages: 1 for an ordinary frame, the reading count for
+ *         a batch, 0 if the frame is damaged or its CRC did not match.
+ */
+uint8_t binary_frame_decode(uint8_t* frame, uint16_t length, enum BinaryIntegrity integrity,
+                            struct CommMessage* messages);
+
+#endif /* INC_USER_L2_COMM_BINARY_H_ */
@@ -0,0 +1,91 @@
+/*
+ * Comm_Bus.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_BUS_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_BUS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L2/Comm_Datalink.h"
+
+// Several platforms may share USART6 as a half duplex bus (RS-485), each with
+// its own address. The controller finds them by asking every address up to
+// COMM_BUS_MAX_ADDRESS, then polls them in turn; a platform on the bus only
+// transmits in answer to a frame addressed to it, so frames never collide.
+// Readings are held on the platform until it is polled. A platform must not
+// hear its own frames: the transceiver's receiver is off while it drives the
+// bus, as usual for half duplex RS-485.
+#define COMM_BUS_MAX_ADDRESS    0   // Highest address the controller looks for, 0 for a point-to-point link
+#define BUS_MAX_NODES           32  // Platforms the controller keeps track of
+#define BUS_HOLD_MAX            (2 * BINARY_BATCH_MAX) // Readings a platform holds between polls
+#define BUS_REPLY_TIMEOUT_MS    20  // Time a platform has to answer a discovery, poll or command
+#define BUS_POLL_INTERVAL_MS    100 // Start of one poll round to the next
+
+// Params of the frame ending a platform's turn: readings sent in the turn, and
+// readings it dropped since its last turn because the hold buffer was full
+#define BUS_TURN_PARAMS(sent, dropped) ((uint16_t)(((dropped) > 0xFF ? 0xFF : (dropped)) << 8 | ((sent) & 0xFF)))
+#define BUS_TURN_SENT(params)          ((params) & 0xFF)
+#define BUS_TURN_DROPPED(params)       ((params) >> 8)
+
+// A platform found on the bus
+struct BusNode {
+    uint8_t address;
+    uint16_t sensors;       // Bit (1 << sensor) for every sensor it has
+    uint32_t polls;         // Polls sent
+    uint32_t timeouts;      // Polls whose end of turn never came
+    uint32_t readings;      // Readings received in its turns
+    uint32_t dropped;       // Readings it reported dropping because its hold buffer was full
+};
+
+/**
+ * @brief Platform side: takes an address on the bus, or leaves the link
+ *        point-to-point with COMM_ADDRESS_NONE. Sets the address of every
+ *        frame sent.
+ */
+void bus_join(uint8_t address);
+
+/**
+ * @brief Platform side: keeps a data frame until the next poll. When
+ *        BUS_HOLD_MAX are waiting the oldest is dropped and counted, and the
+ *        count goes to the controller at the end of the next turn.
+ * @param message The data frame.
+ * @return False if the platform is not on a bus; send the frame as usual.
+ */
+bool bus_hold(const struct CommMessage* message);
+
+/**
+ * @brief Platform side: sends the readings held, then the end of the turn
+ *        with BUS_TURN_PARAMS().
+ */
+void bus_handle_poll(void);
+
+/**
+ * @brief Controller side: forgets every platform.
+ */
+void bus_clear(void);
+
+/**
+ * @brief Controller side: records a platform that answered discovery.
+ * @param address Its address.
+ * @param sensors Sensors it reported.
+ * @return False if the registry is full.
+ */
+bool bus_add_node(uint8_t address, uint16_t sensors);
+
+/**
+ * @brief Controller side: number of platforms found.
+ */
+uint8_t bus_node_count(void);
+
+/**
+ * @brief Controller side: a platform in the registry, in order of address.
+ * @param index 0 to bus_node_count() - 1.
+ */
+struct BusNode* bus_node(uint8_t index);
+
+#endif /* INC_USER_L2_COMM_BUS_H_ */
@@ -0,0 +1,67 @@
+/*
+ * Comm_Clock.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_CLOCK_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_CLOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L2/Comm_Datalink.h"
+
+#define CLOCK_SYNC_PERIOD_MS  2000 // Time between offset measurements, short enough to follow crystal drift
+#define CLOCK_SYNC_MAX_RTT_MS 20   // Measurements with a slower round trip are too uncertain to use
+
+/**
+ * @brief Creates the timer that sends the controller's time requests. Called
+ *        once from initialize_sensor_datalink().
+ */
+void initialize_clock_sync(void);
+
+/**
+ * @brief Controller side: starts measuring the platform clock offset, or
+ *        stops when the link is not binary (timestamps need binary frames).
+ */
+void clock_sync_start(void);
+
+/**
+ * @brief Platform side: answers a time request with the current tick count
+ *        and starts timestamping data frames.
+ */
+void clock_handle_request(void);
+
+/**
+ * @brief Controller side: turns the platform's answer into an offset estimate.
+ * @param reply The CNTRL 07 frame carrying the platform tick count.
+ */
+void clock_handle_reply(const struct CommMessage* reply);
+
+/**
+ * @brief Platform side: true once the controller has asked for the time, so
+ *        data frames should carry their sample timestamp.
+ */
+bool clock_timestamps_enabled(void);
+
+/**
+ * @brief Controller side: true once at least one offset has been measured.
+ */
+bool clock_is_synchronised(void);
+
+/**
+ * @brief Controller side: converts a platform tick count to the local one.
+ * @param remote_tick Platform tick count.
+ */
+uint32_t clock_to_local(uint32_t remote_tick);
+
+/**
+ * @brief Controller side: the last offset (platform minus controller, ticks)
+ *        and the round trip it was measured with.
+ */
+int32_t clock_offset(void);
+uint32_t clock_round_trip(void);
+
+#endif /* INC_USER_L2_COMM_CLOCK_H_ */
@@ -9,46 +9,126 @@
 #define INC_USER_L2_COMM_DATALINK_H_
 
 #include <stdbool.h>       // Include standard library for boolean data types
+#include <stddef.h>        // Include standard library for size_t
 #include "User/L1/USART_Driver.h" // Include USART driver for serial communication
+#include "User/L2/Comm_Schema.h"  // Include the node and message tables
+#include "User/L2/Comm_Binary.h"  // Include binary framing sizes
+#include "User/L2/Comm_Delta.h"   // Include delta decoder state
 #include "FreeRTOS.h"      // Include FreeRTOS main header
 #include "semphr.h"        // Include FreeRTOS semaphore functionalities
 
-// Enumeration for identifying different sensor types
-enum SensorId_t {
-    None,           // No sensor
-    Controller,     // Controller module
-    Turbidity,      // Turbidity sensor
-    Microplastic,   // Microplastic sensor
-    DOLevel         // Dissolved Oxygen (DO) level sensor
+// Enumeration for commands from the Host PC
+enum HostPCCommands {
+    PC_Command_NONE,    // No command received
+    PC_Command_START,   // Command to start operations
+    PC_Command_RESET,   // Command to reset operations
+    PC_Command_STATS,   // Command to report the UART link health counters
+    PC_Command_LATENCY, // Command to report the sample to LED latency of each sensor
+    PC_Command_PERIOD,  // Command to change the sampling period of a sensor
+    PC_Command_ENABLE,  // Command to start sampling a sensor
+    PC_Command_DISABLE, // Command to stop sampling a sensor
+    PC_Command_DUMP,    // Command to print the most recent readings
+    PC_Command_RATE,    // Command to move the sensor link to another baud rate
+    PC_Command_HELP,    // Command to list the commands
+    PC_Command_INVALID  // Unknown command or bad arguments
 };
 
-// Enumeration for types of acknowledgment messages
-enum AckTypes {
-    RemoteSensingPlatformReset,  // Acknowledge platform reset
-    TurbiditySensorEnable,       // Acknowledge Turbidity sensor enable command
-    MicroplasticSensorEnable,    // Acknowledge Microplastic sensor enable command
-    DOLevelSensorEnable          // Acknowledge DOLevel sensor enable command
+#define HOSTPC_LINE_LENGTH 48 // Longest command line accepted from the Host PC
+
+// A command line from the Host PC, checked against the command table
+struct HostPCCommand {
+    enum HostPCCommands command;
+    enum SensorId_t sensor;       // PERIOD, ENABLE and DISABLE
+    uint32_t value;               // PERIOD milliseconds, DUMP count, RATE baud
+    const char* usage;            // PC_Command_INVALID: the expected form, NULL if the name is unknown
 };
 
-// Enumeration for commands from the Host PC
-enum HostPCCommands {
-    PC_Command_NONE,  // No command received
-    PC_Command_START, // Command to start operations
-    PC_Command_RESET  // Command to reset operations
+// Framings a sensor link can carry, chosen per link. It selects what is sent
+// and which binary frames are accepted: only those of the link's framing, CRC
+// included. ASCII frames are accepted in all of them. Short ASCII frames are
+// told apart from full ones by their first header byte, a lower case node letter.
+enum CommFraming {
+    COMM_FRAMING_ASCII,         // "$SENSR,MM,PPPPPPPP,*,CS\n", "$SENSR@AAA,MM,..." when addressed
+    COMM_FRAMING_BINARY,        // COBS + CRC-16, see Comm_Binary.h
+    COMM_FRAMING_BINARY_CRC32,  // COBS + CRC-32 from the STM32 CRC unit
+    COMM_FRAMING_ASCII_SHORT    // "$sM,PPPPPPPP,*,CS\n", "$sM@AAA,..." when addressed, see comm_message_char()
 };
 
+// Framing the controller asks for at link start. The platform answers with
+// the best framing it supports up to that one; platforms that do not answer
+// (older firmware) are kept on ASCII. COMM_FRAMING_ASCII_SHORT keeps the link
+// readable on a terminal; it is numbered last so older platforms, which only
+// know the framings before it, answer with binary instead.
+#define COMM_PREFERRED_FRAMING COMM_FRAMING_BINARY_CRC32
+
+// Platform address of a frame on a shared bus: the platform it is sent to or
+// comes from. A point-to-point link leaves it out.
+#define COMM_ADDRESS_NONE 0
+#define COMM_ADDRESS_MAX  254
+
 // Structure to represent a communication message
 struct CommMessage {
+    uint8_t address;              // Platform the frame is to or from, COMM_ADDRESS_NONE on a point-to-point link
     enum SensorId_t SensorID;     // ID of the sensor sending the message
     uint8_t messageId;            // Message identifier
     uint16_t params;              // Additional parameters for the message
+    uint8_t seq;                  // Sequence number (reliable data) or next expected one (reliable ack)
+    bool HasSeq;                  // Flag indicating if seq was received (binary framing only)
+    uint32_t timestamp;           // Platform tick count when the reading was taken
+    bool HasTimestamp;            // Flag indicating if timestamp was received (binary framing only)
+    bool IsDelta;                 // Flag indicating the data frame was sent delta coded (binary framing only)
     uint8_t checksum;             // Checksum for message integrity
     bool IsCheckSumValid;         // Flag indicating if the checksum is valid
     bool IsMessageReady;          // Flag indicating if the message is fully decoded
 };
 
+// Number of received bytes a parser pulls from the USART driver per read
+#define COMM_PARSER_CHUNK_LENGTH 32
+
+// States of the ASCII frame state machine
+enum ParseMessageState_t {Waiting_S, SensorID_S, ShortID_S, Address_S, MessageID_S, ParamsID_S, Star_S, CS_S};
+
+// Receive counters of one parser
+struct CommParserStats {
+    uint32_t resyncs;   // Frames lost: CRC or checksum mismatch, or cut short by the next frame
+    uint32_t rejected;  // '$' not followed by a valid header and fields, in noise or binary payload
+    uint32_t scanned;   // Bytes passed over a word at a time between frames
+};
+
+// Everything a sensor message parser remembers between bytes. Each link owns
+// one, so several links can be parsed at once from different tasks.
+struct CommParser {
+    enum UsartPort port;               // Link read by comm_parser_read()
+    enum ParseMessageState_t state;    // ASCII state machine's current state
+    uint16_t sensorIdIdx, messageIdIdx, paramIdx, checksumIdx;
+    char sensorId[COMM_NODE_NAME_LENGTH + 1];
+    uint8_t checksum;                  // XOR of the ASCII frame so far
+    struct CommMessage message;        // Frame being decoded
+    uint8_t binaryFrame[BINARY_FRAME_MAX_ENCODED]; // Bytes since the last 0x00
+    uint16_t binaryFrameLength;        // May run past the buffer, such a frame is discarded
+    bool IsAsciiFrameEnded;            // A valid ASCII frame just ended, its '\n' is next
+    bool IsShortHeader;                // The ASCII frame has a one letter header, its message ID is in it
+    struct DeltaDecoder delta;         // Last full reading of each sensor, for delta frames
+    struct CommMessage decoded[BINARY_BATCH_MAX]; // Messages of the last binary frame, several for a batch
+    uint8_t decodedCount, decodedIdx;  // Messages in decoded, and the next one to hand out
+    uint8_t chunk[COMM_PARSER_CHUNK_LENGTH]; // Bytes read from the driver but not parsed yet
+    uint16_t chunkLength, chunkIdx;
+    struct CommParserStats stats;
+};
+
+// Called by comm_parse_span() for every valid frame found in the span
+typedef void (*CommMessageCallback)(const struct CommMessage* message, void* context);
+
 // Function prototypes for communication datalink functionalities
 
+/**
+ * @brief True for the framings sent as ASCII text, which have no room for
+ *        sequence numbers, timestamps, delta frames or batches.
+ */
+static inline bool comm_framing_is_ascii(enum CommFraming framing) {
+    return framing == COMM_FRAMING_ASCII || framing == COMM_FRAMING_ASCII_SHORT;
+}
+
 /**
  * @brief Send data message for a specific sensor type.
  * @param sensorType The type of sensor sending the data.
@@ -56,6 +136,67 @@ struct CommMessage {
  */
 void send_sensorData_message(enum SensorId_t sensorType, uint16_t data);
 
+/**
+ * @brief Send a data message numbered for reliable mode (binary framing only).
+ * @param sensorType The type of sensor sending the data.
+ * @param data The data value to send.
+ * @param seq The frame's sequence number.
+ * @param sample_tick Tick count when the reading was taken, sent once timestamps are on.
+ */
+void send_sensorDataSeq_message(enum SensorId_t sensorType, uint16_t data, uint8_t seq, uint32_t sample_tick);
+
+/**
+ * @brief Send a time request (controller) or answer (platform).
+ * @param has_timestamp False for the request.
+ * @param timestamp The platform tick count, in the answer.
+ */
+void send_clock_message(bool has_timestamp, uint32_t timestamp);
+
+/**
+ * @brief Send sensor data frames as one batch frame (binary framing only).
+ *        A single reading is sent as an ordinary data frame.
+ * @param readings The data frames, already delta coded.
+ * @param count Number of readings, 1 to BINARY_BATCH_MAX.
+ */
+void send_sensorDataBatch_message(const struct CommMessage* readings, uint8_t count);
+
+/**
+ * @brief Send a poll (controller) or the end of the platform's turn.
+ * @param params 0 in the poll, BUS_TURN_PARAMS() at the end of a turn.
+ */
+void send_poll_message(uint16_t params);
+
+/**
+ * @brief Send a discovery request (controller) or answer (platform).
+ * @param sensors Bit (1 << sensor) set for every sensor the platform has, 0 in the request.
+ */
+void send_discover_message(uint16_t sensors);
+
+/**
+ * @brief Send a batching request (controller) or answer (platform).
+ * @param params Max readings per batch and max delay, see BATCH_PARAMS() in Comm_Batch.h.
+ */
+void send_batch_message(uint16_t params);
+
+/**
+ * @brief Send a compression request (controller) or answer (platform).
+ * @param interval Keyframe interval in data frames, 0 to turn compression off.
+ */
+void send_compression_message(uint8_t interval);
+
+/**
+ * @brief Send a reliable mode request (controller) or answer (platform).
+ * @param window Retransmit window in frames, 0 to turn reliable mode off.
+ */
+void send_reliable_message(uint8_t window);
+
+/**
+ * @brief Send a reliable mode acknowledgment.
+ * @param next_seq First sequence number not yet received; all before it arrived.
+ * @param received Bit i set if frame next_seq + i has arrived.
+ */
+void send_reliableAck_message(uint8_t next_seq, uint16_t received);
+
 /**
  * @brief Send acknowledgment message to confirm a command was received.
  * @param AckType The type of acknowledgment message.
@@ -74,6 +215,65 @@ void send_sensorEnable_message(enum SensorId_t sensorType, uint16_t TimePeriod);
  */
 void send_sensorReset_message(void);
 
+/**
+ * @brief Send a link rate request (controller) or echo (platform).
+ * @param baud The USART6 baud rate, carried in the params field divided by 100.
+ */
+void send_linkRate_message(uint32_t baud);
+
+/**
+ * @brief Send a framing request (controller) or echo (platform).
+ * @param framing The framing asked for, or the one accepted.
+ */
+void send_framing_message(enum CommFraming framing);
+
+/**
+ * @brief Platform side of the framing handshake: echoes the framing it will
+ *        use (the requested one, or binary CRC-32 for one it does not know),
+ *        then switches.
+ * @param requested The params field of the controller's request.
+ */
+void handle_framing_request(uint16_t requested);
+
+/**
+ * @brief Set the address every outgoing sensor link frame carries: the
+ *        platform's own address on a platform, the platform being talked to
+ *        on the controller. Only one task may send while it is not
+ *        COMM_ADDRESS_NONE.
+ * @param address The platform address, COMM_ADDRESS_NONE on a point-to-point link.
+ */
+void comm_set_address(uint8_t address);
+
+/**
+ * @brief Get the address of outgoing sensor link frames.
+ */
+uint8_t comm_get_address(void);
+
+/**
+ * @brief Select the framing of a link: what is sent on it and what binary
+ *        frames its parser accepts.
+ * @param port The link.
+ * @param framing The framing agreed on it.
+ */
+void comm_set_link_framing(enum UsartPort port, enum CommFraming framing);
+
+/**
+ * @brief Get the framing of a link.
+ * @param port The link.
+ */
+enum CommFraming comm_get_link_framing(enum UsartPort port);
+
+/**
+ * @brief Select the framing of the sensor link the transmit lanes write to.
+ * @param framing The framing to send with.
+ */
+void set_sensor_framing(enum CommFraming framing);
+
+/**
+ * @brief Get the framing of the sensor link the transmit lanes write to.
+ */
+enum CommFraming get_sensor_framing(void);
+
 /**
  * @brief Initialize the communication datalink for sensor messages.
  */
@@ -85,15 +285,83 @@ void initialize_sensor_datalink(void);
 void initialize_hostPC_datalink(void);
 
 /**
- * @brief Parse and decode an incoming sensor message.
+ * @brief Prepare a parser for use.
+ * @param parser The parser to reset.
+ * @param port The link comm_parser_read() pulls bytes from.
+ */
+void comm_parser_init(struct CommParser* parser, enum UsartPort port);
+
+/**
+ * @brief Feed one received byte to a parser.
+ * @param parser The link's parser.
+ * @param byte The received byte.
+ * @param message Set to the decoded frame when this byte completes one.
+ * @return True if a valid frame was completed. A batch frame gives its first
+ *         reading here; call comm_parser_next() for the others.
+ */
+bool comm_parse_byte(struct CommParser* parser, uint8_t byte, struct CommMessage* message);
+
+/**
+ * @brief Hand out the next reading of the batch frame comm_parse_byte() last completed.
+ * @param parser The link's parser.
+ * @param message Set to the reading.
+ * @return False once every reading has been handed out.
+ */
+bool comm_parser_next(struct CommParser* parser, struct CommMessage* message);
+
+/**
+ * @brief Feed a whole span of received bytes to a parser. Every frame
+ *        completed in the span is handed to callback; a frame cut off at the
+ *        end of the span is carried over to the next call.
+ * @param parser The link's parser.
+ * @param data The received bytes.
+ * @param length Number of bytes in data.
+ * @param callback Called once per valid frame, in order of arrival.
+ * @param context Passed through to callback.
+ * @return Number of frames handed to callback.
+ */
+uint16_t comm_parse_span(struct CommParser* parser, const uint8_t* data, size_t length,
+                         CommMessageCallback callback, void* context);
+
+/**
+ * @brief Block on the parser's link until a valid frame has been decoded.
+ * @param parser The link's parser.
+ * @param message Set to the decoded frame.
+ */
+void comm_parser_read(struct CommParser* parser, struct CommMessage* message);
+
+/**
+ * @brief Copies a parser's receive counters.
+ * @param parser The link's parser.
+ * @param stats Destination.
+ */
+void comm_parser_stats(const struct CommParser* parser, struct CommParserStats* stats);
+
+/**
+ * @brief The frame header name of a node, "CNTRL" for the controller.
+ * @param id The node.
+ * @return The name, or "?????" for None and unknown IDs.
+ */
+const char* comm_sensor_name(enum SensorId_t id);
+
+/**
+ * @brief Parse and decode an incoming message on the sensor link (USART6).
  * @param currentRxMessage Pointer to the message structure to populate.
  */
 void parse_sensor_message(struct CommMessage* currentRxMessage);
 
 /**
- * @brief Parse and decode an incoming command message from the Host PC.
- * @return The command parsed from the Host PC.
+ * @brief Read one command line from the Host PC and parse it. Names and
+ *        sensor IDs are not case sensitive; arguments are separated by spaces.
+ * @param command Set to the command and its arguments, or PC_Command_INVALID.
+ */
+void parse_hostPC_message(struct HostPCCommand* command);
+
+/**
+ * @brief The usage line of a Host PC command, for a help listing.
+ * @param index Position in the command table.
+ * @return The usage line, or NULL past the end of the table.
  */
-enum HostPCCommands parse_hostPC_message();
+const char* hostPC_command_usage(uint8_t index);
 
 #endif /* INC_USER_L2_COMM_DATALINK_H_ */
@@ -0,0 +1,113 @@
+/*
+ * Comm_Delta.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_DELTA_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_DELTA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L2/Comm_Schema.h"
+
+struct CommMessage; // Comm_Datalink.h
+
+#define DELTA_KEYFRAME_INTERVAL 8  // Data frames per sensor from one full value to the next, 0 disables compression
+#define DELTA_KEYFRAME_MAX      64 // Longest interval the platform accepts, bounds the gap after a lost frame
+
+// The last full value of one sensor, on either side of the link
+struct DeltaBase {
+    uint16_t value;
+    uint32_t timestamp;
+    bool HasTimestamp;
+    bool IsValid;      // Decoder: a keyframe arrived and no frame was lost since
+    uint8_t countdown; // Encoder: delta frames left before the next keyframe
+};
+
+// Receive side state, one per parser
+struct DeltaDecoder {
+    struct DeltaBase bases[COMM_NODE_COUNT];
+};
+
+// Compression counters, kept on the controller
+struct DeltaStats {
+    uint32_t interval;     // Negotiated keyframe interval, 0 when off
+    uint32_t keyframes;    // Data frames received with full values
+    uint32_t deltas;       // Data frames received as differences
+    uint32_t unresolved;   // Delta frames dropped while waiting for a keyframe
+    uint32_t resyncs;      // Times a damaged frame invalidated every base
+    uint32_t full_bytes;   // Params and timestamp bytes the received frames would take with full values
+    uint32_t sent_bytes;   // Params and timestamp bytes they took
+};
+
+/**
+ * @brief Zig-zag mapping of a signed difference, so small values of either
+ *        sign get short varints: 0, -1, 1, -2 become 0, 1, 2, 3.
+ */
+static inline uint32_t delta_zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t delta_unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * @brief Platform side of the handshake: answers with the keyframe interval
+ *        it accepts and restarts every sensor on a keyframe. Refused (0) on
+ *        an ASCII link and in reliable mode, whose resends arrive out of order.
+ * @param interval The interval proposed by the controller.
+ */
+void delta_handle_request(uint16_t interval);
+
+/**
+ * @brief Platform side: true while data frames are being delta coded.
+ */
+bool delta_is_active(void);
+
+/**
+ * @brief Controller side: records the interval the platform accepted.
+ */
+void delta_start(uint8_t interval);
+
+/**
+ * @brief Platform side: turns a data frame into a delta frame against the
+ *        sensor's previous reading, unless a keyframe is due.
+ * @param message The data frame about to be sent; params and timestamp are
+ *        replaced by differences and IsDelta is set.
+ */
+void delta_encode(struct CommMessage* message);
+
+/**
+ * @brief Platform side: a data frame that went through delta_encode() was
+ *        dropped before it reached the wire, so the sensor's next frame is a
+ *        keyframe.
+ * @param sensor The sensor of the lost frame.
+ */
+void delta_frame_lost(enum SensorId_t sensor);
+
+/**
+ * @brief Receive side: restores the full values of a delta frame and
+ *        remembers keyframes. Other frames pass through unchanged.
+ * @param decoder The link's decoder.
+ * @param message A frame just decoded.
+ * @return False if the frame is a delta with no base to apply it to.
+ */
+bool delta_decode(struct DeltaDecoder* decoder, struct CommMessage* message);
+
+/**
+ * @brief Receive side: a damaged frame may have been a data frame of any
+ *        sensor, so every sensor waits for its next keyframe.
+ */
+void delta_invalidate(struct DeltaDecoder* decoder);
+
+/**
+ * @brief Copies the compression counters.
+ * @param stats Destination.
+ */
+void get_delta_stats(struct DeltaStats* stats);
+
+#endif /* INC_USER_L2_COMM_DELTA_H_ */
@@ -0,0 +1,97 @@
+/*
+ * Comm_Lanes.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_LANES_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_LANES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L1/USART_Driver.h"
+#include "User/L2/Comm_Schema.h"
+#include "User/L2/Comm_Binary.h"
+
+// Outgoing sensor link frames wait in one of three lanes. A transmit task
+// takes the oldest frame of the highest lane that has one and hands it to the
+// USART driver only once nothing is waiting behind the frame on the wire, so
+// a control frame queued while telemetry saturates the link is at most one
+// frame away from the line. Frames within a lane keep their order.
+enum CommLane {
+    COMM_LANE_CONTROL,   // Commands, acks and handshakes, see the lane column of COMM_MESSAGE_TABLE
+    COMM_LANE_ALARM,     // Readings in the alarm range, see lane_is_alarm()
+    COMM_LANE_TELEMETRY, // Every other reading, batch frames and the end of a bus turn
+    COMM_LANE_COUNT
+};
+
+#define LANE_CONTROL_DEPTH   4  // Frames each lane holds before senders wait
+#define LANE_ALARM_DEPTH     4
+#define LANE_TELEMETRY_DEPTH 8
+#define LANE_FRAME_MAX       (BINARY_FRAME_MAX_ENCODED + 1) // A batch frame and its delimiter, longer than any ASCII frame
+#define LANE_TASK_PRIORITY   (tskIDLE_PRIORITY + 3) // Above every sender, so a lane only fills while the line is busy
+
+// Readings sent on the alarm lane: the red band of the controller's LEDs
+// (get_LEDstatus() in SensorController.c), in the units the reading is sent in
+#define LANE_ALARM_TURBIDITY_MIN    5000 // Above 50.00 NTU
+#define LANE_ALARM_MICROPLASTIC_MIN 2000 // Above 2000 particles
+#define LANE_ALARM_DOLEVEL_MAX      400  // Below 4.00 mg/L
+
+// Counters of one lane
+struct LaneStats {
+    uint32_t depth;       // Frames waiting now
+    uint32_t peak_depth;  // Most frames ever waiting at once
+    uint32_t frames;      // Frames handed to the USART driver
+    uint32_t waits;       // Sends that found the lane full and had to wait
+    uint32_t dropped;     // Frames not queued: the lane stayed full for the whole timeout
+    uint32_t max_wait_ms; // Longest a frame waited in the lane
+};
+
+/**
+ * @brief Creates the lanes and the transmit task. Called once from
+ *        initialize_sensor_datalink(), before the scheduler starts.
+ */
+void initialize_lanes(void);
+
+/**
+ * @brief True for a reading that goes on the alarm lane.
+ * @param sensor The sensor the reading came from.
+ * @param value The reading as sent in the params field.
+ */
+bool lane_is_alarm(enum SensorId_t sensor, uint16_t value);
+
+/**
+ * @brief Queues a frame given as a list of segments, gathered into one lane
+ *        slot. Blocks (up to timeout) while the lane is full; a frame that
+ *        does not get in is dropped and counted. Timer callbacks pass 0.
+ * @param lane The lane.
+ * @param segments The pieces of the frame, LANE_FRAME_MAX bytes at most in all.
+ * @param count Number of segments.
+ * @param timeout Longest time to wait for room.
+ * @return False if the frame did not fit in a slot or in the lane in time.
+ */
+bool lane_writev(enum CommLane lane, const struct UsartTxSegment* segments, uint8_t count, TickType_t timeout);
+
+/**
+ * @brief Queues a frame, see lane_writev().
+ */
+bool lane_write(enum CommLane lane, const uint8_t* data, uint16_t length, TickType_t timeout);
+
+/**
+ * @brief Waits until every lane is empty and the last frame has been handed
+ *        to the USART driver, e.g. before the baud rate changes.
+ * @param timeout Longest time to wait.
+ * @return False if frames were still waiting at the timeout.
+ */
+bool lane_flush(TickType_t timeout);
+
+/**
+ * @brief Copies the counters of one lane.
+ * @param lane The lane.
+ * @param stats Destination.
+ */
+void get_lane_stats(enum CommLane lane, struct LaneStats* stats);
+
+#endif /* INC_USER_L2_COMM_LANES_H_ */
@@ -0,0 +1,55 @@
+/*
+ * Comm_LinkRate.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_LINKRATE_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_LINKRATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LINK_RATE_BASE_BAUD    115200 // Rate both sides start at after reset
+#define LINK_RATE_VERIFY_MS    200    // Time the controller waits for each echo
+#define LINK_RATE_CONFIRM_MS   (2 * LINK_RATE_VERIFY_MS) // Platform reverts if a new rate is not confirmed by then
+#define LINK_RATE_MONITOR_MS   1000   // Period of the error counter check
+#define LINK_RATE_ERROR_LIMIT  8      // Overrun/framing/noise errors per period that force a fallback
+#define LINK_RATE_SWITCH_MS    25     // Longest a timer waits for the USART to drain before a switch, two buffers at 115200
+#define LINK_RATE_RETRY_MS     10     // Delay before a switch that timed out is tried again
+
+/**
+ * @brief Creates the timers used to confirm rate changes and to watch the
+ *        sensor link error counters. Called once from initialize_sensor_datalink().
+ */
+void initialize_link_rate(void);
+
+/**
+ * @brief Returns the next candidate rate above baud that this side supports
+ *        and has not already seen fail, or 0 if there is none.
+ * @param baud The rate the link is currently running at.
+ */
+uint32_t link_rate_next(uint32_t baud);
+
+/**
+ * @brief Marks a rate as unreliable so it and everything above it are no
+ *        longer proposed.
+ * @param baud The rate that failed.
+ */
+void link_rate_limit(uint32_t baud);
+
+/**
+ * @brief Platform side of the handshake. Echoes the requested rate (or the
+ *        current one when refusing), switches, and waits for the controller
+ *        to repeat the request at the new rate before committing to it.
+ * @param baud The rate proposed by the controller.
+ */
+void link_rate_handle_request(uint32_t baud);
+
+/**
+ * @brief Returns how many times the link fell back to LINK_RATE_BASE_BAUD.
+ */
+uint32_t link_rate_fallbacks(void);
+
+#endif /* INC_USER_L2_COMM_LINKRATE_H_ */
@@ -0,0 +1,85 @@
+/*
+ * Comm_Reliable.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_RELIABLE_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_RELIABLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/L2/Comm_Datalink.h"
+
+#define RELIABLE_WINDOW       8   // Data frames the controller asks to have in flight, 0 disables reliable mode
+#define RELIABLE_WINDOW_MAX   16  // Largest window the platform accepts, one bit per frame in an ack
+#define RELIABLE_RTO_MS       300 // Unacknowledged frames older than this are sent again
+#define RELIABLE_MAX_RETRIES  5   // Transmissions after the first before a frame is given up
+
+// Reliable mode counters, kept on both sides
+struct ReliableStats {
+    uint32_t window;        // Negotiated window, 0 when off
+    uint32_t sent;          // Platform: data frames numbered and sent
+    uint32_t retransmits;   // Platform: frames sent again after a timeout or a hole in an ack
+    uint32_t window_full;   // Platform: readings dropped because the window was full
+    uint32_t given_up;      // Platform: frames abandoned after RELIABLE_MAX_RETRIES
+    uint32_t delivered;     // Controller: distinct data frames passed on
+    uint32_t duplicates;    // Controller: frames received again and discarded
+    uint32_t skipped;       // Controller: sequence numbers never received
+};
+
+/**
+ * @brief Creates the retransmit timer and window lock. Called once from
+ *        initialize_sensor_datalink().
+ */
+void initialize_reliable(void);
+
+/**
+ * @brief True once reliable mode has been negotiated on the sensor link.
+ */
+bool reliable_is_active(void);
+
+/**
+ * @brief Controller side: starts tracking sequence numbers from 0.
+ * @param window The window the platform accepted, 0 to turn reliable mode off.
+ */
+void reliable_start(uint8_t window);
+
+/**
+ * @brief Platform side of the handshake: answers with the window it accepts
+ *        and restarts numbering. Refused (0) on an ASCII link.
+ * @param window The window proposed by the controller.
+ */
+void reliable_handle_request(uint16_t window);
+
+/**
+ * @brief Platform side: numbers a reading, keeps it in the window and sends it.
+ *        The reading is dropped and counted if the window is full.
+ * @param sensorType The sensor the reading came from.
+ * @param data The reading.
+ */
+void reliable_send_data(enum SensorId_t sensorType, uint16_t data);
+
+/**
+ * @brief Platform side: releases acknowledged frames and resends the holes
+ *        below the newest frame acknowledged.
+ * @param ack The acknowledgment received from the controller.
+ */
+void reliable_handle_ack(const struct CommMessage* ack);
+
+/**
+ * @brief Controller side: records a numbered data frame and acknowledges it.
+ * @param message The data frame received.
+ * @return True if the frame is new and should be passed on, false for a duplicate.
+ */
+bool reliable_receive(const struct CommMessage* message);
+
+/**
+ * @brief Copies the reliable mode counters.
+ * @param stats Destination.
+ */
+void get_reliable_stats(struct ReliableStats* stats);
+
+#endif /* INC_USER_L2_COMM_RELIABLE_H_ */
@@ -0,0 +1,126 @@
+/*
+ * Comm_Schema.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_L2_COMM_SCHEMA_H_ // Include guard to prevent multiple inclusions
+#define INC_USER_L2_COMM_SCHEMA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The sensor link's nodes and messages, each listed once. The enums below,
+// the frame headers, the header decoder and the platform's dispatch tables
+// are all expanded from these two tables, so a node or message type is added
+// by adding its line here (and a handler where it is received).
+
+// Nodes on the sensor link, in SensorId_t order after None:
+//   X(enum name, 5 letter frame header, first letter of the header,
+//     ack type of the reset or enable command addressed to it)
+// The first letters must differ; the header decoder indexes on them and a
+// repeated one does not compile. In lower case the letter is the node's whole
+// header in short ASCII frames.
+#define COMM_NODE_TABLE(X) \
+    X(Controller,   "CNTRL", 'C', RemoteSensingPlatformReset) \
+    X(Turbidity,    "TURBD", 'T', TurbiditySensorEnable) \
+    X(Microplastic, "MCRPL", 'M', MicroplasticSensorEnable) \
+    X(DOLevel,      "DOLEV", 'D', DOLevelSensorEnable)
+
+// Message IDs, numbered from 0 without gaps:
+//   X(enum name, ID, ASCII message ID field, transmit lane, see Comm_Lanes.h)
+// Short ASCII frames carry the ID as one base 36 digit, see comm_message_char().
+// CNTRL 00 resets the platform, 00 to a sensor enables it with a period in
+// ms, or disables it with period 0.
+// The CNTRL messages from 02 up are handshakes, echoed or answered by the
+// platform, except 06 (reliable ack) and 10 (batch, binary only). 11 and 12
+// are only sent on a shared bus, see Comm_Bus.h.
+// Data frames in the alarm range move up to the alarm lane. The end of a bus
+// turn (11 from the platform) must follow the turn's readings, so polls share
+// their lane.
+#define COMM_MESSAGE_TABLE(X) \
+    X(COMM_MSG_RESET_ENABLE,  0, "00,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_ACK,           1, "01,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_LINK_RATE,     2, "02,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_DATA,          3, "03,", COMM_LANE_TELEMETRY) \
+    X(COMM_MSG_FRAMING,       4, "04,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_RELIABLE,      5, "05,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_RELIABLE_ACK,  6, "06,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_CLOCK,         7, "07,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_COMPRESSION,   8, "08,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_BATCH_CONFIG,  9, "09,", COMM_LANE_CONTROL) \
+    X(COMM_MSG_BATCH,        10, "10,", COMM_LANE_TELEMETRY) \
+    X(COMM_MSG_POLL,         11, "11,", COMM_LANE_TELEMETRY) \
+    X(COMM_MSG_DISCOVER,     12, "12,", COMM_LANE_CONTROL)
+
+#define COMM_NODE_NAME_LENGTH 5
+
+#define COMM_NODE_ENUM(id, name, key, ack) id,
+#define COMM_NODE_ACK_ENUM(id, name, key, ack) ack,
+#define COMM_MESSAGE_ENUM(id, value, ascii, lane) id = value,
+
+// Enumeration for identifying different sensor types
+enum SensorId_t {
+    None,                               // No sensor
+    COMM_NODE_TABLE(COMM_NODE_ENUM)
+    COMM_NODE_COUNT                     // Not a node: number of IDs including None
+};
+
+// Enumeration for types of acknowledgment messages, one per node in the
+// same order, so a node's ack type is COMM_ACK_TYPE(node)
+enum AckTypes {
+    COMM_NODE_TABLE(COMM_NODE_ACK_ENUM)
+};
+#define COMM_ACK_TYPE(node) ((enum AckTypes)((node) - Controller))
+
+// Enumeration of message IDs
+enum CommMessageId {
+    COMM_MESSAGE_TABLE(COMM_MESSAGE_ENUM)
+    COMM_MESSAGE_ID_COUNT
+};
+
+/**
+ * @brief True for the nodes that produce readings, every node but the controller.
+ */
+static inline bool comm_is_sensor(enum SensorId_t id) {
+    return id > Controller && id < COMM_NODE_COUNT;
+}
+
+/**
+ * @brief The message ID as one character in short ASCII frames: '0' to '9',
+ *        then 'A' for 10 onwards, so IDs below 10 read as in full frames.
+ */
+static inline char comm_message_char(uint8_t id) {
+    return (id < 10) ? '0' + id : 'A' + (id - 10);
+}
+
+/**
+ * @brief The message ID a short frame's character stands for.
+ * @return The ID, or 0xFF for a character that is not a base 36 digit.
+ */
+static inline uint8_t comm_message_by_char(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 10;
+    }
+    return 0xFF;
+}
+
+#define COMM_NODE_KEY_CASE(id, name, key, ack) case (key) & 0x1F: return id;
+
+/**
+ * @brief The only node whose header can start with letter. A jump table on
+ *        the letter's low 5 bits; the caller still compares the whole header.
+ */
+static inline enum SensorId_t comm_node_by_key(char letter) {
+    switch (letter & 0x1F) {
+        COMM_NODE_TABLE(COMM_NODE_KEY_CASE)
+        default:
+            return None;
+    }
+}
+
+#endif /* INC_USER_L2_COMM_SCHEMA_H_ */
@@ -91,6 +91,8 @@ enum LEDState {
 typedef struct {
     enum SensorId_t sensorID; // ID of the sensor
     enum LEDState status;     // LED status for the sensor
+    uint32_t sample_tick;     // Controller tick count when the reading was taken
+    bool IsFresh;             // Set if the reading arrived since the last LED update
 } LEDSensorData;
 
 // Structure to represent data for all LEDs
@@ -104,6 +106,7 @@ typedef struct {
 typedef struct {
     enum SensorId_t sensorID; // ID of the sensor
     uint16_t data;            // Scaled sensor data value
+    uint32_t sample_tick;     // Controller tick count when the reading was taken
 } ScaledData;
 
 #endif /* INC_USER_L4_SENSORCONTROLLER_H_ */
@@ -0,0 +1,25 @@
+/*
+ * format.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_FORMAT_H_
+#define INC_USER_FORMAT_H_
+
+#include <stdint.h>
+
+// Integer and fixed-point writers used instead of sprintf. Each writes its
+// characters at out and returns the position after the last one; nothing is
+// NUL terminated unless fmt_end() is called.
+
+char* fmt_str(char* out, const char* str);
+char* fmt_u32(char* out, uint32_t value);
+char* fmt_u32_pad8(char* out, uint32_t value);
+char* fmt_hex2(char* out, uint8_t value);
+char* fmt_fixed(char* out, uint32_t value, uint8_t scale, uint8_t decimals, uint8_t int_digits);
+char* fmt_pad(char* start, char* out, uint8_t width);
+char* fmt_end(char* out);
+
+#endif /* INC_USER_FORMAT_H_ */
@@ -0,0 +1,26 @@
+/*
+ * latency.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef INC_USER_LATENCY_H_
+#define INC_USER_LATENCY_H_
+
+#include <stdint.h>
+
+// Exact buckets for 0-15 ms, then two per power of two up to about 13 minutes
+#define LATENCY_BUCKETS 48
+
+// Latency distribution of one stream, in ticks (ms)
+struct LatencyHistogram {
+	uint32_t count;
+	uint32_t max;
+	uint32_t buckets[LATENCY_BUCKETS];
+};
+
+void latency_record(struct LatencyHistogram* histogram, uint32_t latency);
+uint32_t latency_percentile(const struct LatencyHistogram* histogram, uint8_t percent);
+
+#endif /* INC_USER_LATENCY_H_ */
@@ -79,6 +79,11 @@ void Error_Handler(void);
 #define McrptOrangeLed_GPIO_Port GPIOB
 #define McrptRedLed_Pin GPIO_PIN_15
 #define McrptRedLed_GPIO_Port GPIOB
+#define SensorRTS_Pin GPIO_PIN_8
+#define SensorRTS_GPIO_Port GPIOC
+#define SensorCTS_Pin GPIO_PIN_9
+#define SensorCTS_GPIO_Port GPIOC
+#define SensorCTS_EXTI_IRQn EXTI9_5_IRQn
 #define TMS_Pin GPIO_PIN_13
 #define TMS_GPIO_Port GPIOA
 #define TCK_Pin GPIO_PIN_14
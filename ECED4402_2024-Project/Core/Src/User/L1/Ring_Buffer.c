@@ -0,0 +1,139 @@
+/*
+ * Ring_Buffer.c
+ *
+ *  Created on: Nov. 28, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <string.h>
+
+#include "main.h"
+#include "User/L1/Ring_Buffer.h"
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "task.h"
+
+/******************************************************************************
+ * @brief Initializes a ring over caller-provided storage.
+ ******************************************************************************/
+void ring_init(RingBuffer* ring, uint8_t* storage, uint32_t size) {
+    configASSERT((size & (size - 1)) == 0); // Size must be a power of two
+
+    ring->buffer = storage;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->consumer = NULL;
+}
+
+/******************************************************************************
+ * @brief Number of bytes currently stored in the ring.
+ ******************************************************************************/
+uint32_t ring_count(const RingBuffer* ring) {
+    return ring->head - ring->tail;
+}
+
+/******************************************************************************
+ * @brief Copies bytes into the ring from the producer (ISR) side.
+ ******************************************************************************/
+uint16_t ring_write_ISR(RingBuffer* ring, const uint8_t* data, uint16_t length,
+                        BaseType_t* pxHigherPriorityTaskWoken) {
+    uint32_t head = ring->head;
+    uint32_t space = (ring->mask + 1) - (head - ring->tail);
+    uint32_t offset = head & ring->mask;
+    uint32_t first;
+
+    if (length > space) {
+        length = space; // Ring full, the caller accounts for the dropped bytes
+    }
+    if (length == 0) {
+        return 0;
+    }
+
+    // Copy in up to two pieces when the write wraps around the end of storage
+    first = (ring->mask + 1) - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(&ring->buffer[offset], data, first);
+    memcpy(ring->buffer, &data[first], length - first);
+
+    __DMB(); // Data must be visible before the new head is published
+    ring->head = head + length;
+    __DMB(); // Publish head before sampling tail below
+
+    // The consumer may only block after seeing head == tail, so a notification
+    // is needed only if it had drained everything written before this call
+    if (ring->tail == head && ring->consumer != NULL) {
+        vTaskNotifyGiveFromISR(ring->consumer, pxHigherPriorityTaskWoken);
+    }
+
+    return length;
+}
+
+/******************************************************************************
+ * @brief Returns the largest contiguous readable span without copying.
+ ******************************************************************************/
+uint16_t ring_read_span(RingBuffer* ring, const uint8_t** span) {
+    uint32_t tail = ring->tail;
+    uint32_t count = ring->head - tail;
+    uint32_t offset = tail & ring->mask;
+    uint32_t contiguous = (ring->mask + 1) - offset;
+
+    __DMB(); // Read head before reading the data it covers
+
+    if (contiguous > count) {
+        contiguous = count;
+    }
+    if (contiguous > UINT16_MAX) {
+        contiguous = UINT16_MAX;
+    }
+
+    *span = &ring->buffer[offset];
+    return contiguous;
+}
+
+/******************************************************************************
+ * @brief Releases bytes previously obtained with ring_read_span().
+ ******************************************************************************/
+void ring_consume(RingBuffer* ring, uint16_t length) {
+    __DMB(); // Finish reading the data before handing the space back
+    ring->tail += length;
+}
+
+/******************************************************************************
+ * @brief Copies up to length bytes out of the ring.
+ ******************************************************************************/
+uint16_t ring_read(RingBuffer* ring, uint8_t* data, uint16_t length) {
+    const uint8_t* span;
+    uint16_t total = 0, count;
+
+    // At most two spans when the readable region wraps
+    while (total < length && (count = ring_read_span(ring, &span)) > 0) {
+        if (count > length - total) {
+            count = length - total;
+        }
+        memcpy(&data[total], span, count);
+        ring_consume(ring, count);
+        total += count;
+    }
+
+    return total;
+}
+
+/******************************************************************************
+ * @brief Blocks the calling task until the ring holds data.
+ ******************************************************************************/
+bool ring_wait(RingBuffer* ring, TickType_t timeout) {
+    ring->consumer = xTaskGetCurrentTaskHandle();
+    __DMB(); // Register as consumer before checking for data
+
+    while (ring_count(ring) == 0) {
+        if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+            return ring_count(ring) > 0; // Timed out
+        }
+    }
+
+    return true;
+}
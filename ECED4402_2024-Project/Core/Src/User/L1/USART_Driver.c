@@ -9,109 +9,1017 @@
 #include <string.h>
 
 #include "main.h"
+#include "stm32f4xx_ll_usart.h"
 #include "User/L1/USART_Driver.h"
+#include "User/L1/Ring_Buffer.h"
 
 
 //Required FreeRTOS header files
 #include "FreeRTOS.h"
 #include "queue.h"
 #include "semphr.h"
+#include "stream_buffer.h"
 
-#define MAX_RX_BUFFER_LENGTH   40
+#define DMA_RX_BUFFER_LENGTH   64
+#define TX_BUFFER_LENGTH       128
+#define RX_RING_LENGTH         128 // Must be a power of two
+#define RX_QUEUE_LENGTH        80
 
-uint8_t rx_buffer_extern[MAX_RX_BUFFER_LENGTH];
-uint8_t rx_buffer_hostPC[MAX_RX_BUFFER_LENGTH];
+#define FLOW_XON   0x11
+#define FLOW_XOFF  0x13
 
-QueueHandle_t Queue_extern_UART;
-QueueHandle_t Queue_hostPC_UART;
+// 1 KB peripheral slot of a USART within its APB bus: USART2 = 17, USART1 = 4, USART6 = 5
+#define USART_SLOT(instance)   ((((uint32_t)(uintptr_t)(instance)) >> 10) & 0x1F)
+#define USART_SLOT_COUNT       32
+
+#if USART_RX_BACKEND == USART_RX_BACKEND_RING
+typedef RingBuffer* RxChannel_t;
+#elif USART_RX_BACKEND == USART_RX_BACKEND_STREAM
+typedef StreamBufferHandle_t RxChannel_t;
+#else
+typedef QueueHandle_t RxChannel_t;
+#endif
 
 extern UART_HandleTypeDef huart2;
 extern UART_HandleTypeDef huart6;
-static SemaphoreHandle_t mutexHandle_printStr_extern;
-static void printStr_local_extern(char * str);
+#if USART_EXTERN2_ENABLE
+extern UART_HandleTypeDef huart1;
+#endif
+
+// Double-buffered DMA transmitter: callers fill one buffer while the other is on the wire
+typedef struct {
+	uint8_t buffer[2][TX_BUFFER_LENGTH]; // Ping-pong buffers
+	volatile uint16_t length[2];         // Bytes queued in each buffer
+	volatile uint8_t fill;               // Index of the buffer being filled by callers
+	volatile bool busy;                  // A DMA burst is in flight
+	volatile bool paused;                // The peer asked us to stop, DMA requests are held off
+	volatile uint8_t flow_pending;       // XON/XOFF waiting for the data register, 0 if none
+	SemaphoreHandle_t mutex;             // Serializes writers so frames are not interleaved
+	SemaphoreHandle_t done;              // Given from the ISR whenever a burst completes
+} UsartTxEngine;
+
+// Everything the driver keeps for one port
+typedef struct {
+	// Fixed configuration
+	UART_HandleTypeDef* huart;
+	const char* name;
+	uint8_t rx_mode;                     // USART_RX_MODE_*
+	uint8_t flow;                        // USART_FLOW_*
+	uint16_t trigger_level;              // Stream buffer backend wake-up level
+	uint8_t* dma_rx_buffer;              // Circular buffer for USART_RX_MODE_DMA, NULL otherwise
+	GPIO_TypeDef* rts_port;              // USART_FLOW_RTSCTS pins
+	uint16_t rts_pin;
+	GPIO_TypeDef* cts_port;
+	uint16_t cts_pin;
+
+	// Receive state
+	RxChannel_t rx;                      // Filled by the ISR, drained by the parser task
+#if USART_RX_BACKEND == USART_RX_BACKEND_RING
+	RingBuffer ring;
+	uint8_t ring_storage[RX_RING_LENGTH];
+#endif
+	uint8_t rx_byte;                     // Landing spot for USART_RX_MODE_IT
+	uint16_t dma_rx_read_pos;            // Next unread byte in dma_rx_buffer
+	volatile bool IsPeerThrottled;       // We asked the peer to stop sending
+
+	UsartTxEngine tx;
+
+	// Written from the ISRs (single 32-bit stores), read with get_usart_stats()
+	struct UsartStats stats;
+#if USART_IRQ_PROFILING
+	struct UsartIrqProfile profile;
+#endif
+} UsartPortDesc;
+
+#if USART_EXTERN_RX_MODE == USART_RX_MODE_DMA
+// Circular buffer written by DMA2 Stream1, consumed from the Rx event callback
+static uint8_t dma_rx_buffer_extern[DMA_RX_BUFFER_LENGTH];
+#define DMA_RX_BUFFER_EXTERN dma_rx_buffer_extern
+#else
+#define DMA_RX_BUFFER_EXTERN NULL
+#endif
+
+static UsartPortDesc usart_ports[USART_PORT_COUNT] = {
+	[USART_PORT_EXTERN] = {
+		.huart = &huart6,
+		.name = "USART6",
+		.rx_mode = USART_EXTERN_RX_MODE,
+		.flow = USART_EXTERN_FLOW_CONTROL,
+		.trigger_level = USART_EXTERN_RX_TRIGGER_LEVEL,
+		.dma_rx_buffer = DMA_RX_BUFFER_EXTERN,
+		.rts_port = SensorRTS_GPIO_Port,
+		.rts_pin = SensorRTS_Pin,
+		.cts_port = SensorCTS_GPIO_Port,
+		.cts_pin = SensorCTS_Pin,
+	},
+	[USART_PORT_HOSTPC] = {
+		.huart = &huart2,
+		.name = "USART2",
+		.rx_mode = USART_HOSTPC_RX_MODE,
+		.flow = USART_FLOW_NONE,
+		.trigger_level = USART_HOSTPC_RX_TRIGGER_LEVEL,
+	},
+#if USART_EXTERN2_ENABLE
+	[USART_PORT_EXTERN2] = {
+		.huart = &huart1,
+		.name = "USART1",
+		.rx_mode = USART_EXTERN2_RX_MODE, // No RX DMA stream is set up for USART1
+		.flow = USART_FLOW_NONE,
+		.trigger_level = USART_EXTERN2_RX_TRIGGER_LEVEL,
+	},
+#endif
+};
+
+// Port index + 1 for each USART slot, 0 for slots that are not in the table
+static uint8_t port_by_slot[USART_SLOT_COUNT];
 
 /******************************************************************************
-This triggers a read and the buffer will be filled asynchronously.
+Finds the descriptor for a HAL handle in constant time. Returns NULL for
+UARTs that are not in the table.
 ******************************************************************************/
-void request_sensor_read(void)
+static UsartPortDesc* port_from_handle(UART_HandleTypeDef *huart)
+{
+	uint8_t entry = port_by_slot[USART_SLOT(huart->Instance)];
+
+	return (entry != 0) ? &usart_ports[entry - 1] : NULL;
+}
+
+/******************************************************************************
+Starts reception on a port, returns the HAL status.
+******************************************************************************/
+static HAL_StatusTypeDef start_read(UsartPortDesc* p)
+{
+	switch(p->rx_mode){
+		case USART_RX_MODE_LL:
+			// RXNE stays enabled, bytes are drained by usart_irq_handler()
+			LL_USART_EnableIT_RXNE(p->huart->Instance);
+			return HAL_OK;
+		case USART_RX_MODE_DMA:
+			// The circular transfer keeps running once started, only arm it when idle
+			if(p->huart->RxState != HAL_UART_STATE_READY){
+				return HAL_OK;
+			}
+			p->dma_rx_read_pos = 0;
+			return HAL_UARTEx_ReceiveToIdle_DMA(p->huart, p->dma_rx_buffer, DMA_RX_BUFFER_LENGTH);
+		default:
+			return HAL_UART_Receive_IT(p->huart, &p->rx_byte, 1);
+	}
+}
+
+/******************************************************************************
+Re-arms reception from an ISR and counts the attempts the HAL refuses.
+******************************************************************************/
+static void rearm_read_ISR(UsartPortDesc* p)
 {
-	HAL_UART_Receive_IT (&huart6, rx_buffer_extern, 1);
+	if(start_read(p) != HAL_OK){
+		p->stats.rearm_failures++;
+	}
 }
 
 /******************************************************************************
 This triggers a read and the buffer will be filled asynchronously.
 ******************************************************************************/
+void request_usart_read(enum UsartPort port)
+{
+	start_read(&usart_ports[port]);
+}
+
+void request_sensor_read(void)
+{
+	request_usart_read(USART_PORT_EXTERN);
+}
+
 void request_hostPC_read(void)
 {
-	HAL_UART_Receive_IT (&huart2, rx_buffer_hostPC, 1);
+	request_usart_read(USART_PORT_HOSTPC);
 }
 
+/******************************************************************************
+Configures a port: creates its RX channel, registers it for callback
+dispatch and starts reception.
+******************************************************************************/
+void configure_usart_port(enum UsartPort port)
+{
+	UsartPortDesc* p = &usart_ports[port];
+
+	// a ring (or queue) will be filled by the UART
+#if USART_RX_BACKEND == USART_RX_BACKEND_RING
+	ring_init(&p->ring, p->ring_storage, RX_RING_LENGTH);
+	p->rx = &p->ring;
+#elif USART_RX_BACKEND == USART_RX_BACKEND_STREAM
+	p->rx = xStreamBufferCreate(RX_RING_LENGTH, p->trigger_level);
+#else
+	p->rx = xQueueCreate(RX_QUEUE_LENGTH, sizeof(uint8_t));
+#endif
 
+	port_by_slot[USART_SLOT(p->huart->Instance)] = port + 1;
+
+	//Start interrupt (or DMA) reception once the channel exists
+	start_read(p);
+}
 
 /******************************************************************************
 Configures the external USART.
 ******************************************************************************/
 void configure_usart_extern(void)
 {
-	//Start interrupt for extern UART
-	request_sensor_read();
+	configure_usart_port(USART_PORT_EXTERN);
+	configure_usart_tx(USART_PORT_EXTERN);
 
-	// a queue will be filled by the external UART
-	Queue_extern_UART = xQueueCreate(80, sizeof(uint8_t));
-
-	mutexHandle_printStr_extern = xSemaphoreCreateMutex();
+#if USART_IRQ_PROFILING
+	// Start the DWT cycle counter used to time the interrupt handlers
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
 }
 
 /******************************************************************************
-Configures the external USART.
+Configures the Host PC USART.
 ******************************************************************************/
 void configure_usart_hostPC(void)
 {
-	//Start interrupt for Host PC UART
-	request_hostPC_read();
+	configure_usart_port(USART_PORT_HOSTPC);
+}
+
+/******************************************************************************
+Returns the name of the UART behind a port.
+******************************************************************************/
+const char* usart_port_name(enum UsartPort port)
+{
+	return usart_ports[port].name;
+}
+
+#if USART_RX_BACKEND == USART_RX_BACKEND_RING
+/******************************************************************************
+Pushes received bytes to a channel. Called from ISR.
+Returns the number of bytes accepted.
+******************************************************************************/
+static uint16_t push_bytes_ISR(RxChannel_t channel, const uint8_t* data, uint16_t length, BaseType_t* pxHigherPriorityTaskWoken)
+{
+	return ring_write_ISR(channel, data, length, pxHigherPriorityTaskWoken);
+}
+
+static uint32_t channel_level(RxChannel_t channel)
+{
+	return ring_count(channel);
+}
+
+/******************************************************************************
+Blocks until the channel holds data, then copies out as much as is available.
+******************************************************************************/
+static uint16_t read_bytes(RxChannel_t channel, uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	if(!ring_wait(channel, timeout)){
+		return 0;
+	}
+	return ring_read(channel, data, length);
+}
+#elif USART_RX_BACKEND == USART_RX_BACKEND_STREAM
+static uint16_t push_bytes_ISR(RxChannel_t channel, const uint8_t* data, uint16_t length, BaseType_t* pxHigherPriorityTaskWoken)
+{
+	// The reader is only woken once the trigger level is reached
+	return xStreamBufferSendFromISR(channel, data, length, pxHigherPriorityTaskWoken);
+}
+
+static uint32_t channel_level(RxChannel_t channel)
+{
+	return xStreamBufferBytesAvailable(channel);
+}
+
+static uint16_t read_bytes(RxChannel_t channel, uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	const TickType_t flush_ticks = pdMS_TO_TICKS(USART_RX_STREAM_FLUSH_MS);
+	TickType_t wait;
+	size_t count;
+
+	// Wait in flush-sized steps so a partial frame is still delivered
+	do {
+		wait = (timeout < flush_ticks) ? timeout : flush_ticks;
+		count = xStreamBufferReceive(channel, data, length, wait);
+		if(timeout != portMAX_DELAY){
+			timeout -= wait;
+		}
+	} while(count == 0 && timeout > 0);
+
+	return count;
+}
+#else
+static uint16_t push_bytes_ISR(RxChannel_t channel, const uint8_t* data, uint16_t length, BaseType_t* pxHigherPriorityTaskWoken)
+{
+	uint16_t count = 0;
+
+	// fill the queue one character at a time
+	while(count < length && xQueueSendToBackFromISR(channel, &data[count], pxHigherPriorityTaskWoken) == pdPASS){
+		count++;
+	}
+	return count;
+}
+
+static uint32_t channel_level(RxChannel_t channel)
+{
+	return uxQueueMessagesWaitingFromISR(channel);
+}
+
+static uint16_t read_bytes(RxChannel_t channel, uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	uint16_t count = 0;
+
+	if(length == 0 || xQueueReceive(channel, &data[count++], timeout) != pdPASS){
+		return 0;
+	}
+	while(count < length && xQueueReceive(channel, &data[count], 0) == pdPASS){
+		count++;
+	}
+	return count;
+}
+#endif
+
+/******************************************************************************
+Copies as much of data as fits into the buffer being filled.
+Must be called with interrupts masked.
+******************************************************************************/
+static uint16_t tx_copy(UsartTxEngine* tx, const uint8_t* data, uint16_t length)
+{
+	uint16_t room = TX_BUFFER_LENGTH - tx->length[tx->fill];
+
+	if(length > room){
+		length = room;
+	}
+	memcpy(&tx->buffer[tx->fill][tx->length[tx->fill]], data, length);
+	tx->length[tx->fill] += length;
+
+	return length;
+}
+
+/******************************************************************************
+Swaps the buffers and starts a DMA burst if the line is idle and data is
+waiting. Everything queued since the last burst goes out as one transfer.
+If the HAL refuses the transfer the swap is undone, so the bytes stay queued
+and the next kick (a write, a completion, a waiter) tries again.
+Must be called with interrupts masked.
+******************************************************************************/
+static void tx_start_burst(UsartPortDesc* p)
+{
+	UsartTxEngine* tx = &p->tx;
+	uint8_t send = tx->fill;
+
+	if(tx->busy || tx->paused || tx->length[send] == 0){
+		return;
+	}
+
+	tx->fill = send ^ 1;
+	tx->length[tx->fill] = 0;
+	tx->busy = true;
+	if(HAL_UART_Transmit_DMA(p->huart, tx->buffer[send], tx->length[send]) != HAL_OK){
+		tx->busy = false;
+		tx->fill = send;
+		p->stats.tx_refused++;
+	}
+}
+
+/******************************************************************************
+Waits for the burst on the wire to complete, kicking the engine first in case
+a burst is waiting to start. If the HAL keeps refusing to start it, retries
+every tick and takes that tick off timeout instead.
+Returns false if timeout ran out. Must be called from a task.
+******************************************************************************/
+static bool tx_wait_done(UsartPortDesc* p, TickType_t* timeout)
+{
+	UsartTxEngine* tx = &p->tx;
+	bool IsRefused;
+
+	taskENTER_CRITICAL();
+	tx_start_burst(p);
+	IsRefused = !tx->busy && !tx->paused && tx->length[tx->fill] != 0;
+	taskEXIT_CRITICAL();
+
+	if(!IsRefused){
+		return xSemaphoreTake(tx->done, *timeout) == pdPASS;
+	}
+	if(*timeout == 0){
+		return false;
+	}
+	vTaskDelay(1);
+	if(*timeout != portMAX_DELAY){
+		(*timeout)--;
+	}
+	return true;
+}
+
+/******************************************************************************
+Writes a pending XON/XOFF to the data register once it is empty and the DMA
+is not feeding it, and stops the TXE interrupt once nothing is left to send.
+A character that has to wait for a burst goes out when that burst completes.
+Must be called with interrupts masked.
+******************************************************************************/
+static void tx_flow_char_ISR(UsartPortDesc* p)
+{
+	UsartTxEngine* tx = &p->tx;
+	USART_TypeDef* usart = p->huart->Instance;
+
+	if(tx->flow_pending != 0 && (!tx->busy || tx->paused) && LL_USART_IsActiveFlag_TXE(usart)){
+		LL_USART_TransmitData8(usart, tx->flow_pending);
+		tx->flow_pending = 0;
+		p->stats.bytes_tx++;
+	}
+	if(tx->flow_pending == 0 || (tx->busy && !tx->paused)){
+		LL_USART_DisableIT_TXE(usart);
+	}
+}
+
+/******************************************************************************
+Marks the current burst as finished and starts the next one. Called from ISR.
+******************************************************************************/
+static void tx_burst_complete_ISR(UsartPortDesc* p)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	p->tx.busy = false;
+	tx_flow_char_ISR(p);
+	tx_start_burst(p);
+	xSemaphoreGiveFromISR(p->tx.done, &xHigherPriorityTaskWoken);
+
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/******************************************************************************
+Holds off or resumes transmission on request of the peer. A burst already in
+flight is paused by masking its DMA requests, so at most the byte in the
+shift register still goes out. Must be called with interrupts masked.
+******************************************************************************/
+static void tx_set_paused(UsartPortDesc* p, bool IsPaused)
+{
+	UsartTxEngine* tx = &p->tx;
+
+	if(tx->paused == IsPaused){
+		return;
+	}
+	if(!IsPaused){
+		tx_flow_char_ISR(p); // Last chance before the DMA owns the data register again
+	}
+	tx->paused = IsPaused;
+
+	if(IsPaused){
+		p->stats.tx_pauses++;
+		ATOMIC_CLEAR_BIT(p->huart->Instance->CR3, USART_CR3_DMAT);
+	}else if(tx->busy){
+		ATOMIC_SET_BIT(p->huart->Instance->CR3, USART_CR3_DMAT);
+	}else{
+		tx_start_burst(p);
+	}
+}
+
+/******************************************************************************
+Sends an XON/XOFF character. It never waits in the DMA buffers, where a
+paused link would hold it back: it goes straight to the data register when
+that is free, else it is kept in a one-byte slot that the TXE interrupt or
+the end of the current burst writes out. A newer character replaces one
+that has not left yet, as only the latest state matters to the peer.
+Must be called with interrupts masked.
+******************************************************************************/
+static void tx_send_flow_char(UsartPortDesc* p, uint8_t c)
+{
+	p->tx.flow_pending = c;
+	tx_flow_char_ISR(p);
+	if(p->tx.flow_pending != 0 && (!p->tx.busy || p->tx.paused)){
+		LL_USART_EnableIT_TXE(p->huart->Instance);
+	}
+}
+
+/******************************************************************************
+Throttles the peer when the RX channel climbs past the high watermark and
+releases it once the parser has drained it below the low one.
+Must be called with interrupts masked.
+******************************************************************************/
+static void flow_update_rx(UsartPortDesc* p, uint32_t level)
+{
+	if(p->flow == USART_FLOW_NONE){
+		return;
+	}
+
+	if(!p->IsPeerThrottled && level >= USART_RX_HIGH_WATERMARK){
+		p->IsPeerThrottled = true;
+		p->stats.rx_throttles++;
+	}else if(p->IsPeerThrottled && level <= USART_RX_LOW_WATERMARK){
+		p->IsPeerThrottled = false;
+	}else{
+		return;
+	}
+
+	if(p->flow == USART_FLOW_RTSCTS){
+		HAL_GPIO_WritePin(p->rts_port, p->rts_pin, p->IsPeerThrottled ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	}else{
+		tx_send_flow_char(p, p->IsPeerThrottled ? FLOW_XOFF : FLOW_XON);
+	}
+}
+
+/******************************************************************************
+Pushes a span into a port's channel and updates its counters.
+Called from ISR. Returns the number of bytes accepted.
+******************************************************************************/
+static uint16_t push_span_ISR(UsartPortDesc* p, const uint8_t* data, uint16_t length, BaseType_t* pxHigherPriorityTaskWoken)
+{
+	uint16_t accepted;
+	uint32_t level;
+
+	accepted = push_bytes_ISR(p->rx, data, length, pxHigherPriorityTaskWoken);
+	level = channel_level(p->rx);
+
+	p->stats.bytes_rx += accepted;
+	p->stats.rx_dropped += length - accepted;
+	if(level > p->stats.rx_peak_level){
+		p->stats.rx_peak_level = level;
+	}
+
+	flow_update_rx(p, level);
 
-	// a queue will be filled by the Host PC UART
-	Queue_hostPC_UART = xQueueCreate(80, sizeof(uint8_t));
+	return accepted;
 }
 
+/******************************************************************************
+Hands received bytes to a port's channel. With XON/XOFF the control
+characters are acted on here and never reach the parser.
+Called from ISR. Returns the number of bytes accepted.
+******************************************************************************/
+static uint16_t deliver_bytes_ISR(UsartPortDesc* p, const uint8_t* data, uint16_t length, BaseType_t* pxHigherPriorityTaskWoken)
+{
+	uint16_t accepted = 0, start = 0;
+
+	if(p->flow != USART_FLOW_XONXOFF){
+		return push_span_ISR(p, data, length, pxHigherPriorityTaskWoken);
+	}
+
+	for(uint16_t idx = 0; idx < length; idx++){
+		if(data[idx] == FLOW_XON || data[idx] == FLOW_XOFF){
+			accepted += push_span_ISR(p, &data[start], idx - start, pxHigherPriorityTaskWoken);
+			tx_set_paused(p, data[idx] == FLOW_XOFF);
+			start = idx + 1;
+		}
+	}
+	return accepted + push_span_ISR(p, &data[start], length - start, pxHigherPriorityTaskWoken);
+}
 
 /******************************************************************************
+Copies a port's link health counters.
+******************************************************************************/
+void get_usart_stats(enum UsartPort port, struct UsartStats* stats)
+{
+	taskENTER_CRITICAL();
+	*stats = usart_ports[port].stats;
+	taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+Reads bytes received on a port. Blocks until at least one byte is available
+and returns how many were copied (0 on timeout).
+******************************************************************************/
+uint16_t read_usart_bytes(enum UsartPort port, uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	uint16_t count = read_bytes(p->rx, data, length, timeout);
+
+	// Draining may have taken the channel below the low watermark
+	if(p->flow != USART_FLOW_NONE){
+		taskENTER_CRITICAL();
+		flow_update_rx(p, channel_level(p->rx));
+		taskEXIT_CRITICAL();
+	}
+
+	return count;
+}
+
+/******************************************************************************
+Reads bytes received from the sensor link, see read_usart_bytes().
+******************************************************************************/
+uint16_t read_sensor_bytes(uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	return read_usart_bytes(USART_PORT_EXTERN, data, length, timeout);
+}
+
+/******************************************************************************
+Reads bytes received from the Host PC, see read_usart_bytes().
+******************************************************************************/
+uint16_t read_hostPC_bytes(uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	return read_usart_bytes(USART_PORT_HOSTPC, data, length, timeout);
+}
+
+
+/******************************************************************************
+Called by the HAL for ports in USART_RX_MODE_IT, one byte at a time.
 ******************************************************************************/
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-	BaseType_t xStatus;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	UsartPortDesc* p = port_from_handle(huart);
+
+	if(p == NULL){
+		return;
+	}
 
 	//Toggle onboard LED
 	HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
 
-	if(huart == &huart2){//Handle Host PC RX UART
-		// fill the queue one character at a time
-		xStatus = xQueueSendToBackFromISR(Queue_hostPC_UART, rx_buffer_hostPC, 0);
+	if(deliver_bytes_ISR(p, &p->rx_byte, 1, &xHigherPriorityTaskWoken) == 1){
+		//Toggle onboard LED
+		HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
+	}
 
-		//Request UART Interrupt Rx
-		request_hostPC_read();
-	}else if(huart == &huart6){//Handle extern RX UART
-		// fill the queue one character at a time
-		xStatus = xQueueSendToBackFromISR(Queue_extern_UART, rx_buffer_extern, 0);
+	//Request UART Interrupt Rx
+	rearm_read_ISR(p);
 
-		//Request UART Interrupt Rx
-		request_sensor_read();
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+
+/******************************************************************************
+Register-level receive path. Reads DR straight into the channel; the SR read
+followed by the DR read also clears ORE/FE/NE/PE, so errors are only counted.
+Returns false if another enabled source (Tx complete, idle line) is pending
+and the HAL handler still has to run.
+******************************************************************************/
+static bool usart_ll_rx_irq(UsartPortDesc* p)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	USART_TypeDef* usart = p->huart->Instance;
+	uint32_t sr = LL_USART_ReadReg(usart, SR);
+	uint32_t cr1 = LL_USART_ReadReg(usart, CR1);
+	uint8_t data;
+
+	if(sr & (USART_SR_RXNE | USART_SR_ORE)){
+		data = LL_USART_ReceiveData8(usart);
+
+		if(sr & (USART_SR_ORE | USART_SR_FE | USART_SR_NE | USART_SR_PE)){
+			p->stats.overrun_errors += (sr & USART_SR_ORE) ? 1 : 0;
+			p->stats.framing_errors += (sr & USART_SR_FE) ? 1 : 0;
+			p->stats.noise_errors += (sr & USART_SR_NE) ? 1 : 0;
+			p->stats.parity_errors += (sr & USART_SR_PE) ? 1 : 0;
+		}
+
+		// A framing or parity error means the byte itself is corrupt
+		if((sr & (USART_SR_FE | USART_SR_PE)) == 0){
+			deliver_bytes_ISR(p, &data, 1, &xHigherPriorityTaskWoken);
+		}
 	}
 
-	if(xStatus == pdPASS){
-		//Toggle onboard LED
-		HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+
+	return !(((cr1 & USART_CR1_TCIE) && (sr & USART_SR_TC)) ||
+			((cr1 & USART_CR1_TXEIE) && (sr & USART_SR_TXE)) ||
+			((cr1 & USART_CR1_IDLEIE) && (sr & USART_SR_IDLE)));
+}
+
+/******************************************************************************
+Entry point for the USART interrupts (called from stm32f4xx_it.c).
+The TXE interrupt only ever carries a pending XON/XOFF and is served here,
+before the HAL could mistake it for an interrupt driven transmit.
+Ports in USART_RX_MODE_LL receive without the HAL; everything else is
+passed on to HAL_UART_IRQHandler().
+******************************************************************************/
+void usart_irq_handler(enum UsartPort port)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	bool IsHandled = false;
+#if USART_IRQ_PROFILING
+	uint32_t start = DWT->CYCCNT, cycles;
+#endif
+
+	if(LL_USART_IsEnabledIT_TXE(p->huart->Instance)){
+		tx_flow_char_ISR(p);
 	}
 
+	if(p->rx_mode == USART_RX_MODE_LL){
+		IsHandled = usart_ll_rx_irq(p);
+	}
+
+	if(!IsHandled){
+		HAL_UART_IRQHandler(p->huart);
+	}
+
+#if USART_IRQ_PROFILING
+	cycles = DWT->CYCCNT - start;
+	p->profile.count++;
+	p->profile.total_cycles += cycles;
+	if(cycles > p->profile.max_cycles){
+		p->profile.max_cycles = cycles;
+	}
+#endif
 }
 
+/******************************************************************************
+Copies the interrupt cost measured for a port. All zero unless
+USART_IRQ_PROFILING is enabled.
+******************************************************************************/
+void get_usart_irq_profile(enum UsartPort port, struct UsartIrqProfile* profile)
+{
+#if USART_IRQ_PROFILING
+	taskENTER_CRITICAL();
+	*profile = usart_ports[port].profile;
+	taskEXIT_CRITICAL();
+#else
+	static const struct UsartIrqProfile EmptyProfile = {0};
+	*profile = EmptyProfile;
+#endif
+}
 
-void printStr_extern(char * str){
-	xSemaphoreTake(mutexHandle_printStr_extern, portMAX_DELAY);
-	printStr_local_extern(str);
-	xSemaphoreGive(mutexHandle_printStr_extern);
+/******************************************************************************
+Called by the HAL on idle line, half transfer and transfer complete events
+for ports in USART_RX_MODE_DMA. Size is the current DMA write position
+within the circular buffer; everything since the last event is forwarded,
+so the whole burst costs a single interrupt.
+******************************************************************************/
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	UsartPortDesc* p = port_from_handle(huart);
+
+	if(p == NULL || p->rx_mode != USART_RX_MODE_DMA || Size == p->dma_rx_read_pos){
+		return;
+	}
+
+	if(Size > p->dma_rx_read_pos){
+		deliver_bytes_ISR(p, &p->dma_rx_buffer[p->dma_rx_read_pos],
+				Size - p->dma_rx_read_pos, &xHigherPriorityTaskWoken);
+	}else{// DMA wrapped around since the last event
+		deliver_bytes_ISR(p, &p->dma_rx_buffer[p->dma_rx_read_pos],
+				DMA_RX_BUFFER_LENGTH - p->dma_rx_read_pos, &xHigherPriorityTaskWoken);
+		deliver_bytes_ISR(p, p->dma_rx_buffer, Size, &xHigherPriorityTaskWoken);
+	}
+	p->dma_rx_read_pos = (Size == DMA_RX_BUFFER_LENGTH) ? 0 : Size;
+
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
-static void printStr_local_extern(char * str){
-	HAL_UART_Transmit(&huart6,(uint8_t*) str, strlen(str), HAL_MAX_DELAY);
+/******************************************************************************
+Creates the transmit engine for a port. Must be called before the first write.
+******************************************************************************/
+void configure_usart_tx(enum UsartPort port)
+{
+	UsartPortDesc* p = &usart_ports[port];
+
+	p->tx.mutex = xSemaphoreCreateMutex();
+	p->tx.done = xSemaphoreCreateBinary();
+	port_by_slot[USART_SLOT(p->huart->Instance)] = port + 1;
+
+	// The peer may already be holding CTS high
+	if(p->flow == USART_FLOW_RTSCTS){
+		p->tx.paused = (HAL_GPIO_ReadPin(p->cts_port, p->cts_pin) == GPIO_PIN_SET);
+	}
+}
+
+/******************************************************************************
+Queues a frame given as a list of segments (static header, formatted payload,
+trailer...) and returns as soon as it has been gathered into the DMA buffer.
+The segments go straight into the buffer the DMA reads from, so callers never
+assemble the frame themselves, and the frame is never split by another writer.
+Blocks (up to timeout) only while both buffers are full.
+Returns false if the frame could not be queued completely in time.
+******************************************************************************/
+bool usart_tx_writev(enum UsartPort port, const struct UsartTxSegment* segments, uint8_t count, TickType_t timeout)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	UsartTxEngine* tx = &p->tx;
+	const uint8_t* data;
+	uint16_t length, copied;
+	bool IsQueued = true;
+
+	if(xSemaphoreTake(tx->mutex, timeout) != pdPASS){
+		return false;
+	}
+
+	for(uint8_t seg = 0; seg < count && IsQueued; seg++){
+		data = segments[seg].data;
+		length = segments[seg].length;
+
+		while(length > 0){
+			taskENTER_CRITICAL();
+			copied = tx_copy(tx, data, length);
+			p->stats.bytes_tx += copied;
+			// Only kick the DMA early when the buffer is full
+			if(copied < length){
+				tx_start_burst(p);
+			}
+			taskEXIT_CRITICAL();
+
+			data += copied;
+			length -= copied;
+
+			// Backpressure: wait for the burst on the wire to free a buffer
+			if(length > 0 && !tx_wait_done(p, &timeout)){
+				p->stats.tx_dropped += length;
+				IsQueued = false;
+				break;
+			}
+		}
+	}
+
+	// Send the whole frame as one burst if the line is idle
+	taskENTER_CRITICAL();
+	tx_start_burst(p);
+	taskEXIT_CRITICAL();
+
+	xSemaphoreGive(tx->mutex);
+	return IsQueued;
+}
+
+/******************************************************************************
+Queues data for transmission, see usart_tx_writev().
+******************************************************************************/
+bool usart_tx_write(enum UsartPort port, const uint8_t* data, uint16_t length, TickType_t timeout)
+{
+	const struct UsartTxSegment segment = { data, length };
+
+	return usart_tx_writev(port, &segment, 1, timeout);
+}
+
+/******************************************************************************
+ISR-safe variant of usart_tx_write(). Never blocks, returns false if the
+data did not fit.
+******************************************************************************/
+bool usart_tx_write_ISR(enum UsartPort port, const uint8_t* data, uint16_t length)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	UBaseType_t uxSavedInterruptStatus;
+	uint16_t copied;
+
+	uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+	copied = tx_copy(&p->tx, data, length);
+	tx_start_burst(p);
+	p->stats.bytes_tx += copied;
+	p->stats.tx_dropped += length - copied;
+	taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+
+	return copied == length;
+}
+
+/******************************************************************************
+Waits until everything queued on the port has left the UART, including bytes
+held back while the peer has paused us.
+******************************************************************************/
+bool usart_tx_flush(enum UsartPort port, TickType_t timeout)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	UsartTxEngine* tx = &p->tx;
+
+	while(tx->busy || tx->length[tx->fill] != 0){
+		if(!tx_wait_done(p, &timeout)){
+			return false;
+		}
+	}
+	return true;
+}
+
+/******************************************************************************
+Waits until nothing is queued behind the burst on the wire, so the next write
+goes out as soon as the line frees up and nothing written after it has to
+wait for more than one frame. The burst semaphore is waited on without the
+writer mutex, so writers are not held up meanwhile; the mutex is then taken
+only to re-check the buffer, as a writer may have been mid-frame.
+A completion taken from under another waiter (a writer waiting for room,
+usart_tx_flush()) only delays it: the ISR has already started the burst whose
+completion wakes it.
+******************************************************************************/
+bool usart_tx_wait_ready(enum UsartPort port, TickType_t timeout)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	UsartTxEngine* tx = &p->tx;
+	bool IsReady = false;
+
+	while(!IsReady){
+		while(tx->length[tx->fill] != 0){
+			if(!tx_wait_done(p, &timeout)){
+				return false;
+			}
+		}
+
+		if(xSemaphoreTake(tx->mutex, timeout) != pdPASS){
+			return false;
+		}
+		IsReady = (tx->length[tx->fill] == 0);
+		xSemaphoreGive(tx->mutex);
+	}
+	return true;
+}
+
+/******************************************************************************
+Returns the baud rate a port is currently running at.
+******************************************************************************/
+uint32_t usart_get_baud(enum UsartPort port)
+{
+	return usart_ports[port].huart->Init.BaudRate;
+}
+
+/******************************************************************************
+Returns the highest baud rate the port's bus clock can generate.
+USART1 and USART6 sit on APB2, USART2 on APB1.
+******************************************************************************/
+uint32_t usart_max_baud(enum UsartPort port)
+{
+	UART_HandleTypeDef* huart = usart_ports[port].huart;
+	uint32_t pclk;
+
+	if(huart->Instance == USART1 || huart->Instance == USART6){
+		pclk = HAL_RCC_GetPCLK2Freq();
+	}else{
+		pclk = HAL_RCC_GetPCLK1Freq();
+	}
+
+	return pclk / ((huart->Init.OverSampling == UART_OVERSAMPLING_8) ? 8 : 16);
+}
+
+/******************************************************************************
+Switches a port to a new baud rate. Waits for queued output to leave the
+UART first, and holds the writer mutex so no frame straddles the change.
+Bytes being received at the moment of the switch are discarded.
+Returns false, with the rate unchanged, if the mutex or the flush took longer
+than timeout. Must be called from a task.
+******************************************************************************/
+bool usart_set_baud(enum UsartPort port, uint32_t baud, TickType_t timeout)
+{
+	UsartPortDesc* p = &usart_ports[port];
+	bool IsChanged;
+
+	if(baud == 0 || baud > usart_max_baud(port)){
+		return false;
+	}
+	if(xSemaphoreTake(p->tx.mutex, timeout) != pdPASS){
+		return false;
+	}
+
+	// Writers are held off, so at most the two buffers are left to drain
+	if(!usart_tx_flush(port, timeout)){
+		xSemaphoreGive(p->tx.mutex);
+		return false;
+	}
+
+	HAL_UART_AbortReceive(p->huart);
+	p->huart->Init.BaudRate = baud;
+	IsChanged = (HAL_UART_Init(p->huart) == HAL_OK);
+
+	start_read(p);
+
+	xSemaphoreGive(p->tx.mutex);
+	return IsChanged;
+}
+
+/******************************************************************************
+CTS edge from a peer: high means stop, low means go.
+******************************************************************************/
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	UBaseType_t uxSavedInterruptStatus;
+
+	for(int idx = 0; idx < USART_PORT_COUNT; idx++){
+		UsartPortDesc* p = &usart_ports[idx];
+
+		if(p->flow == USART_FLOW_RTSCTS && p->cts_pin == GPIO_Pin){
+			uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+			tx_set_paused(p, HAL_GPIO_ReadPin(p->cts_port, p->cts_pin) == GPIO_PIN_SET);
+			taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+		}
+	}
+}
+
+/******************************************************************************
+Called by the HAL once a DMA burst has been shifted out completely.
+******************************************************************************/
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	UsartPortDesc* p = port_from_handle(huart);
+
+	if(p != NULL){
+		tx_burst_complete_ISR(p);
+	}
+}
+
+/******************************************************************************
+Reception errors (overrun, framing, noise) abort the pending transfer,
+so they are counted and reception is re-armed here.
+******************************************************************************/
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	UsartPortDesc* p = port_from_handle(huart);
+
+	if(p == NULL){
+		return;
+	}
+
+	p->stats.overrun_errors += (huart->ErrorCode & HAL_UART_ERROR_ORE) ? 1 : 0;
+	p->stats.framing_errors += (huart->ErrorCode & HAL_UART_ERROR_FE) ? 1 : 0;
+	p->stats.noise_errors += (huart->ErrorCode & HAL_UART_ERROR_NE) ? 1 : 0;
+	p->stats.parity_errors += (huart->ErrorCode & HAL_UART_ERROR_PE) ? 1 : 0;
+
+	if(p->rx != NULL && huart->RxState == HAL_UART_STATE_READY){
+		rearm_read_ISR(p);
+	}
+
+	// A DMA transfer error ends the burst without a Tx complete callback
+	if(p->tx.busy && huart->gState == HAL_UART_STATE_READY){
+		tx_burst_complete_ISR(p);
+	}
+}
+
+void printStr_extern(char * str){
+	usart_tx_write(USART_PORT_EXTERN, (uint8_t*) str, strlen(str), portMAX_DELAY);
 }
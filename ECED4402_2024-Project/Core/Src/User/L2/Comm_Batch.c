@@ -0,0 +1,133 @@
+/*
+ * Comm_Batch.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_Batch.h" // Header for batching
+#include "User/L2/Comm_Reliable.h" // Header for reliable delivery
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "timers.h"
+
+// Platform: only ever touched in the timer task, by the sensor timers, the
+// flush timer and the handshake pended to it, so sends never hold a lock and
+// readings go out in the order they were taken.
+static struct CommMessage Pending[BINARY_BATCH_MAX]; // Readings waiting to be sent
+static uint8_t PendingCount = 0;
+static uint8_t MaxCount = 0;          // Negotiated limits, 0 when batching is off
+static uint16_t MaxDelayMs = 0;
+static TimerHandle_t TimerID_Flush;
+static struct BatchStats Stats;
+
+/******************************************************************************
+ * @brief Sends the waiting readings, if any. Runs in the timer task.
+ ******************************************************************************/
+static void batch_flush(void) {
+    if (PendingCount == 0) {
+        return;
+    }
+    send_sensorDataBatch_message(Pending, PendingCount);
+    if (PendingCount > 1) {
+        Stats.frames++;
+        Stats.readings += PendingCount;
+    }
+    PendingCount = 0;
+}
+
+/******************************************************************************
+ * @brief Timer callback: the oldest waiting reading has waited MaxDelayMs.
+ ******************************************************************************/
+static void batch_delay_expired(TimerHandle_t xTimer) {
+    if (PendingCount != 0) {
+        Stats.flush_delay++;
+        batch_flush();
+    }
+}
+
+/******************************************************************************
+ * @brief Creates the flush timer.
+ ******************************************************************************/
+void initialize_batching(void) {
+    TimerID_Flush = xTimerCreate(
+        "Batch Flush",
+        pdMS_TO_TICKS(BATCH_MAX_DELAY_MS),
+        pdFALSE,    // One shot: started by the first reading of each batch
+        (void*)0,
+        batch_delay_expired
+        );
+}
+
+/******************************************************************************
+ * @brief Pended to the timer task by the handshake: readings batched under
+ * the old limits go out first, then the new ones apply.
+ ******************************************************************************/
+static void batch_apply_limits(void* unused, uint32_t params) {
+    batch_flush();
+    xTimerStop(TimerID_Flush, 0);
+    MaxCount = BATCH_PARAMS_COUNT(params);
+    MaxDelayMs = BATCH_PARAMS_DELAY_MS(params);
+    Stats.max_count = MaxCount;
+    Stats.max_delay_ms = MaxDelayMs;
+}
+
+/******************************************************************************
+ * @brief Platform side of the handshake. The limits are handed to the timer
+ * task, which owns the batch, instead of being changed under it.
+ ******************************************************************************/
+void batch_handle_request(uint16_t params) {
+    uint8_t count = BATCH_PARAMS_COUNT(params);
+    uint16_t delay_ms = BATCH_PARAMS_DELAY_MS(params);
+
+    if (comm_framing_is_ascii(get_sensor_framing()) || reliable_is_active() || count < 2) {
+        count = 0;
+        delay_ms = 0;
+    } else {
+        if (count > BINARY_BATCH_MAX) {
+            count = BINARY_BATCH_MAX;
+        }
+        if (delay_ms < BATCH_DELAY_UNIT_MS) {
+            delay_ms = BATCH_DELAY_UNIT_MS; // A batch must always be sent eventually
+        }
+    }
+
+    xTimerPendFunctionCall(batch_apply_limits, NULL, BATCH_PARAMS(count, delay_ms), portMAX_DELAY);
+    send_batch_message(BATCH_PARAMS(count, delay_ms));
+}
+
+void batch_start(uint16_t params) {
+    Stats.max_count = BATCH_PARAMS_COUNT(params);
+    Stats.max_delay_ms = BATCH_PARAMS_DELAY_MS(params);
+}
+
+/******************************************************************************
+ * @brief Platform side. Runs in the sensor timer callbacks, in the timer task,
+ * so the timer commands are not allowed to block.
+ ******************************************************************************/
+bool batch_add(const struct CommMessage* message) {
+    if (MaxCount == 0 || message->HasSeq) {
+        return false;
+    }
+
+    Pending[PendingCount++] = *message;
+    if (PendingCount >= MaxCount) {
+        Stats.flush_full++;
+        batch_flush();
+        xTimerStop(TimerID_Flush, 0);
+    } else if (PendingCount == 1) {
+        xTimerChangePeriod(TimerID_Flush, pdMS_TO_TICKS(MaxDelayMs), 0); // Also starts it
+    }
+    return true;
+}
+
+void batch_record_received(uint8_t readings) {
+    Stats.frames++;
+    Stats.readings += readings;
+}
+
+void get_batch_stats(struct BatchStats* stats) {
+    *stats = Stats;
+}
@@ -0,0 +1,494 @@
+/*
+ * Comm_Binary.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_Binary.h" // Header for binary framing
+
+#if COMM_CRC_HARDWARE
+#include "main.h" // CRC unit registers
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+static bool IsCrcUnitValid = false; // Set by the self-test in initialize_binary_framing()
+#else
+// CRC-32/MPEG-2 of every byte value, for the host build
+static const uint32_t Crc32Table[256] = {
+    0x00000000U, 0x04C11DB7U, 0x09823B6EU, 0x0D4326D9U, 0x130476DCU, 0x17C56B6BU,
+    0x1A864DB2U, 0x1E475005U, 0x2608EDB8U, 0x22C9F00FU, 0x2F8AD6D6U, 0x2B4BCB61U,
+    0x350C9B64U, 0x31CD86D3U, 0x3C8EA00AU, 0x384FBDBDU, 0x4C11DB70U, 0x48D0C6C7U,
+    0x4593E01EU, 0x4152FDA9U, 0x5F15ADACU, 0x5BD4B01BU, 0x569796C2U, 0x52568B75U,
+    0x6A1936C8U, 0x6ED82B7FU, 0x639B0DA6U, 0x675A1011U, 0x791D4014U, 0x7DDC5DA3U,
+    0x709F7B7AU, 0x745E66CDU, 0x9823B6E0U, 0x9CE2AB57U, 0x91A18D8EU, 0x95609039U,
+    0x8B27C03CU, 0x8FE6DD8BU, 0x82A5FB52U, 0x8664E6E5U, 0xBE2B5B58U, 0xBAEA46EFU,
+    0xB7A96036U, 0xB3687D81U, 0xAD2F2D84U, 0xA9EE3033U, 0xA4AD16EAU, 0xA06C0B5DU,
+    0xD4326D90U, 0xD0F37027U, 0xDDB056FEU, 0xD9714B49U, 0xC7361B4CU, 0xC3F706FBU,
+    0xCEB42022U, 0xCA753D95U, 0xF23A8028U, 0xF6FB9D9FU, 0xFBB8BB46U, 0xFF79A6F1U,
+    0xE13EF6F4U, 0xE5FFEB43U, 0xE8BCCD9AU, 0xEC7DD02DU, 0x34867077U, 0x30476DC0U,
+    0x3D044B19U, 0x39C556AEU, 0x278206ABU, 0x23431B1CU, 0x2E003DC5U, 0x2AC12072U,
+    0x128E9DCFU, 0x164F8078U, 0x1B0CA6A1U, 0x1FCDBB16U, 0x018AEB13U, 0x054BF6A4U,
+    0x0808D07DU, 0x0CC9CDCAU, 0x7897AB07U, 0x7C56B6B0U, 0x71159069U, 0x75D48DDEU,
+    0x6B93DDDBU, 0x6F52C06CU, 0x6211E6B5U, 0x66D0FB02U, 0x5E9F46BFU, 0x5A5E5B08U,
+    0x571D7DD1U, 0x53DC6066U, 0x4D9B3063U, 0x495A2DD4U, 0x44190B0DU, 0x40D816BAU,
+    0xACA5C697U, 0xA864DB20U, 0xA527FDF9U, 0xA1E6E04EU, 0xBFA1B04BU, 0xBB60ADFCU,
+    0xB6238B25U, 0xB2E29692U, 0x8AAD2B2FU, 0x8E6C3698U, 0x832F1041U, 0x87EE0DF6U,
+    0x99A95DF3U, 0x9D684044U, 0x902B669DU, 0x94EA7B2AU, 0xE0B41DE7U, 0xE4750050U,
+    0xE9362689U, 0xEDF73B3EU, 0xF3B06B3BU, 0xF771768CU, 0xFA325055U, 0xFEF34DE2U,
+    0xC6BCF05FU, 0xC27DEDE8U, 0xCF3ECB31U, 0xCBFFD686U, 0xD5B88683U, 0xD1799B34U,
+    0xDC3ABDEDU, 0xD8FBA05AU, 0x690CE0EEU, 0x6DCDFD59U, 0x608EDB80U, 0x644FC637U,
+    0x7A089632U, 0x7EC98B85U, 0x738AAD5CU, 0x774BB0EBU, 0x4F040D56U, 0x4BC510E1U,
+    0x46863638U, 0x42472B8FU, 0x5C007B8AU, 0x58C1663DU, 0x558240E4U, 0x51435D53U,
+    0x251D3B9EU, 0x21DC2629U, 0x2C9F00F0U, 0x285E1D47U, 0x36194D42U, 0x32D850F5U,
+    0x3F9B762CU, 0x3B5A6B9BU, 0x0315D626U, 0x07D4CB91U, 0x0A97ED48U, 0x0E56F0FFU,
+    0x1011A0FAU, 0x14D0BD4DU, 0x19939B94U, 0x1D528623U, 0xF12F560EU, 0xF5EE4BB9U,
+    0xF8AD6D60U, 0xFC6C70D7U, 0xE22B20D2U, 0xE6EA3D65U, 0xEBA91BBCU, 0xEF68060BU,
+    0xD727BBB6U, 0xD3E6A601U, 0xDEA580D8U, 0xDA649D6FU, 0xC423CD6AU, 0xC0E2D0DDU,
+    0xCDA1F604U, 0xC960EBB3U, 0xBD3E8D7EU, 0xB9FF90C9U, 0xB4BCB610U, 0xB07DABA7U,
+    0xAE3AFBA2U, 0xAAFBE615U, 0xA7B8C0CCU, 0xA379DD7BU, 0x9B3660C6U, 0x9FF77D71U,
+    0x92B45BA8U, 0x9675461FU, 0x8832161AU, 0x8CF30BADU, 0x81B02D74U, 0x857130C3U,
+    0x5D8A9099U, 0x594B8D2EU, 0x5408ABF7U, 0x50C9B640U, 0x4E8EE645U, 0x4A4FFBF2U,
+    0x470CDD2BU, 0x43CDC09CU, 0x7B827D21U, 0x7F436096U, 0x7200464FU, 0x76C15BF8U,
+    0x68860BFDU, 0x6C47164AU, 0x61043093U, 0x65C52D24U, 0x119B4BE9U, 0x155A565EU,
+    0x18197087U, 0x1CD86D30U, 0x029F3D35U, 0x065E2082U, 0x0B1D065BU, 0x0FDC1BECU,
+    0x3793A651U, 0x3352BBE6U, 0x3E119D3FU, 0x3AD08088U, 0x2497D08DU, 0x2056CD3AU,
+    0x2D15EBE3U, 0x29D4F654U, 0xC5A92679U, 0xC1683BCEU, 0xCC2B1D17U, 0xC8EA00A0U,
+    0xD6AD50A5U, 0xD26C4D12U, 0xDF2F6BCBU, 0xDBEE767CU, 0xE3A1CBC1U, 0xE760D676U,
+    0xEA23F0AFU, 0xEEE2ED18U, 0xF0A5BD1DU, 0xF464A0AAU, 0xF9278673U, 0xFDE69BC4U,
+    0x89B8FD09U, 0x8D79E0BEU, 0x803AC667U, 0x84FBDBD0U, 0x9ABC8BD5U, 0x9E7D9662U,
+    0x933EB0BBU, 0x97FFAD0CU, 0xAFB010B1U, 0xAB710D06U, 0xA6322BDFU, 0xA2F33668U,
+    0xBCB4666DU, 0xB8757BDAU, 0xB5365D03U, 0xB1F740B4U,
+};
+#endif
+
+#if COMM_CRC_HARDWARE
+/******************************************************************************
+ * @brief CRC-32/MPEG-2 one bit at a time, continuing from crc. Adds the bytes
+ * after the last whole word, and is the reference the CRC unit is checked
+ * against.
+ ******************************************************************************/
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t* data, uint16_t length) {
+    for (uint16_t idx = 0; idx < length; idx++) {
+        crc ^= (uint32_t)data[idx] << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+        }
+    }
+    return crc;
+}
+#endif
+
+/******************************************************************************
+ * @brief Enables the CRC unit. It has no configuration: reset loads 0xFFFFFFFF
+ * and the polynomial is fixed at 0x04C11DB7. The unit is then checked against
+ * the bitwise CRC over lengths leaving 0 to 3 bytes after the last word; if
+ * any result differs, CRC-32 is computed in software from then on.
+ ******************************************************************************/
+void initialize_binary_framing(void) {
+#if COMM_CRC_HARDWARE
+    static const uint8_t Pattern[] = {
+        '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x00, 0xFF, 0x5A, 0xA5, 0x80, 0x01
+    };
+
+    __HAL_RCC_CRC_CLK_ENABLE();
+    IsCrcUnitValid = true;
+    for (uint16_t length = 4; length <= sizeof(Pattern) && IsCrcUnitValid; length++) {
+        IsCrcUnitValid = (crc32_mpeg2(Pattern, length) == crc32_bitwise(0xFFFFFFFF, Pattern, length));
+    }
+#endif
+}
+
+bool crc32_is_hardware(void) {
+#if COMM_CRC_HARDWARE
+    return IsCrcUnitValid;
+#else
+    return false;
+#endif
+}
+
+/******************************************************************************
+ * @brief CRC-16/CCITT-FALSE, one bit at a time. Most frames are under ten
+ * bytes and batches go out a few times a second, so a lookup table is not
+ * worth its flash.
+ ******************************************************************************/
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t* data, uint16_t length) {
+    for (uint16_t idx = 0; idx < length; idx++) {
+        crc ^= (uint16_t)data[idx] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/******************************************************************************
+ * @brief CRC-32/MPEG-2. The CRC unit takes 32-bit words, most significant byte
+ * first, which is the same as feeding it the bytes in order; the last 0 to 3
+ * bytes are added in software from the unit's result. Until the self-test
+ * has passed every byte is added in software. The unit is shared by
+ * every task that sends or receives, so it is only held with interrupts masked,
+ * for at most a few words.
+ ******************************************************************************/
+uint32_t crc32_mpeg2(const uint8_t* data, uint16_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    uint16_t idx = 0;
+
+#if COMM_CRC_HARDWARE
+    if (length >= 4 && IsCrcUnitValid) {
+        taskENTER_CRITICAL();
+        CRC->CR = CRC_CR_RESET;
+        for (; idx + 4 <= length; idx += 4) {
+            CRC->DR = ((uint32_t)data[idx] << 24) | ((uint32_t)data[idx + 1] << 16)
+                    | ((uint32_t)data[idx + 2] << 8) | data[idx + 3];
+        }
+        crc = CRC->DR;
+        taskEXIT_CRITICAL();
+    }
+    crc = crc32_bitwise(crc, &data[idx], length - idx);
+#else
+    for (; idx < length; idx++) {
+        crc = (crc << 8) ^ Crc32Table[(crc >> 24) ^ data[idx]];
+    }
+#endif
+    return crc;
+}
+
+/******************************************************************************
+ * @brief Consistent Overhead Byte Stuffing. Every zero is replaced by the
+ * distance to the next one, so the encoded bytes never contain the delimiter.
+ *
+ * @return Number of bytes written to out (length + 1 for frames under 254 bytes).
+ ******************************************************************************/
+static uint16_t cobs_encode(const uint8_t* in, uint16_t length, uint8_t* out) {
+    uint16_t write = 1, code_idx = 0;
+    uint8_t code = 1;
+
+    for (uint16_t read = 0; read < length; read++) {
+        if (in[read] == 0) {
+            out[code_idx] = code;
+            code = 1;
+            code_idx = write++;
+        } else {
+            out[write++] = in[read];
+            if (++code == 0xFF) {
+                out[code_idx] = code;
+                code = 1;
+                code_idx = write++;
+            }
+        }
+    }
+    out[code_idx] = code;
+    return write;
+}
+
+/******************************************************************************
+ * @brief Undoes cobs_encode() in place.
+ *
+ * @return Number of decoded bytes, or -1 if the stuffing is inconsistent.
+ ******************************************************************************/
+static int16_t cobs_decode(uint8_t* buf, uint16_t length) {
+    uint16_t read = 0, write = 0;
+
+    while (read < length) {
+        uint8_t code = buf[read];
+        if (code == 0 || read + code > length) {
+            return -1;
+        }
+        read++;
+        for (uint8_t idx = 1; idx < code; idx++) {
+            buf[write++] = buf[read++];
+        }
+        if (code != 0xFF && read != length) {
+            buf[write++] = 0;
+        }
+    }
+    return write;
+}
+
+/******************************************************************************
+ * @brief Unsigned LEB128: 7 bits per byte, low bits first, MSB set on all but
+ * the last byte.
+ *
+ * @return Number of bytes written.
+ ******************************************************************************/
+static uint16_t varint_put(uint8_t* out, uint32_t value) {
+    uint16_t length = 0;
+
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[length++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return length;
+}
+
+/******************************************************************************
+ * @brief Reads one varint written by varint_put().
+ *
+ * @return Number of bytes read, or 0 if the varint runs past length.
+ ******************************************************************************/
+static uint16_t varint_get(const uint8_t* in, uint16_t length, uint32_t* value) {
+    uint8_t shift = 0;
+
+    *value = 0;
+    for (uint16_t idx = 0; idx < length && idx < BINARY_VARINT_MAX_LENGTH; idx++) {
+        *value |= (uint32_t)(in[idx] & 0x7F) << shift;
+        shift += 7;
+        if ((in[idx] & 0x80) == 0) {
+            return idx + 1;
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * @brief Appends the CRC to a raw frame, then stuffs it into out followed by
+ * the 0x00 terminator. raw needs room for the CRC.
+ *
+ * @return Number of bytes written to out.
+ ******************************************************************************/
+static uint16_t binary_frame_close(uint8_t* raw, uint16_t length, enum BinaryIntegrity integrity, uint8_t* out) {
+    uint16_t encoded;
+    uint32_t crc;
+
+    if (integrity == BINARY_CRC32) {
+        crc = crc32_mpeg2(raw, length);
+        raw[length++] = crc >> 24;
+        raw[length++] = (crc >> 16) & 0xFF;
+    } else {
+        crc = crc16_ccitt(0xFFFF, raw, length);
+    }
+    raw[length++] = (crc >> 8) & 0xFF;
+    raw[length++] = crc & 0xFF;
+
+    encoded = cobs_encode(raw, length, out);
+    out[encoded++] = BINARY_FRAME_DELIMITER;
+    return encoded;
+}
+
+/******************************************************************************
+ * @brief Writes the sensor ID byte, and the address after it when there is one.
+ *
+ * @return Number of bytes written.
+ ******************************************************************************/
+static uint16_t binary_put_node(uint8_t* out, enum SensorId_t node, uint8_t address) {
+    if (address == COMM_ADDRESS_NONE) {
+        out[0] = node;
+        return 1;
+    }
+    out[0] = node | BINARY_FLAG_ADDRESS;
+    out[1] = address;
+    return 2;
+}
+
+/******************************************************************************
+ * @brief Builds a COBS encoded binary frame followed by its 0x00 terminator.
+ ******************************************************************************/
+uint16_t binary_frame_encode(uint8_t* out, const struct CommMessage* message, bool has_params,
+                             enum BinaryIntegrity integrity) {
+    uint8_t raw[BINARY_SINGLE_MAX_RAW];
+    uint16_t length = 0;
+
+    length += binary_put_node(raw, message->SensorID, message->address);
+    raw[length++] = (message->messageId & BINARY_MESSAGEID_MASK)
+            | (message->HasSeq ? BINARY_FLAG_SEQ : 0)
+            | (message->HasTimestamp ? BINARY_FLAG_TIMESTAMP : 0)
+            | (message->IsDelta ? BINARY_FLAG_DELTA : 0);
+    if (has_params || message->HasSeq || message->HasTimestamp) {
+        length += varint_put(&raw[length], message->params);
+    }
+    if (message->HasSeq) {
+        length += varint_put(&raw[length], message->seq);
+    }
+    if (message->HasTimestamp) {
+        length += varint_put(&raw[length], message->timestamp);
+    }
+    return binary_frame_close(raw, length, integrity, out);
+}
+
+/******************************************************************************
+ * @brief Builds a batch frame: one header, one CRC and one terminator for up
+ * to BINARY_BATCH_MAX readings.
+ ******************************************************************************/
+uint16_t binary_batch_encode(uint8_t* out, const struct CommMessage* readings, uint8_t count,
+                             uint8_t address, enum BinaryIntegrity integrity) {
+    uint8_t raw[BINARY_BATCH_MAX_RAW];
+    uint16_t length = 0;
+
+    if (count > BINARY_BATCH_MAX) {
+        count = BINARY_BATCH_MAX;
+    }
+    length += binary_put_node(raw, Controller, address);
+    raw[length++] = BINARY_BATCH_MESSAGEID;
+    raw[length++] = count;
+    for (uint8_t idx = 0; idx < count; idx++) {
+        const struct CommMessage* reading = &readings[idx];
+        raw[length++] = (reading->SensorID & BINARY_READING_SENSOR_MASK)
+                | (reading->IsDelta ? BINARY_READING_FLAG_DELTA : 0)
+                | (reading->HasTimestamp ? BINARY_READING_FLAG_TIMESTAMP : 0);
+        length += varint_put(&raw[length], reading->params);
+        if (reading->HasTimestamp) {
+            length += varint_put(&raw[length], reading->timestamp);
+        }
+    }
+    return binary_frame_close(raw, length, integrity, out);
+}
+
+/******************************************************************************
+ * @brief True if the last check_length bytes of frame are the CRC of the rest.
+ ******************************************************************************/
+static bool binary_frame_check(const uint8_t* frame, int16_t raw_length, uint8_t check_length) {
+    int16_t payload_length = raw_length - check_length;
+    uint32_t crc, received = 0;
+
+    if (payload_length < 2) {
+        return false;
+    }
+    for (int16_t idx = payload_length; idx < raw_length; idx++) {
+        received = (received << 8) | frame[idx];
+    }
+    crc = (check_length == 4) ? crc32_mpeg2(frame, payload_length) : crc16_ccitt(0xFFFF, frame, payload_length);
+    return crc == received;
+}
+
+/******************************************************************************
+ * @brief Reads the readings of a batch frame whose CRC has been checked.
+ *
+ * @return Number of readings, 0 if the frame is malformed.
+ ******************************************************************************/
+static uint8_t binary_batch_decode(const uint8_t* frame, uint16_t raw_length, struct CommMessage* messages) {
+    static const struct CommMessage EmptyMessage = {0};
+    uint16_t idx = 3, used;
+    uint32_t params, timestamp;
+    uint8_t count, header;
+
+    if (raw_length < 3 || frame[2] == 0 || frame[2] > BINARY_BATCH_MAX) {
+        return 0;
+    }
+    count = frame[2];
+    for (uint8_t reading = 0; reading < count; reading++) {
+        if (idx >= raw_length) {
+            return 0;
+        }
+        header = frame[idx++];
+        if (!comm_is_sensor(header & BINARY_READING_SENSOR_MASK)) {
+            return 0;
+        }
+        used = varint_get(&frame[idx], raw_length - idx, &params);
+        if (used == 0 || params > UINT16_MAX) {
+            return 0;
+        }
+        idx += used;
+        timestamp = 0;
+        if (header & BINARY_READING_FLAG_TIMESTAMP) {
+            used = varint_get(&frame[idx], raw_length - idx, &timestamp);
+            if (used == 0) {
+                return 0;
+            }
+            idx += used;
+        }
+
+        messages[reading] = EmptyMessage;
+        messages[reading].SensorID = header & BINARY_READING_SENSOR_MASK;
+        messages[reading].messageId = COMM_MSG_DATA;
+        messages[reading].params = params;
+        messages[reading].timestamp = timestamp;
+        messages[reading].HasTimestamp = (header & BINARY_READING_FLAG_TIMESTAMP) != 0;
+        messages[reading].IsDelta = (header & BINARY_READING_FLAG_DELTA) != 0;
+        messages[reading].IsCheckSumValid = true;
+        messages[reading].IsMessageReady = true;
+    }
+    return idx == raw_length ? count : 0; // Bytes after the last reading
+}
+
+/******************************************************************************
+ * @brief Unstuffs a received frame, checks its CRC and fills in the messages.
+ ******************************************************************************/
+uint8_t binary_frame_decode(uint8_t* frame, uint16_t length, enum BinaryIntegrity integrity,
+                            struct CommMessage* messages) {
+    static const struct CommMessage EmptyMessage = {0};
+    struct CommMessage* message = &messages[0];
+    int16_t raw_length;
+    uint16_t idx, used;
+    uint32_t params = 0, seq = 0, timestamp = 0;
+    uint8_t check_length = (integrity == BINARY_CRC32) ? 4 : 2;
+    uint8_t flags, address = COMM_ADDRESS_NONE, count;
+
+    if (length > BINARY_FRAME_MAX_ENCODED) {
+        return 0;
+    }
+    raw_length = cobs_decode(frame, length);
+    if (raw_length < BINARY_FRAME_MIN_RAW) {
+        return 0;
+    }
+    if (!binary_frame_check(frame, raw_length, check_length)) {
+        return 0;
+    }
+    raw_length -= check_length;
+    if (frame[0] & BINARY_FLAG_ADDRESS) {
+        // Drop the address byte so the rest reads like an unaddressed frame
+        address = frame[1];
+        if (address == COMM_ADDRESS_NONE || raw_length < 3) {
+            return 0;
+        }
+        frame[1] = frame[0] & ~BINARY_FLAG_ADDRESS;
+        frame++;
+        raw_length--;
+    }
+    if (frame[0] == None || frame[0] >= COMM_NODE_COUNT) {
+        return 0;
+    }
+    if (frame[0] == Controller && frame[1] == BINARY_BATCH_MESSAGEID) {
+        count = binary_batch_decode(frame, raw_length, messages);
+        for (uint8_t reading = 0; reading < count; reading++) {
+            messages[reading].address = address;
+        }
+        return count;
+    }
+
+    // Fields between the IDs and the CRC: params, then those flagged
+    flags = frame[1] & ~BINARY_MESSAGEID_MASK;
+    idx = 2;
+    if (idx < raw_length || flags) {
+        used = varint_get(&frame[idx], raw_length - idx, &params);
+        if (used == 0 || params > UINT16_MAX) {
+            return 0; // Missing, unterminated, or does not fit CommMessage
+        }
+        idx += used;
+    }
+    if (flags & BINARY_FLAG_SEQ) {
+        used = varint_get(&frame[idx], raw_length - idx, &seq);
+        if (used == 0 || seq > UINT8_MAX) {
+            return 0;
+        }
+        idx += used;
+    }
+    if (flags & BINARY_FLAG_TIMESTAMP) {
+        used = varint_get(&frame[idx], raw_length - idx, &timestamp);
+        if (used == 0) {
+            return 0;
+        }
+        idx += used;
+    }
+    if (idx != raw_length) {
+        return 0; // Bytes after the last field
+    }
+
+    *message = EmptyMessage;
+    message->address = address;
+    message->SensorID = frame[0];
+    message->messageId = frame[1] & BINARY_MESSAGEID_MASK;
+    message->params = params;
+    message->seq = seq;
+    message->HasSeq = (flags & BINARY_FLAG_SEQ) != 0;
+    message->timestamp = timestamp;
+    message->HasTimestamp = (flags & BINARY_FLAG_TIMESTAMP) != 0;
+    message->IsDelta = (flags & BINARY_FLAG_DELTA) != 0;
+    message->checksum = frame[raw_length + check_length - 1]; // Low byte of the CRC
+    message->IsCheckSumValid = true;
+    message->IsMessageReady = true;
+    return 1;
+}
@@ -0,0 +1,112 @@
+/*
+ * Comm_Bus.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_Bus.h" // Header for the shared bus
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "task.h"
+
+static struct CommMessage Held[BUS_HOLD_MAX]; // Platform: readings waiting for a poll, oldest at HeldFirst
+static uint8_t HeldFirst = 0, HeldCount = 0;
+static uint16_t HeldDropped = 0; // Platform: readings that made room since the last turn
+static bool IsOnBus = false;
+
+static struct BusNode Nodes[BUS_MAX_NODES]; // Controller: the platforms found
+static uint8_t NodeCount = 0;
+
+void bus_join(uint8_t address) {
+    comm_set_address(address);
+    IsOnBus = (address != COMM_ADDRESS_NONE);
+}
+
+/******************************************************************************
+ * @brief Platform side. Runs in the sensor timer callbacks; the hold buffer is
+ * shared with the receive task answering polls, so it is only touched with
+ * interrupts masked. When it is full the oldest reading makes room. Readings
+ * are held with full values and only delta coded once polled, so one that
+ * makes room is never the base of another.
+ ******************************************************************************/
+bool bus_hold(const struct CommMessage* message) {
+    if (!IsOnBus) {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    if (HeldCount == BUS_HOLD_MAX) {
+        HeldFirst = (HeldFirst + 1) % BUS_HOLD_MAX;
+        HeldCount--;
+        HeldDropped++;
+    }
+    Held[(HeldFirst + HeldCount) % BUS_HOLD_MAX] = *message;
+    HeldCount++;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+/******************************************************************************
+ * @brief Platform side. Sends what is held in batch frames of up to
+ * BINARY_BATCH_MAX readings, then ends the turn with the number sent and the
+ * number dropped since the last turn, which tells the controller it may poll
+ * the next platform.
+ ******************************************************************************/
+void bus_handle_poll(void) {
+    static struct CommMessage readings[BINARY_BATCH_MAX]; // Too large for SensorPlatformTask's stack, the only caller
+    uint16_t sent = 0, dropped;
+    uint8_t count;
+
+    do {
+        taskENTER_CRITICAL();
+        count = (HeldCount < BINARY_BATCH_MAX) ? HeldCount : BINARY_BATCH_MAX;
+        for (uint8_t idx = 0; idx < count; idx++) {
+            readings[idx] = Held[HeldFirst];
+            HeldFirst = (HeldFirst + 1) % BUS_HOLD_MAX;
+        }
+        HeldCount -= count;
+        taskEXIT_CRITICAL();
+
+        for (uint8_t idx = 0; idx < count; idx++) {
+            delta_encode(&readings[idx]); // Unless compression is off or a keyframe is due
+        }
+        if (count != 0) {
+            send_sensorDataBatch_message(readings, count);
+            sent += count;
+        }
+    } while (count == BINARY_BATCH_MAX && sent < BUS_HOLD_MAX); // Later readings wait for the next turn
+
+    taskENTER_CRITICAL();
+    dropped = HeldDropped;
+    HeldDropped = 0;
+    taskEXIT_CRITICAL();
+    send_poll_message(BUS_TURN_PARAMS(sent, dropped));
+}
+
+void bus_clear(void) {
+    NodeCount = 0;
+}
+
+bool bus_add_node(uint8_t address, uint16_t sensors) {
+    static const struct BusNode EmptyNode = {0};
+
+    if (NodeCount == BUS_MAX_NODES) {
+        return false;
+    }
+    Nodes[NodeCount] = EmptyNode;
+    Nodes[NodeCount].address = address;
+    Nodes[NodeCount].sensors = sensors;
+    NodeCount++;
+    return true;
+}
+
+uint8_t bus_node_count(void) {
+    return NodeCount;
+}
+
+struct BusNode* bus_node(uint8_t index) {
+    return &Nodes[index];
+}
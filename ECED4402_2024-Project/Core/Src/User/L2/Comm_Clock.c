@@ -0,0 +1,105 @@
+/*
+ * Comm_Clock.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_Clock.h" // Header for clock offset exchange
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "timers.h"
+
+static TimerHandle_t TimerID_Sync;
+static volatile TickType_t RequestTick;    // Controller: when the outstanding request was sent
+static volatile bool IsRequestPending = false;
+static volatile bool IsSynchronised = false;
+static volatile int32_t Offset = 0;        // Platform tick count minus controller tick count
+static volatile uint32_t RoundTrip = 0;
+static volatile bool IsTimestamping = false; // Platform: the controller asked for the time
+
+/******************************************************************************
+ * @brief Timer callback: sends a time request. An unanswered request is
+ * simply replaced by the next one.
+ ******************************************************************************/
+static void clock_sync_expired(TimerHandle_t xTimer) {
+    RequestTick = xTaskGetTickCount();
+    IsRequestPending = true;
+    send_clock_message(false, 0);
+}
+
+/******************************************************************************
+ * @brief Creates the request timer, started by clock_sync_start().
+ ******************************************************************************/
+void initialize_clock_sync(void) {
+    TimerID_Sync = xTimerCreate(
+        "Clock Sync",
+        pdMS_TO_TICKS(CLOCK_SYNC_PERIOD_MS),
+        pdTRUE,     // Autoreload: tracks drift for as long as the link is up
+        (void*)0,
+        clock_sync_expired
+        );
+}
+
+void clock_sync_start(void) {
+    if (comm_framing_is_ascii(get_sensor_framing())) {
+        xTimerStop(TimerID_Sync, portMAX_DELAY);
+        IsSynchronised = false;
+        return;
+    }
+    clock_sync_expired(TimerID_Sync); // Measure now rather than one period from now
+    xTimerStart(TimerID_Sync, portMAX_DELAY);
+}
+
+/******************************************************************************
+ * @brief Platform side: the answer is sent right away so the round trip is
+ * mostly wire time.
+ ******************************************************************************/
+void clock_handle_request(void) {
+    IsTimestamping = true;
+    send_clock_message(true, xTaskGetTickCount());
+}
+
+/******************************************************************************
+ * @brief Controller side. The platform read its clock about half way through
+ * the round trip, so offset = platform tick - (request tick + round trip / 2).
+ ******************************************************************************/
+void clock_handle_reply(const struct CommMessage* reply) {
+    TickType_t now = xTaskGetTickCount();
+    uint32_t round_trip;
+
+    if (!IsRequestPending || !reply->HasTimestamp) {
+        return;
+    }
+    IsRequestPending = false;
+
+    round_trip = now - RequestTick;
+    if (round_trip > pdMS_TO_TICKS(CLOCK_SYNC_MAX_RTT_MS)) {
+        return;
+    }
+    Offset = (int32_t)(reply->timestamp - (RequestTick + round_trip / 2));
+    RoundTrip = round_trip;
+    IsSynchronised = true;
+}
+
+bool clock_timestamps_enabled(void) {
+    return IsTimestamping;
+}
+
+bool clock_is_synchronised(void) {
+    return IsSynchronised;
+}
+
+uint32_t clock_to_local(uint32_t remote_tick) {
+    return remote_tick - (uint32_t)Offset;
+}
+
+int32_t clock_offset(void) {
+    return Offset;
+}
+
+uint32_t clock_round_trip(void) {
+    return RoundTrip;
+}
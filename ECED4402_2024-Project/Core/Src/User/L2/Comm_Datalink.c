@@ -7,19 +7,66 @@
  */
 
 #include <string.h>  // For string operations
-#include <stdio.h>   // For formatted string functions
-#include <stdlib.h>  // For standard utility functions
-#include <math.h>    // For mathematical functions
 
 #include "User/L1/USART_Driver.h" // USART driver for serial communication
 #include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_LinkRate.h" // Header for link rate negotiation
+#include "User/L2/Comm_Reliable.h" // Header for reliable delivery
+#include "User/L2/Comm_Clock.h" // Header for clock offset exchange
+#include "User/L2/Comm_Batch.h" // Header for batching
+#include "User/L2/Comm_Bus.h" // Header for the shared bus
+#include "User/L2/Comm_Lanes.h" // Header for the transmit lanes
 #include "User/util.h" // Utility functions
+#include "User/format.h" // Integer formatting
 
-// Enumeration for message parsing states
-enum ParseMessageState_t {Waiting_S, SensorID_S, MessageID_S, ParamsID_S, Star_S, CS_S};
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
 
-// Static function prototype for sending strings with checksum
-static void sendStringSensor(char* tx_string);
+// Field widths of an outgoing "$SENSR,MM,PPPPPPPP,*,CS\n" frame
+#define FRAME_HEADER_LENGTH    7 // "$SENSR,"
+#define FRAME_SHORT_LENGTH     3 // "$sM", a short header up to its separator
+#define FRAME_ADDRESS_LENGTH   5 // "@AAA," replacing the header's ',' when addressed
+#define FRAME_MESSAGEID_LENGTH 3 // "MM,"
+#define FRAME_PARAMS_LENGTH    8 // "PPPPPPPP"
+#define FRAME_SEGMENT_COUNT    6
+
+// Constant parts of outgoing frames, handed to the TX engine as they are
+#define FRAME_HEADER_ENTRY(id, name, key, ack) [id] = "$" name ",",
+#define FRAME_MESSAGEID_ENTRY(id, value, ascii, lane) [id] = ascii,
+#define MESSAGE_LANE_ENTRY(id, value, ascii, lane) [id] = lane,
+#define NODE_NAME_ENTRY(id, name, key, ack) [id] = name,
+#define NODE_SHORT_ENTRY(id, name, key, ack) [id] = (key) | 0x20,
+static const char* const FrameHeaders[COMM_NODE_COUNT] = { COMM_NODE_TABLE(FRAME_HEADER_ENTRY) };
+static const char* const FrameMessageIds[COMM_MESSAGE_ID_COUNT] = { COMM_MESSAGE_TABLE(FRAME_MESSAGEID_ENTRY) };
+static const uint8_t MessageLanes[COMM_MESSAGE_ID_COUNT] = { COMM_MESSAGE_TABLE(MESSAGE_LANE_ENTRY) };
+static const char* const NodeNames[COMM_NODE_COUNT] = { [None] = "?????", COMM_NODE_TABLE(NODE_NAME_ENTRY) };
+static const char NodeShortNames[COMM_NODE_COUNT] = { COMM_NODE_TABLE(NODE_SHORT_ENTRY) }; // Lower case key letters
+static const char FrameStar[] = ",*,";
+
+// Link the transmit lanes write to
+#define TX_PORT USART_PORT_EXTERN
+
+// Framing of each link, changed only by its framing handshake. All start in ASCII.
+static volatile enum CommFraming LinkFramings[USART_PORT_COUNT];
+static volatile uint8_t TxAddress = COMM_ADDRESS_NONE; // Address of outgoing frames
+
+/******************************************************************************
+ * @brief How long a send waits for room in its lane. Sends from timer callbacks
+ * (readings, batch flushes, retransmits) never wait, as that would hold up
+ * every other timer; a full lane drops the frame and counts it instead.
+ ******************************************************************************/
+static inline TickType_t send_timeout(void) {
+    return (xTaskGetCurrentTaskHandle() == xTimerGetTimerDaemonTaskHandle()) ? 0 : portMAX_DELAY;
+}
+
+/******************************************************************************
+ * @brief The CRC closing binary frames in a framing, both ways.
+ ******************************************************************************/
+static inline enum BinaryIntegrity framing_integrity(enum CommFraming framing) {
+    return (framing == COMM_FRAMING_BINARY_CRC32) ? BINARY_CRC32 : BINARY_CRC16;
+}
 
 /******************************************************************************
  * @brief Initializes the sensor communication datalink.
@@ -27,6 +74,12 @@ static void sendStringSensor(char* tx_string);
  ******************************************************************************/
 void initialize_sensor_datalink(void) {
     configure_usart_extern(); // Set up external USART for sensor communication
+    initialize_lanes();       // Transmit lanes and the task draining them
+    initialize_binary_framing(); // Clock the CRC unit used by CRC-32 frames
+    initialize_link_rate();   // Start watching the link error counters
+    initialize_reliable();    // Retransmit window, idle until negotiated
+    initialize_clock_sync();  // Time requests, started once the link is binary
+    initialize_batching();    // Batch flush timer, idle until negotiated
 }
 
 /******************************************************************************
@@ -38,158 +91,725 @@ void initialize_hostPC_datalink(void) {
 }
 
 /******************************************************************************
- * @brief Calculates the checksum and sends the input string via UART.
+ * @brief Sends an ASCII frame as a list of segments: the constant header, the
+ * address if any, the message ID, the params field, ",*," and the checksum trailer. Nothing is
+ * assembled into an intermediate string; the checksum is the XOR of every
+ * character before the checksum digits. A short header replaces the node name
+ * and message ID with one character each and is followed by the address, if
+ * any, and ','.
+ ******************************************************************************/
+static bool send_ascii_frame(enum CommLane lane, enum CommFraming framing, uint8_t address, enum SensorId_t sensorType, uint8_t messageId, bool has_params, uint32_t value) {
+    char params[FRAME_PARAMS_LENGTH];
+    char address_str[FRAME_ADDRESS_LENGTH + 1];
+    char short_header[FRAME_SHORT_LENGTH] = { '$', NodeShortNames[sensorType], comm_message_char(messageId) };
+    char trailer[3];
+    uint8_t checksum = 0;
+    struct UsartTxSegment segments[FRAME_SEGMENT_COUNT] = {
+        { (const uint8_t*)FrameHeaders[sensorType], FRAME_HEADER_LENGTH },
+        { (const uint8_t*)address_str, 0 },
+        { (const uint8_t*)FrameMessageIds[messageId], FRAME_MESSAGEID_LENGTH },
+        { (const uint8_t*)params, has_params ? FRAME_PARAMS_LENGTH : 0 },
+        { (const uint8_t*)FrameStar, sizeof(FrameStar) - 1 },
+        { (const uint8_t*)trailer, sizeof(trailer) },
+    };
+
+    if (framing == COMM_FRAMING_ASCII_SHORT) {
+        char* pos = (address != COMM_ADDRESS_NONE) ? fmt_u32(fmt_str(address_str, "@"), address) : address_str;
+
+        segments[0].data = (const uint8_t*)short_header;
+        segments[0].length = FRAME_SHORT_LENGTH;
+        segments[1].length = fmt_str(pos, ",") - address_str;
+        segments[2].length = 0; // In the header
+    } else if (address != COMM_ADDRESS_NONE) {
+        segments[0].length = FRAME_HEADER_LENGTH - 1; // The ',' follows the address
+        segments[1].length = fmt_str(fmt_u32(fmt_str(address_str, "@"), address), ",") - address_str;
+    }
+    if (has_params) {
+        fmt_u32_pad8(params, value);
+    }
+
+    for (int seg = 0; seg < FRAME_SEGMENT_COUNT - 1; seg++) {
+        for (int idx = 0; idx < segments[seg].length; idx++) {
+            checksum ^= segments[seg].data[idx];
+        }
+    }
+    fmt_hex2(trailer, checksum);
+    trailer[2] = '\n';
+
+    return lane_writev(lane, segments, FRAME_SEGMENT_COUNT, send_timeout());
+}
+
+/******************************************************************************
+ * @brief The transmit lane of a frame. A reading only moves up to the alarm
+ * lane when it stands on its own: a delta frame, or any reading while
+ * compression is on, must not overtake the frames its decoding depends on.
+ ******************************************************************************/
+static enum CommLane message_lane(const struct CommMessage* message) {
+    if (message->messageId == COMM_MSG_DATA && !message->IsDelta && !delta_is_active()
+            && lane_is_alarm(message->SensorID, message->params)) {
+        return COMM_LANE_ALARM;
+    }
+    return MessageLanes[message->messageId];
+}
+
+/******************************************************************************
+ * @brief Queues a frame, in the framing selected by the handshake, on its
+ * transmit lane. The sequence number only exists in binary frames; reliable
+ * mode is never negotiated on an ASCII link.
+ *
+ * @param message: Sensor ID, message ID, params and sequence number.
+ * @param has_params: False for frames with an empty params field.
+ * @return False if the lane was full and the frame was dropped.
+ ******************************************************************************/
+static bool send_message_frame(const struct CommMessage* message, bool has_params) {
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1];
+    enum CommLane lane = message_lane(message);
+    enum CommFraming framing = LinkFramings[TX_PORT];
+
+    if (!comm_framing_is_ascii(framing)) {
+        return lane_write(lane, frame, binary_frame_encode(frame, message, has_params, framing_integrity(framing)),
+                          send_timeout());
+    }
+    return send_ascii_frame(lane, framing, message->address, message->SensorID, message->messageId, has_params,
+                            message->params);
+}
+
+/******************************************************************************
+ * @brief Sends a frame without a sequence number.
+ *
+ * @param sensorType: The sensor named in the header.
+ * @param messageId: The message ID.
+ * @param has_params: False for frames with an empty params field.
+ * @param value: The params value.
+ ******************************************************************************/
+static void send_frame(enum SensorId_t sensorType, enum CommMessageId messageId, bool has_params, uint16_t value) {
+    struct CommMessage message = {
+        .address = TxAddress,
+        .SensorID = sensorType,
+        .messageId = messageId,
+        .params = value,
+    };
+
+    send_message_frame(&message, has_params);
+}
+
+/******************************************************************************
+ * @brief Sends a sensor data frame. Once the controller has asked for the
+ * time, the frame also carries the tick count the reading was taken at.
+ *
+ * @param sensorType: The type of sensor sending the data.
+ * @param data: The sensor data value.
+ * @param has_seq: True in reliable mode.
+ * @param seq: The frame's sequence number.
+ * @param sample_tick: Tick count when the reading was taken.
+ ******************************************************************************/
+static void send_data_frame(enum SensorId_t sensorType, uint16_t data, bool has_seq, uint8_t seq, uint32_t sample_tick) {
+    struct CommMessage message = {
+        .address = TxAddress,
+        .SensorID = sensorType,
+        .messageId = COMM_MSG_DATA,
+        .params = data,
+        .seq = seq,
+        .HasSeq = has_seq,
+        .timestamp = sample_tick,
+        .HasTimestamp = clock_timestamps_enabled(),
+    };
+
+    if (bus_hold(&message)) {
+        return; // Delta coded and sent when the platform is polled
+    }
+    delta_encode(&message); // Unless compression is off or a keyframe is due
+    if (message_lane(&message) == COMM_LANE_ALARM || !batch_add(&message)) {
+        if (!send_message_frame(&message, true)) { // Alarms are not held back for a batch
+            delta_frame_lost(message.SensorID);
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Resets a parser and ties it to the link comm_parser_read() reads.
  *
- * @param tx_string: The input string to send.
+ * @param parser: The parser to reset.
+ * @param port: The link it parses.
  ******************************************************************************/
-static void sendStringSensor(char* tx_string) {
-    uint8_t checksum;       // Variable to store checksum
-    uint16_t str_length;    // Length of the string
+void comm_parser_init(struct CommParser* parser, enum UsartPort port) {
+    static const struct CommParser EmptyParser = {0};
 
-    // Calculate the string length excluding the checksum placeholder
-    str_length = strlen((char *)tx_string) - 1;
+    *parser = EmptyParser;
+    parser->port = port;
+    parser->state = Waiting_S;
+}
 
-    // Compute the checksum using XOR over all characters
-    checksum = tx_string[0];
-    for (int idx = 1; idx < str_length - 2; idx++) {
-        checksum ^= tx_string[idx];
+/******************************************************************************
+ * @brief Hands out the next message of the last binary frame.
+ ******************************************************************************/
+static inline bool parser_next(struct CommParser* parser, struct CommMessage* message) {
+    if (parser->decodedIdx == parser->decodedCount) {
+        return false;
     }
+    *message = parser->decoded[parser->decodedIdx++];
+    return true;
+}
 
-    // Append the checksum to the string
-    sprintf(&tx_string[str_length - 2], "%02x\n", checksum);
+/******************************************************************************
+ * @brief Maps a five letter frame header to its node with one comparison: the
+ * first letter selects the only candidate.
+ ******************************************************************************/
+static inline enum SensorId_t lookup_node(const char* name) {
+    enum SensorId_t id = comm_node_by_key(name[0]);
 
-    // Send the string via the external USART
-    printStr_extern(tx_string);
+    if (id == None || memcmp(name, NodeNames[id], COMM_NODE_NAME_LENGTH) != 0) {
+        return None;
+    }
+    return id;
 }
 
+void comm_parser_stats(const struct CommParser* parser, struct CommParserStats* stats) {
+    *stats = parser->stats;
+}
+
+const char* comm_sensor_name(enum SensorId_t id) {
+    return (id < COMM_NODE_COUNT) ? NodeNames[id] : NodeNames[None];
+}
+
+#define SCAN_ONES  0x01010101U
+#define SCAN_HIGHS 0x80808080U
+#define SCAN_HAS_ZERO(word) (((word) - SCAN_ONES) & ~(word) & SCAN_HIGHS)
+
 /******************************************************************************
- * @brief Parses incoming messages from sensors.
+ * @brief Number of bytes before the first '$' or 0x00 in data, the only bytes
+ * that can start or end a frame. Tests four bytes per step: a byte of a word
+ * is zero exactly where SCAN_HAS_ZERO sets its high bit, and XOR with '$' in
+ * every byte turns a '$' into a zero.
  *
- * @param currentRxMessage: Pointer to the structure that will hold the parsed message.
+ * @return length if data holds neither.
  ******************************************************************************/
-void parse_sensor_message(struct CommMessage* currentRxMessage) {
-    static enum ParseMessageState_t currentState = Waiting_S; // State machine's current state
-    uint8_t CurrentChar; // Current character being processed
-    static uint16_t sensorIdIdx = 0, MessageIdIdx = 0, ParamIdx = 0, checksumIdx = 0;
-    static char sensorId[6], CSStr[3];
-    static uint8_t checksum_val;
-    static const struct CommMessage EmptyMessage = {0}; // Empty message template
+static inline size_t scan_delimiter(const uint8_t* data, size_t length) {
+    const uint32_t dollars = '$' * SCAN_ONES;
+    size_t idx = 0;
+    uint32_t word;
 
-    // Process each character in the UART queue
-    while (xQueueReceive(Queue_extern_UART, &CurrentChar, portMAX_DELAY) == pdPASS &&
-           currentRxMessage->IsMessageReady == false) {
+    // Byte by byte up to a word boundary
+    for (; idx < length && ((uintptr_t)&data[idx] & 3) != 0; idx++) {
+        if (data[idx] == '$' || data[idx] == BINARY_FRAME_DELIMITER) {
+            return idx;
+        }
+    }
+    for (; idx + 4 <= length; idx += 4) {
+        memcpy(&word, &data[idx], sizeof(word)); // One aligned load
 
-        if (CurrentChar == '$') { // Reset state machine when '$' is received
-            checksum_val = CurrentChar;
-            sensorIdIdx = MessageIdIdx = ParamIdx = checksumIdx = 0;
-            currentState = SensorID_S;
-            *currentRxMessage = EmptyMessage; // Reset the current message
-            continue;
+        if (SCAN_HAS_ZERO(word) | SCAN_HAS_ZERO(word ^ dollars)) {
+            break; // The byte loop below finds which
+        }
+    }
+    for (; idx < length; idx++) {
+        if (data[idx] == '$' || data[idx] == BINARY_FRAME_DELIMITER) {
+            return idx;
         }
+    }
+    return length;
+}
 
-        // State machine for parsing the message
-        switch (currentState) {
-            case Waiting_S:
-                // Do nothing in Waiting state
-                break;
+/******************************************************************************
+ * @brief Fast path for a parser between frames. Bytes that can neither start
+ * an ASCII frame nor end a binary one are found a word at a time and only
+ * added to the pending binary frame, exactly as parse_byte() would. Does
+ * nothing inside an ASCII frame.
+ *
+ * @return Number of leading bytes of data consumed.
+ ******************************************************************************/
+static inline size_t parser_skip(struct CommParser* parser, const uint8_t* data, size_t length) {
+    size_t run, copy;
 
-            case SensorID_S:
-                checksum_val ^= CurrentChar;
-                if (CurrentChar == ',') {
-                    currentState = MessageID_S;
-                } else if (sensorIdIdx < 5) {
-                    sensorId[sensorIdIdx++] = CurrentChar;
-                }
-                if (sensorIdIdx == 5) {
-                    sensorId[sensorIdIdx] = '\0'; // Null-terminate the sensor ID string
-
-                    // Map the sensor ID to enum
-                    if (strcmp(sensorId, "CNTRL") == 0)
-                        currentRxMessage->SensorID = Controller;
-                    else if (strcmp(sensorId, "TURBD") == 0)
-                        currentRxMessage->SensorID = Turbidity;
-                    else if (strcmp(sensorId, "MCRPL") == 0)
-                        currentRxMessage->SensorID = Microplastic;
-                    else if (strcmp(sensorId, "DOLEV") == 0)
-                        currentRxMessage->SensorID = DOLevel;
-                    else {
-                        currentRxMessage->SensorID = None;
-                        currentState = Waiting_S; // Invalid sensor ID
-                    }
+    if (parser->state != Waiting_S || parser->IsAsciiFrameEnded) {
+        return 0;
+    }
+    run = scan_delimiter(data, length);
+    if (run == 0) {
+        return 0;
+    }
+
+    if (parser->binaryFrameLength < BINARY_FRAME_MAX_ENCODED) {
+        copy = BINARY_FRAME_MAX_ENCODED - parser->binaryFrameLength;
+        if (copy > run) {
+            copy = run;
+        }
+        memcpy(&parser->binaryFrame[parser->binaryFrameLength], data, copy);
+    }
+    // Past the buffer the length stops one beyond it, marking the frame too long
+    parser->binaryFrameLength = (parser->binaryFrameLength + run > BINARY_FRAME_MAX_ENCODED)
+            ? BINARY_FRAME_MAX_ENCODED + 1 : parser->binaryFrameLength + run;
+    parser->stats.scanned += run;
+    return run;
+}
+
+/******************************************************************************
+ * @brief Value of one checksum digit. fmt_hex2() sends lower case, upper case
+ * from other peers is accepted too.
+ *
+ * @return 0xFF for anything but a hex digit.
+ ******************************************************************************/
+static inline uint8_t hex_digit(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20; // Lower case
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : 0xFF;
+}
+
+/******************************************************************************
+ * @brief Gives up on the ASCII frame being parsed; the next '$' starts over.
+ ******************************************************************************/
+static inline void parser_reject(struct CommParser* parser) {
+    parser->state = Waiting_S;
+    parser->stats.rejected++;
+}
+
+/******************************************************************************
+ * @brief Runs one byte through a parser. ASCII frames are recognised at all
+ * times, so a peer that restarts in ASCII is still heard; binary frames only
+ * once the parser's own link is binary, and only with the CRC negotiated on it. Inlined into
+ * the span loop so scanning a buffer makes no call per byte.
+ *
+ * @param parser: The link's parser.
+ * @param CurrentChar: The received byte.
+ * @param message: Set to the decoded frame when the byte completes one.
+ * @return True if a valid frame was completed.
+ ******************************************************************************/
+static inline bool parse_byte(struct CommParser* parser, uint8_t CurrentChar, struct CommMessage* message) {
+    static const struct CommMessage EmptyMessage = {0}; // Empty message template
+    struct CommMessage* currentRxMessage = &parser->message;
+
+    // Binary frames end at the first 0x00, which never occurs in ASCII frames
+    if (CurrentChar == BINARY_FRAME_DELIMITER) {
+        enum CommFraming framing = LinkFramings[parser->port];
+        uint8_t count = 0, kept = 0;
+
+        if (!comm_framing_is_ascii(framing) && parser->binaryFrameLength <= BINARY_FRAME_MAX_ENCODED) {
+            count = binary_frame_decode(parser->binaryFrame, parser->binaryFrameLength, framing_integrity(framing),
+                                        parser->decoded);
+        }
+        if (count != 0) {
+            parser->state = Waiting_S; // Drop any '$' seen inside the stuffed bytes
+            if (count > 1) {
+                batch_record_received(count);
+            }
+            for (uint8_t idx = 0; idx < count; idx++) {
+                if (delta_decode(&parser->delta, &parser->decoded[idx])) {
+                    parser->decoded[kept++] = parser->decoded[idx];
                 }
-                break;
+            }
+        } else if (parser->binaryFrameLength != 0) {
+            delta_invalidate(&parser->delta); // The lost frame may have been a reading
+            parser->stats.resyncs++;
+        }
+        parser->binaryFrameLength = 0;
+        parser->decodedCount = kept;
+        parser->decodedIdx = 0;
+        return parser_next(parser, message);
+    }
+    if (parser->IsAsciiFrameEnded) {
+        parser->IsAsciiFrameEnded = false;
+        if (CurrentChar == '\n') {
+            return false; // Not the start of a binary frame
+        }
+    }
+    if (parser->binaryFrameLength < BINARY_FRAME_MAX_ENCODED) {
+        parser->binaryFrame[parser->binaryFrameLength] = CurrentChar;
+    }
+    if (parser->binaryFrameLength <= BINARY_FRAME_MAX_ENCODED) {
+        parser->binaryFrameLength++;
+    }
 
-            case MessageID_S:
-                checksum_val ^= CurrentChar;
+    if (CurrentChar == '$') { // Reset state machine when '$' is received
+        if (parser->state >= Address_S
+                || (parser->state == SensorID_S && parser->sensorIdIdx == COMM_NODE_NAME_LENGTH)) {
+            parser->stats.resyncs++; // An ASCII frame cut short after its header
+        } else if (parser->state != Waiting_S) {
+            parser->stats.rejected++; // A false '$', e.g. in binary payload, seen before its header failed
+        }
+        parser->checksum = CurrentChar;
+        parser->sensorIdIdx = parser->messageIdIdx = parser->paramIdx = parser->checksumIdx = 0;
+        parser->IsShortHeader = false;
+        parser->state = SensorID_S;
+        *currentRxMessage = EmptyMessage; // Reset the current message
+        return false;
+    }
+
+    // State machine for parsing the message
+    switch (parser->state) {
+        case Waiting_S:
+            // Do nothing in Waiting state
+            break;
+
+        case SensorID_S:
+            parser->checksum ^= CurrentChar;
+            if (parser->sensorIdIdx == COMM_NODE_NAME_LENGTH) {
+                // Whole header matched, the separator follows
                 if (CurrentChar == ',') {
-                    currentState = ParamsID_S;
+                    parser->state = MessageID_S;
+                } else if (CurrentChar == '@') {
+                    parser->state = Address_S;
                 } else {
-                    if (MessageIdIdx < 2) {
-                        currentRxMessage->messageId = currentRxMessage->messageId * 10 + (CurrentChar - '0');
-                    }
-                    MessageIdIdx++;
+                    parser_reject(parser);
                 }
                 break;
+            }
 
-            case ParamsID_S:
-                checksum_val ^= CurrentChar;
-                if (CurrentChar == ',') {
-                    currentState = Star_S;
-                } else if (ParamIdx < 8) {
-                    currentRxMessage->params = currentRxMessage->params * 10 + (CurrentChar - '0');
+            // Each letter is checked as it arrives, against the only node the
+            // first letter allows, so a false '$' is dropped at the first mismatch
+            if (parser->sensorIdIdx == 0) {
+                currentRxMessage->SensorID = comm_node_by_key(CurrentChar);
+                if (currentRxMessage->SensorID != None && NodeShortNames[currentRxMessage->SensorID] == CurrentChar) {
+                    parser->IsShortHeader = true; // The whole node name in one lower case letter
+                    parser->state = ShortID_S;
+                    break;
                 }
+            }
+            if (currentRxMessage->SensorID == None
+                    || NodeNames[currentRxMessage->SensorID][parser->sensorIdIdx] != CurrentChar) {
+                currentRxMessage->SensorID = None;
+                parser_reject(parser); // Invalid sensor ID
                 break;
+            }
+            parser->sensorId[parser->sensorIdIdx++] = CurrentChar;
+            parser->sensorId[parser->sensorIdIdx] = '\0';
+            break;
 
-            case Star_S:
-                checksum_val ^= CurrentChar;
-                if (CurrentChar == ',') {
-                    currentState = CS_S;
+        case ShortID_S:
+            parser->checksum ^= CurrentChar;
+            if (parser->messageIdIdx == 0) {
+                currentRxMessage->messageId = comm_message_by_char(CurrentChar);
+                parser->messageIdIdx++;
+                if (currentRxMessage->messageId == 0xFF) {
+                    parser_reject(parser); // Not a base 36 digit
                 }
-                break;
+            } else if (CurrentChar == ',') {
+                parser->state = ParamsID_S;
+            } else if (CurrentChar == '@') {
+                parser->state = Address_S;
+            } else {
+                parser_reject(parser);
+            }
+            break;
 
-            case CS_S:
-                if (checksumIdx < 2) {
-                    CSStr[checksumIdx++] = CurrentChar;
-                }
-                if (checksumIdx == 2) {
-                    currentState = Waiting_S;
-                    CSStr[checksumIdx] = '\0';
-                    currentRxMessage->checksum = strtol(CSStr, NULL, 16);
-                    if (currentRxMessage->checksum == checksum_val) {
-                        currentRxMessage->IsMessageReady = true;
-                        currentRxMessage->IsCheckSumValid = true;
-                    } else {
-                        currentRxMessage->IsCheckSumValid = false;
-                    }
-                }
+        case Address_S:
+            parser->checksum ^= CurrentChar;
+            if (CurrentChar == ',' && currentRxMessage->address != COMM_ADDRESS_NONE) {
+                parser->state = parser->IsShortHeader ? ParamsID_S : MessageID_S;
+            } else if (CurrentChar >= '0' && CurrentChar <= '9'
+                    && currentRxMessage->address * 10 + (CurrentChar - '0') <= COMM_ADDRESS_MAX) {
+                currentRxMessage->address = currentRxMessage->address * 10 + (CurrentChar - '0');
+            } else {
+                parser_reject(parser); // Not a platform address
+            }
+            break;
+
+        case MessageID_S:
+            parser->checksum ^= CurrentChar;
+            if (CurrentChar == ',' && parser->messageIdIdx == 2) {
+                parser->state = ParamsID_S;
+            } else if (CurrentChar >= '0' && CurrentChar <= '9' && parser->messageIdIdx < 2) {
+                currentRxMessage->messageId = currentRxMessage->messageId * 10 + (CurrentChar - '0');
+                parser->messageIdIdx++;
+            } else {
+                parser_reject(parser); // Message IDs are two digits
+            }
+            break;
+
+        case ParamsID_S:
+            parser->checksum ^= CurrentChar;
+            if (CurrentChar == ',') {
+                parser->state = Star_S;
+            } else if (CurrentChar >= '0' && CurrentChar <= '9' && parser->paramIdx < FRAME_PARAMS_LENGTH) {
+                currentRxMessage->params = currentRxMessage->params * 10 + (CurrentChar - '0');
+                parser->paramIdx++;
+            } else {
+                parser_reject(parser); // Params are up to eight digits
+            }
+            break;
+
+        case Star_S:
+            parser->checksum ^= CurrentChar;
+            if (CurrentChar == ',') {
+                parser->state = CS_S;
+            }
+            break;
+
+        case CS_S: {
+            uint8_t digit = hex_digit(CurrentChar);
+
+            if (digit > 0x0F) {
+                parser->state = Waiting_S;
+                parser->stats.resyncs++; // Not a checksum, so not a match
                 break;
+            }
+            currentRxMessage->checksum = (currentRxMessage->checksum << 4) | digit;
+            if (++parser->checksumIdx == 2) {
+                parser->state = Waiting_S;
+                if (currentRxMessage->checksum == parser->checksum) {
+                    parser->binaryFrameLength = 0; // ASCII bytes are not the start of a binary frame
+                    parser->IsAsciiFrameEnded = true;
+                    currentRxMessage->IsMessageReady = true;
+                    currentRxMessage->IsCheckSumValid = true;
+                    *message = *currentRxMessage;
+                    return true;
+                }
+                currentRxMessage->IsCheckSumValid = false;
+                parser->stats.resyncs++;
+            }
+            break;
+        }
+    }
+    return false;
+}
+
+bool comm_parse_byte(struct CommParser* parser, uint8_t byte, struct CommMessage* message) {
+    return parse_byte(parser, byte, message);
+}
+
+bool comm_parser_next(struct CommParser* parser, struct CommMessage* message) {
+    return parser_next(parser, message);
+}
+
+/******************************************************************************
+ * @brief Parses a span of received bytes, for example a DMA or ring buffer
+ * segment, in one pass. Partial frames stay in the parser for the next span.
+ *
+ * @param parser: The link's parser.
+ * @param data: The received bytes.
+ * @param length: Number of bytes in data.
+ * @param callback: Called for every valid frame, and every reading of a batch.
+ * @param context: Passed through to callback.
+ * @return Number of messages handed to callback.
+ ******************************************************************************/
+uint16_t comm_parse_span(struct CommParser* parser, const uint8_t* data, size_t length,
+                         CommMessageCallback callback, void* context) {
+    struct CommMessage message;
+    uint16_t frames = 0;
+
+    for (size_t idx = 0; idx < length; idx++) {
+        idx += parser_skip(parser, &data[idx], length - idx);
+        if (idx == length) {
+            break;
+        }
+        if (parse_byte(parser, data[idx], &message)) {
+            do {
+                callback(&message, context);
+                frames++;
+            } while (parser_next(parser, &message)); // The rest of a batch
+        }
+    }
+    return frames;
+}
+
+/******************************************************************************
+ * @brief Pulls bytes from the parser's link until a valid frame is decoded.
+ * Bytes after that frame stay in the parser's chunk for the next call.
+ *
+ * @param parser: The link's parser.
+ * @param message: Set to the decoded frame.
+ ******************************************************************************/
+void comm_parser_read(struct CommParser* parser, struct CommMessage* message) {
+    while (1) {
+        if (parser_next(parser, message)) {
+            return; // Left over from a batch frame
+        }
+        if (parser->chunkIdx == parser->chunkLength) {
+            // Chunk exhausted, block until the driver has more bytes
+            parser->chunkLength = read_usart_bytes(parser->port, parser->chunk, COMM_PARSER_CHUNK_LENGTH, portMAX_DELAY);
+            parser->chunkIdx = 0;
+            continue;
+        }
+        parser->chunkIdx += parser_skip(parser, &parser->chunk[parser->chunkIdx], parser->chunkLength - parser->chunkIdx);
+        if (parser->chunkIdx == parser->chunkLength) {
+            continue;
+        }
+        if (parse_byte(parser, parser->chunk[parser->chunkIdx++], message)) {
+            return;
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Parses incoming messages from sensors on USART6.
+ *
+ * @param currentRxMessage: Pointer to the structure that will hold the parsed message.
+ ******************************************************************************/
+void parse_sensor_message(struct CommMessage* currentRxMessage) {
+    static struct CommParser SensorParser;
+    static bool IsParserReady = false;
+
+    if (!IsParserReady) {
+        comm_parser_init(&SensorParser, USART_PORT_EXTERN);
+        IsParserReady = true;
+    }
+    comm_parser_read(&SensorParser, currentRxMessage);
+}
+
+// Arguments a Host PC command takes
+enum HostPCArgs {
+    HOSTPC_ARGS_NONE,
+    HOSTPC_ARGS_SENSOR,       // <sensor>
+    HOSTPC_ARGS_SENSOR_VALUE, // <sensor> <number>
+    HOSTPC_ARGS_VALUE         // <number>
+};
+
+struct HostPCCommandSpec {
+    const char* name;
+    enum HostPCCommands command;
+    enum HostPCArgs args;
+    const char* usage;
+};
+
+#define HOSTPC_MAX_TOKENS 3
+
+static const struct HostPCCommandSpec HostPCCommandTable[] = {
+    {"START",   PC_Command_START,   HOSTPC_ARGS_NONE,         "START"},
+    {"RESET",   PC_Command_RESET,   HOSTPC_ARGS_NONE,         "RESET"},
+    {"STATS",   PC_Command_STATS,   HOSTPC_ARGS_NONE,         "STATS"},
+    {"LAT",     PC_Command_LATENCY, HOSTPC_ARGS_NONE,         "LAT"},
+    {"PERIOD",  PC_Command_PERIOD,  HOSTPC_ARGS_SENSOR_VALUE, "PERIOD <sensor> <ms>"},
+    {"ENABLE",  PC_Command_ENABLE,  HOSTPC_ARGS_SENSOR,       "ENABLE <sensor>"},
+    {"DISABLE", PC_Command_DISABLE, HOSTPC_ARGS_SENSOR,       "DISABLE <sensor>"},
+    {"DUMP",    PC_Command_DUMP,    HOSTPC_ARGS_VALUE,        "DUMP <n>"},
+    {"RATE",    PC_Command_RATE,    HOSTPC_ARGS_VALUE,        "RATE <baud>"},
+    {"HELP",    PC_Command_HELP,    HOSTPC_ARGS_NONE,         "HELP"},
+};
+
+/******************************************************************************
+ * @brief Splits a line into words in place, at spaces and tabs.
+ *
+ * @return Number of words, max_tokens + 1 if there are more than max_tokens.
+ ******************************************************************************/
+static uint8_t tokenize(char* line, char* tokens[], uint8_t max_tokens) {
+    uint8_t count = 0;
+
+    while (*line) {
+        while (*line == ' ' || *line == '\t') {
+            *line++ = '\0';
+        }
+        if (*line == '\0') {
+            break;
+        }
+        if (count == max_tokens) {
+            return max_tokens + 1;
+        }
+        tokens[count++] = line;
+        while (*line && *line != ' ' && *line != '\t') {
+            line++;
+        }
+    }
+    return count;
+}
+
+/******************************************************************************
+ * @brief Reads a decimal number. Fails on anything but digits, and on values
+ * that do not fit 32 bits.
+ ******************************************************************************/
+static bool parse_u32(const char* str, uint32_t* value) {
+    uint32_t result = 0;
+
+    if (*str == '\0') {
+        return false;
+    }
+    for (; *str; str++) {
+        if (*str < '0' || *str > '9' || result > (UINT32_MAX - (*str - '0')) / 10) {
+            return false;
+        }
+        result = result * 10 + (*str - '0');
+    }
+    *value = result;
+    return true;
+}
+
+/******************************************************************************
+ * @brief Checks the words of a line against the command table.
+ ******************************************************************************/
+static void parse_hostPC_line(char* line, struct HostPCCommand* command) {
+    static const struct HostPCCommand EmptyCommand = {PC_Command_INVALID, None, 0, NULL};
+    const struct HostPCCommandSpec* spec = NULL;
+    char* tokens[HOSTPC_MAX_TOKENS];
+    uint8_t count, expected;
+
+    *command = EmptyCommand;
+    count = tokenize(line, tokens, HOSTPC_MAX_TOKENS);
+    if (count == 0) {
+        command->command = PC_Command_NONE; // Blank line
+        return;
+    }
+    for (int idx = 0; idx < sizeof(HostPCCommandTable) / sizeof(HostPCCommandTable[0]); idx++) {
+        if (strcmp(tokens[0], HostPCCommandTable[idx].name) == 0) {
+            spec = &HostPCCommandTable[idx];
+            break;
+        }
+    }
+    if (spec == NULL) {
+        return; // Unknown command
+    }
+    command->usage = spec->usage;
+
+    expected = (spec->args == HOSTPC_ARGS_NONE) ? 1 : (spec->args == HOSTPC_ARGS_SENSOR_VALUE) ? 3 : 2;
+    if (count != expected) {
+        return;
+    }
+    if (spec->args == HOSTPC_ARGS_SENSOR || spec->args == HOSTPC_ARGS_SENSOR_VALUE) {
+        if (strlen(tokens[1]) != COMM_NODE_NAME_LENGTH) {
+            return;
+        }
+        command->sensor = lookup_node(tokens[1]);
+        if (!comm_is_sensor(command->sensor)) {
+            return;
+        }
+    }
+    if (spec->args == HOSTPC_ARGS_VALUE || spec->args == HOSTPC_ARGS_SENSOR_VALUE) {
+        if (!parse_u32(tokens[count - 1], &command->value)) {
+            return;
         }
     }
+    command->command = spec->command;
 }
 
 /******************************************************************************
- * @brief Parses messages received from the Host PC.
+ * @brief Parses messages received from the Host PC, one line per call. Lines
+ * longer than HOSTPC_LINE_LENGTH are discarded whole.
  *
- * @return enum HostPCCommands: Command parsed from the Host PC.
+ * @param command: Set to the command parsed from the Host PC.
  ******************************************************************************/
-enum HostPCCommands parse_hostPC_message() {
+void parse_hostPC_message(struct HostPCCommand* command) {
     uint8_t CurrentChar;
-    static char HostPCMessage[10];
+    static char HostPCMessage[HOSTPC_LINE_LENGTH + 1];
     static uint16_t HostPCMessage_IDX = 0;
+    static bool IsLineTooLong = false;
 
-    while (xQueueReceive(Queue_hostPC_UART, &CurrentChar, portMAX_DELAY) == pdPASS) {
-        if (CurrentChar == '\n' || CurrentChar == '\r' || HostPCMessage_IDX >= 6) {
-            HostPCMessage[HostPCMessage_IDX++] = '\0';
+    while (read_hostPC_bytes(&CurrentChar, 1, portMAX_DELAY) == 1) {
+        if (CurrentChar == '\n' || CurrentChar == '\r') {
+            HostPCMessage[HostPCMessage_IDX] = '\0';
             HostPCMessage_IDX = 0;
-            if (strcmp(HostPCMessage, "START") == 0)
-                return PC_Command_START;
-            else if (strcmp(HostPCMessage, "RESET") == 0)
-                return PC_Command_RESET;
+            if (IsLineTooLong) {
+                IsLineTooLong = false;
+                command->command = PC_Command_INVALID;
+                command->usage = NULL;
+                return;
+            }
+            parse_hostPC_line(HostPCMessage, command);
+            if (command->command != PC_Command_NONE) {
+                return;
+            }
+        } else if (HostPCMessage_IDX < HOSTPC_LINE_LENGTH) {
+            HostPCMessage[HostPCMessage_IDX++] = (CurrentChar >= 'a' && CurrentChar <= 'z') ? CurrentChar - 'a' + 'A' : CurrentChar;
         } else {
-            HostPCMessage[HostPCMessage_IDX++] = CurrentChar;
+            IsLineTooLong = true;
         }
     }
-    return PC_Command_NONE;
+    command->command = PC_Command_NONE;
+}
+
+const char* hostPC_command_usage(uint8_t index) {
+    if (index >= sizeof(HostPCCommandTable) / sizeof(HostPCCommandTable[0])) {
+        return NULL;
+    }
+    return HostPCCommandTable[index].usage;
 }
 
 /******************************************************************************
@@ -199,22 +819,14 @@ enum HostPCCommands parse_hostPC_message() {
  * @param data: The sensor data value.
  ******************************************************************************/
 void send_sensorData_message(enum SensorId_t sensorType, uint16_t data) {
-    char tx_sensor_buffer[50];
-
-    switch (sensorType) {
-        case Turbidity:
-            sprintf(tx_sensor_buffer, "$TURBD,03,%08u,*,00\n", data);
-            break;
-        case Microplastic:
-            sprintf(tx_sensor_buffer, "$MCRPL,03,%08u,*,00\n", data);
-            break;
-        case DOLevel:
-            sprintf(tx_sensor_buffer, "$DOLEV,03,%08u,*,00\n", data);
-            break;
-        default:
-            return; // Invalid sensor type
+    if (!comm_is_sensor(sensorType)) {
+        return; // Invalid sensor type
+    }
+    if (reliable_is_active()) {
+        reliable_send_data(sensorType, data); // Numbered and kept until acknowledged
+    } else {
+        send_data_frame(sensorType, data, false, 0, xTaskGetTickCount());
     }
-    sendStringSensor(tx_sensor_buffer);
 }
 
 /******************************************************************************
@@ -224,31 +836,152 @@ void send_sensorData_message(enum SensorId_t sensorType, uint16_t data) {
  * @param TimePeriod_ms: The time period for the sensor in milliseconds.
  ******************************************************************************/
 void send_sensorEnable_message(enum SensorId_t sensorType, uint16_t TimePeriod_ms) {
-    char tx_sensor_buffer[50];
-
-    switch (sensorType) {
-        case Turbidity:
-            sprintf(tx_sensor_buffer, "$TURBD,00,%08u,*,00\n", TimePeriod_ms);
-            break;
-        case Microplastic:
-            sprintf(tx_sensor_buffer, "$MCRPL,00,%08u,*,00\n", TimePeriod_ms);
-            break;
-        case DOLevel:
-            sprintf(tx_sensor_buffer, "$DOLEV,00,%08u,*,00\n", TimePeriod_ms);
-            break;
-        default:
-            return; // Invalid sensor type
+    if (!comm_is_sensor(sensorType)) {
+        return; // Invalid sensor type
     }
-    sendStringSensor(tx_sensor_buffer);
+    send_frame(sensorType, COMM_MSG_RESET_ENABLE, true, TimePeriod_ms);
 }
 
 /******************************************************************************
  * @brief Sends a reset message to all sensors.
  ******************************************************************************/
 void send_sensorReset_message(void) {
-    char tx_sensor_buffer[50];
-    sprintf(tx_sensor_buffer, "$CNTRL,00,,*,00\n");
-    sendStringSensor(tx_sensor_buffer);
+    send_frame(Controller, COMM_MSG_RESET_ENABLE, false, 0);
+}
+
+/******************************************************************************
+ * @brief Sends a link rate message. The rate travels divided by 100 so the
+ * fastest candidate still fits the 16-bit params field.
+ *
+ * @param baud: The USART6 baud rate.
+ ******************************************************************************/
+void send_linkRate_message(uint32_t baud) {
+    send_frame(Controller, COMM_MSG_LINK_RATE, true, baud / 100);
+}
+
+/******************************************************************************
+ * @brief Sends a sensor data message carrying a reliable mode sequence number.
+ *
+ * @param sensorType: The type of sensor sending the data.
+ * @param data: The sensor data value.
+ * @param seq: The frame's sequence number.
+ * @param sample_tick: Tick count when the reading was taken.
+ ******************************************************************************/
+void send_sensorDataSeq_message(enum SensorId_t sensorType, uint16_t data, uint8_t seq, uint32_t sample_tick) {
+    send_data_frame(sensorType, data, true, seq, sample_tick);
+}
+
+/******************************************************************************
+ * @brief Sends a time request (controller, no timestamp) or answer (platform,
+ * with its tick count).
+ *
+ * @param has_timestamp: True for the answer.
+ * @param timestamp: The platform tick count.
+ ******************************************************************************/
+void send_clock_message(bool has_timestamp, uint32_t timestamp) {
+    struct CommMessage message = {
+        .address = TxAddress,
+        .SensorID = Controller,
+        .messageId = COMM_MSG_CLOCK,
+        .timestamp = timestamp,
+        .HasTimestamp = has_timestamp,
+    };
+
+    send_message_frame(&message, false);
+}
+
+/******************************************************************************
+ * @brief Sends waiting sensor readings in one frame: one header, CRC and
+ * delimiter for all of them. Batching is only negotiated on binary links.
+ *
+ * @param readings: The data frames, delta coded if compression is on.
+ * @param count: Number of readings.
+ ******************************************************************************/
+void send_sensorDataBatch_message(const struct CommMessage* readings, uint8_t count) {
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1];
+    enum CommFraming framing = LinkFramings[TX_PORT];
+
+    if (count == 1 || comm_framing_is_ascii(framing)) {
+        for (uint8_t idx = 0; idx < count; idx++) {
+            if (!send_message_frame(&readings[idx], true)) {
+                delta_frame_lost(readings[idx].SensorID);
+            }
+        }
+        return;
+    }
+    if (!lane_write(COMM_LANE_TELEMETRY, frame, binary_batch_encode(frame, readings, count, readings[0].address,
+                                                                    framing_integrity(framing)), send_timeout())) {
+        for (uint8_t idx = 0; idx < count; idx++) {
+            delta_frame_lost(readings[idx].SensorID);
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Sends a poll (controller) or the end of the polled platform's turn,
+ * after the readings it sent.
+ *
+ * @param params: 0 in the poll, readings sent and dropped packed by
+ * BUS_TURN_PARAMS() at the end of a turn.
+ ******************************************************************************/
+void send_poll_message(uint16_t params) {
+    send_frame(Controller, COMM_MSG_POLL, true, params);
+}
+
+/******************************************************************************
+ * @brief Sends a discovery request (controller) or answer (platform).
+ *
+ * @param sensors: Bit (1 << sensor) for every sensor the platform has.
+ ******************************************************************************/
+void send_discover_message(uint16_t sensors) {
+    send_frame(Controller, COMM_MSG_DISCOVER, true, sensors);
+}
+
+/******************************************************************************
+ * @brief Sends a batching request (controller) or answer (platform).
+ *
+ * @param params: Max readings and max delay, packed by BATCH_PARAMS().
+ ******************************************************************************/
+void send_batch_message(uint16_t params) {
+    send_frame(Controller, COMM_MSG_BATCH_CONFIG, true, params);
+}
+
+/******************************************************************************
+ * @brief Sends a compression request (controller) or answer (platform).
+ *
+ * @param interval: Data frames per keyframe, 0 for off.
+ ******************************************************************************/
+void send_compression_message(uint8_t interval) {
+    send_frame(Controller, COMM_MSG_COMPRESSION, true, interval);
+}
+
+/******************************************************************************
+ * @brief Sends a reliable mode request (controller) or answer (platform).
+ *
+ * @param window: Frames the platform may have unacknowledged, 0 for off.
+ ******************************************************************************/
+void send_reliable_message(uint8_t window) {
+    send_frame(Controller, COMM_MSG_RELIABLE, true, window);
+}
+
+/******************************************************************************
+ * @brief Sends a reliable mode acknowledgment: every frame before next_seq
+ * arrived, and bit i of received is set if frame next_seq + i did too.
+ *
+ * @param next_seq: The first sequence number not received.
+ * @param received: Selective acknowledgment of the frames after it.
+ ******************************************************************************/
+void send_reliableAck_message(uint8_t next_seq, uint16_t received) {
+    struct CommMessage message = {
+        .address = TxAddress,
+        .SensorID = Controller,
+        .messageId = COMM_MSG_RELIABLE_ACK,
+        .params = received,
+        .seq = next_seq,
+        .HasSeq = true,
+    };
+
+    send_message_frame(&message, true);
 }
 
 /******************************************************************************
@@ -257,23 +990,62 @@ void send_sensorReset_message(void) {
  * @param AckType: The acknowledgment type.
  ******************************************************************************/
 void send_ack_message(enum AckTypes AckType) {
-    char tx_sensor_buffer[50];
+    enum SensorId_t node = Controller + AckType; // Ack types follow the node table
 
-    switch (AckType) {
-        case RemoteSensingPlatformReset:
-            sprintf(tx_sensor_buffer, "$CNTRL,01,,*,00\n");
-            break;
-        case TurbiditySensorEnable:
-            sprintf(tx_sensor_buffer, "$TURBD,01,,*,00\n");
-            break;
-        case MicroplasticSensorEnable:
-            sprintf(tx_sensor_buffer, "$MCRPL,01,,*,00\n");
-            break;
-        case DOLevelSensorEnable:
-            sprintf(tx_sensor_buffer, "$DOLEV,01,,*,00\n");
-            break;
-        default:
-            return; // Invalid acknowledgment type
+    if (node >= COMM_NODE_COUNT) {
+        return; // Invalid acknowledgment type
     }
-    sendStringSensor(tx_sensor_buffer);
+    send_frame(node, COMM_MSG_ACK, false, 0);
+}
+
+/******************************************************************************
+ * @brief Sends a framing message. The controller asks for a framing; the
+ * platform answers with the one it switches to.
+ *
+ * @param framing: The framing asked for or accepted.
+ ******************************************************************************/
+void send_framing_message(enum CommFraming framing) {
+    send_frame(Controller, COMM_MSG_FRAMING, true, framing);
+}
+
+/******************************************************************************
+ * @brief Platform side of the framing handshake. The echo goes out in the old
+ * framing, which the controller is still expecting, before switching.
+ *
+ * @param requested: The framing asked for by the controller.
+ ******************************************************************************/
+void handle_framing_request(uint16_t requested) {
+    enum CommFraming framing = (requested > COMM_FRAMING_ASCII_SHORT) ? COMM_FRAMING_BINARY_CRC32 : requested;
+
+    send_framing_message(framing);
+    set_sensor_framing(framing);
+}
+
+/******************************************************************************
+ * @brief Selects the framing of a link: what is sent on it, and the CRC
+ * binary frames received on it must carry. ASCII frames are accepted
+ * regardless, so a peer that restarts in ASCII is still heard.
+ ******************************************************************************/
+void comm_set_link_framing(enum UsartPort port, enum CommFraming framing) {
+    LinkFramings[port] = framing;
+}
+
+enum CommFraming comm_get_link_framing(enum UsartPort port) {
+    return LinkFramings[port];
+}
+
+void set_sensor_framing(enum CommFraming framing) {
+    comm_set_link_framing(TX_PORT, framing);
+}
+
+enum CommFraming get_sensor_framing(void) {
+    return LinkFramings[TX_PORT];
+}
+
+void comm_set_address(uint8_t address) {
+    TxAddress = address;
+}
+
+uint8_t comm_get_address(void) {
+    return TxAddress;
 }
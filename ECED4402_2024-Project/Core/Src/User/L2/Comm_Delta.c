@@ -0,0 +1,151 @@
+/*
+ * Comm_Delta.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_Delta.h" // Header for delta compression
+#include "User/L2/Comm_Reliable.h" // Header for reliable delivery
+
+static volatile uint8_t KeyframeInterval = 0; // Platform: negotiated interval, 0 when compression is off
+static struct DeltaBase EncoderBases[COMM_NODE_COUNT]; // Platform: last reading sent per sensor
+static struct DeltaStats Stats;
+
+/******************************************************************************
+ * @brief Bytes varint_put() in Comm_Binary.c takes for value.
+ ******************************************************************************/
+static uint8_t varint_length(uint32_t value) {
+    uint8_t length = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+/******************************************************************************
+ * @brief Platform side of the handshake. The next frame of every sensor is a
+ * keyframe, so the controller never applies a delta to a value from before.
+ ******************************************************************************/
+void delta_handle_request(uint16_t interval) {
+    if (comm_framing_is_ascii(get_sensor_framing()) || reliable_is_active()) {
+        interval = 0;
+    } else if (interval > DELTA_KEYFRAME_MAX) {
+        interval = DELTA_KEYFRAME_MAX;
+    }
+
+    for (int idx = 0; idx < COMM_NODE_COUNT; idx++) {
+        EncoderBases[idx].countdown = 0;
+    }
+    KeyframeInterval = interval;
+    send_compression_message(interval);
+}
+
+bool delta_is_active(void) {
+    return KeyframeInterval != 0;
+}
+
+void delta_start(uint8_t interval) {
+    Stats.interval = interval;
+}
+
+/******************************************************************************
+ * @brief Platform side. Runs where the data frames are sent: in the sensor
+ * timer callbacks, which all run in the timer task, or on a shared bus in the
+ * task answering polls, which then sends all of them. Either way only one task
+ * at a time, so the bases need no lock. A keyframe is sent when one is due,
+ * when timestamps have just been turned on, and when the difference is too
+ * large for the params field.
+ ******************************************************************************/
+void delta_encode(struct CommMessage* message) {
+    struct DeltaBase* base;
+    uint16_t value = message->params;
+    uint32_t timestamp = message->timestamp;
+    uint32_t zigzag;
+
+    if (KeyframeInterval == 0 || message->HasSeq || message->SensorID >= COMM_NODE_COUNT) {
+        return;
+    }
+
+    base = &EncoderBases[message->SensorID];
+    zigzag = delta_zigzag((int32_t)value - base->value);
+    if (base->countdown != 0 && base->HasTimestamp == message->HasTimestamp && zigzag <= UINT16_MAX) {
+        message->params = zigzag;
+        message->timestamp = timestamp - base->timestamp;
+        message->IsDelta = true;
+        base->countdown--;
+    } else {
+        base->countdown = KeyframeInterval - 1;
+    }
+
+    base->value = value;
+    base->timestamp = timestamp;
+    base->HasTimestamp = message->HasTimestamp;
+}
+
+/******************************************************************************
+ * @brief Receive side. Every full data frame becomes its sensor's base, also
+ * before compression is negotiated, so the first delta always has one.
+ ******************************************************************************/
+bool delta_decode(struct DeltaDecoder* decoder, struct CommMessage* message) {
+    struct DeltaBase* base;
+    uint8_t sent_bytes;
+
+    if (message->messageId != COMM_MSG_DATA || message->SensorID >= COMM_NODE_COUNT) {
+        return true;
+    }
+
+    base = &decoder->bases[message->SensorID];
+    sent_bytes = varint_length(message->params)
+            + (message->HasTimestamp ? varint_length(message->timestamp) : 0);
+    if (message->IsDelta) {
+        if (!base->IsValid || base->HasTimestamp != message->HasTimestamp) {
+            Stats.unresolved++;
+            return false;
+        }
+        message->params = base->value + delta_unzigzag(message->params);
+        message->timestamp += base->timestamp;
+        Stats.deltas++;
+    } else {
+        Stats.keyframes++;
+    }
+    Stats.sent_bytes += sent_bytes;
+    Stats.full_bytes += varint_length(message->params)
+            + (message->HasTimestamp ? varint_length(message->timestamp) : 0);
+
+    base->value = message->params;
+    base->timestamp = message->timestamp;
+    base->HasTimestamp = message->HasTimestamp;
+    base->IsValid = true;
+    return true;
+}
+
+void delta_invalidate(struct DeltaDecoder* decoder) {
+    bool WasValid = false;
+
+    for (int idx = 0; idx < COMM_NODE_COUNT; idx++) {
+        WasValid |= decoder->bases[idx].IsValid;
+        decoder->bases[idx].IsValid = false;
+    }
+    if (WasValid) {
+        Stats.resyncs++;
+    }
+}
+
+/******************************************************************************
+ * @brief Platform side. Called from the task that encoded the frame, so the
+ * same one that touches the bases. The controller's base is still the value
+ * before the lost frame, so nothing may be sent against the new one.
+ ******************************************************************************/
+void delta_frame_lost(enum SensorId_t sensor) {
+    if (sensor < COMM_NODE_COUNT) {
+        EncoderBases[sensor].countdown = 0; // Next frame is a keyframe
+    }
+}
+
+void get_delta_stats(struct DeltaStats* stats) {
+    *stats = Stats;
+}
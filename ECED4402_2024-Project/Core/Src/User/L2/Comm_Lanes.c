@@ -0,0 +1,199 @@
+/*
+ * Comm_Lanes.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <string.h>
+
+#include "User/L2/Comm_Lanes.h" // Header for the transmit lanes
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#define LANE_TOTAL_DEPTH (LANE_CONTROL_DEPTH + LANE_ALARM_DEPTH + LANE_TELEMETRY_DEPTH)
+#define LANE_TASK_STACK  (configMINIMAL_STACK_SIZE + 100)
+
+// One frame waiting in a lane, copied in and out of the lane's queue
+struct LaneFrame {
+    uint16_t length;
+    TickType_t queued_tick;
+    uint8_t data[LANE_FRAME_MAX];
+};
+
+struct Lane {
+    QueueHandle_t queue;
+    StaticQueue_t queue_buffer;
+    struct LaneStats stats;
+};
+
+// Lanes and task are allocated statically, the FreeRTOS heap is sized for the application tasks
+static uint8_t ControlStorage[LANE_CONTROL_DEPTH * sizeof(struct LaneFrame)];
+static uint8_t AlarmStorage[LANE_ALARM_DEPTH * sizeof(struct LaneFrame)];
+static uint8_t TelemetryStorage[LANE_TELEMETRY_DEPTH * sizeof(struct LaneFrame)];
+static struct Lane Lanes[COMM_LANE_COUNT];
+static SemaphoreHandle_t FramesWaiting; // Counts frames in all lanes, given after each is queued
+static StaticSemaphore_t FramesWaitingBuffer;
+static StaticTask_t LaneTaskBuffer;
+static StackType_t LaneTaskStack[LANE_TASK_STACK];
+static volatile bool IsSending = false; // The transmit task holds a frame taken from a lane
+
+/******************************************************************************
+ * @brief Transmit task. Waits for the USART driver to be ready before picking
+ * a lane, so the choice is made at the frame boundary: a control frame queued
+ * while a telemetry frame is on the wire goes out right after it.
+ ******************************************************************************/
+static void lane_task(void* params) {
+    static struct LaneFrame frame;
+    struct LaneStats* stats;
+    uint32_t wait_ms;
+    enum CommLane lane;
+
+    for (;;) {
+        xSemaphoreTake(FramesWaiting, portMAX_DELAY);
+        usart_tx_wait_ready(USART_PORT_EXTERN, portMAX_DELAY);
+
+        IsSending = true;
+        for (lane = COMM_LANE_CONTROL; lane < COMM_LANE_COUNT; lane++) {
+            if (xQueueReceive(Lanes[lane].queue, &frame, 0) == pdPASS) {
+                break;
+            }
+        }
+        if (lane == COMM_LANE_COUNT) {
+            IsSending = false;
+            continue; // Cannot happen: every count follows its frame into a lane
+        }
+
+        stats = &Lanes[lane].stats;
+        wait_ms = (xTaskGetTickCount() - frame.queued_tick) * portTICK_PERIOD_MS;
+        taskENTER_CRITICAL();
+        if (wait_ms > stats->max_wait_ms) {
+            stats->max_wait_ms = wait_ms;
+        }
+        stats->frames++;
+        taskEXIT_CRITICAL();
+
+        usart_tx_write(USART_PORT_EXTERN, frame.data, frame.length, portMAX_DELAY);
+        IsSending = false;
+    }
+}
+
+/******************************************************************************
+ * @brief Creates the lane queues, the frame count and the transmit task.
+ ******************************************************************************/
+void initialize_lanes(void) {
+    static uint8_t* const Storage[COMM_LANE_COUNT] = {ControlStorage, AlarmStorage, TelemetryStorage};
+    static const UBaseType_t Depths[COMM_LANE_COUNT] = {LANE_CONTROL_DEPTH, LANE_ALARM_DEPTH, LANE_TELEMETRY_DEPTH};
+
+    for (enum CommLane lane = COMM_LANE_CONTROL; lane < COMM_LANE_COUNT; lane++) {
+        Lanes[lane].queue = xQueueCreateStatic(Depths[lane], sizeof(struct LaneFrame),
+                                               Storage[lane], &Lanes[lane].queue_buffer);
+    }
+    FramesWaiting = xSemaphoreCreateCountingStatic(LANE_TOTAL_DEPTH, 0, &FramesWaitingBuffer);
+
+    xTaskCreateStatic(lane_task,
+                      "Comm_Lanes_Task",
+                      LANE_TASK_STACK,
+                      NULL,
+                      LANE_TASK_PRIORITY,
+                      LaneTaskStack,
+                      &LaneTaskBuffer);
+}
+
+bool lane_is_alarm(enum SensorId_t sensor, uint16_t value) {
+    switch (sensor) {
+        case Turbidity:
+            return value > LANE_ALARM_TURBIDITY_MIN;
+        case Microplastic:
+            return value > LANE_ALARM_MICROPLASTIC_MIN;
+        case DOLevel:
+            return value < LANE_ALARM_DOLEVEL_MAX;
+        default:
+            return false;
+    }
+}
+
+/******************************************************************************
+ * @brief Gathers the segments into a lane slot. The slot is built on the
+ * caller's stack and copied into the queue, so senders never share a buffer.
+ * Any task or timer may be sending, so the counters are only changed with
+ * interrupts masked.
+ ******************************************************************************/
+bool lane_writev(enum CommLane lane, const struct UsartTxSegment* segments, uint8_t count, TickType_t timeout) {
+    struct Lane* target = &Lanes[lane];
+    struct LaneFrame frame;
+    uint32_t depth;
+    bool IsQueued;
+
+    frame.length = 0;
+    for (uint8_t seg = 0; seg < count; seg++) {
+        if (frame.length + segments[seg].length > LANE_FRAME_MAX) {
+            return false;
+        }
+        memcpy(&frame.data[frame.length], segments[seg].data, segments[seg].length);
+        frame.length += segments[seg].length;
+    }
+    frame.queued_tick = xTaskGetTickCount();
+
+    if (xQueueSend(target->queue, &frame, 0) != pdPASS) {
+        IsQueued = (timeout != 0 && xQueueSend(target->queue, &frame, timeout) == pdPASS);
+
+        taskENTER_CRITICAL();
+        target->stats.waits += (timeout != 0) ? 1 : 0;
+        target->stats.dropped += IsQueued ? 0 : 1;
+        taskEXIT_CRITICAL();
+        if (!IsQueued) {
+            return false;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    depth = uxQueueMessagesWaiting(target->queue);
+    if (depth > target->stats.peak_depth) {
+        target->stats.peak_depth = depth;
+    }
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(FramesWaiting);
+    return true;
+}
+
+bool lane_write(enum CommLane lane, const uint8_t* data, uint16_t length, TickType_t timeout) {
+    const struct UsartTxSegment segment = { data, length };
+
+    return lane_writev(lane, &segment, 1, timeout);
+}
+
+/******************************************************************************
+ * @brief Polls once per tick; only used around a baud rate change. The USART
+ * driver's own buffers are waited for by usart_set_baud().
+ ******************************************************************************/
+bool lane_flush(TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;) {
+        bool IsEmpty = !IsSending;
+
+        for (enum CommLane lane = COMM_LANE_CONTROL; lane < COMM_LANE_COUNT && IsEmpty; lane++) {
+            IsEmpty = (uxQueueMessagesWaiting(Lanes[lane].queue) == 0);
+        }
+        if (IsEmpty) {
+            return true;
+        }
+        if (xTaskGetTickCount() - start >= timeout) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+void get_lane_stats(enum CommLane lane, struct LaneStats* stats) {
+    taskENTER_CRITICAL();
+    *stats = Lanes[lane].stats;
+    stats->depth = uxQueueMessagesWaiting(Lanes[lane].queue);
+    taskEXIT_CRITICAL();
+}
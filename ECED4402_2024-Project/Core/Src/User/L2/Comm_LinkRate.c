@@ -0,0 +1,214 @@
+/*
+ * Comm_LinkRate.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L1/USART_Driver.h" // USART driver for serial communication
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_LinkRate.h" // Header for link rate negotiation
+#include "User/L2/Comm_Lanes.h" // Header for the transmit lanes
+#include "User/util.h" // Utility functions
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "timers.h"
+
+// Rates tried in ascending order. All are exact divisions of the 84 MHz APB2
+// clock or within 0.1% of it, and fit the 16-bit params field once divided by 100.
+static const uint32_t LinkRates[] = {115200, 230400, 460800, 921600, 1312500, 2625000};
+
+static TimerHandle_t TimerID_Confirm, TimerID_Monitor, TimerID_Retry;
+static uint32_t RateCeiling = UINT32_MAX; // Rates at or above this failed before
+static volatile uint32_t PendingBaud = 0;  // Rate switched to but not yet confirmed
+static uint32_t PreviousBaud = LINK_RATE_BASE_BAUD; // Rate to revert to if it is not
+static volatile uint32_t SwitchBaud = 0;   // Rate a timer is still switching to, 0 if none
+static bool IsFallbackSwitch = false;      // The switch is a fallback, announced once made
+static uint32_t FallbackCount = 0;
+
+/******************************************************************************
+ * @brief Makes the switch a timer asked for. Runs in the timer daemon, so the
+ * USART is only waited for LINK_RATE_SWITCH_MS; if it is still busy then, the
+ * retry timer tries again rather than holding up every other timer.
+ * A fallback is announced at the new rate. The announcement reaches a peer
+ * still at the old rate as framing errors, which makes its own monitor fall
+ * back as well.
+ ******************************************************************************/
+static void link_rate_switch(void) {
+    if (SwitchBaud == 0) {
+        return; // Superseded by a request from the controller
+    }
+    if (!usart_set_baud(USART_PORT_EXTERN, SwitchBaud, pdMS_TO_TICKS(LINK_RATE_SWITCH_MS))) {
+        xTimerStart(TimerID_Retry, 0);
+        return;
+    }
+    SwitchBaud = 0;
+
+    if (IsFallbackSwitch) {
+        IsFallbackSwitch = false;
+        FallbackCount++;
+        send_linkRate_message(LINK_RATE_BASE_BAUD);
+        print_str("Sensor link fell back to 115200 baud.\r\n");
+    }
+}
+
+/******************************************************************************
+ * @brief Timer callback: a switch timed out waiting for the USART.
+ ******************************************************************************/
+static void link_rate_retry(TimerHandle_t xTimer) {
+    link_rate_switch();
+}
+
+/******************************************************************************
+ * @brief Timer callback: the controller never confirmed the new rate, so go
+ * back to the one that worked.
+ ******************************************************************************/
+static void link_rate_confirm_expired(TimerHandle_t xTimer) {
+    if (PendingBaud != 0) {
+        link_rate_limit(PendingBaud);
+        PendingBaud = 0;
+        SwitchBaud = PreviousBaud;
+        link_rate_switch();
+    }
+}
+
+/******************************************************************************
+ * @brief Timer callback: drops back to the base rate when the sensor link
+ * error counters rise faster than LINK_RATE_ERROR_LIMIT per period.
+ ******************************************************************************/
+static void link_rate_monitor(TimerHandle_t xTimer) {
+    static uint32_t LastErrors = 0;
+    struct UsartStats stats;
+    uint32_t errors, baud;
+
+    get_usart_stats(USART_PORT_EXTERN, &stats);
+    errors = stats.overrun_errors + stats.framing_errors + stats.noise_errors;
+    baud = usart_get_baud(USART_PORT_EXTERN);
+
+    if (errors - LastErrors >= LINK_RATE_ERROR_LIMIT && baud != LINK_RATE_BASE_BAUD && SwitchBaud == 0) {
+        link_rate_limit(baud);
+        PendingBaud = 0;
+        SwitchBaud = LINK_RATE_BASE_BAUD;
+        IsFallbackSwitch = true;
+        link_rate_switch();
+
+        // Errors caused by the switch itself should not count against the next period
+        get_usart_stats(USART_PORT_EXTERN, &stats);
+        errors = stats.overrun_errors + stats.framing_errors + stats.noise_errors;
+    }
+    LastErrors = errors;
+}
+
+/******************************************************************************
+ * @brief Checks a rate against the candidate table, the failed-rate ceiling
+ * and what the USART clock can generate.
+ ******************************************************************************/
+static bool link_rate_supported(uint32_t baud) {
+    if (baud >= RateCeiling || baud > usart_max_baud(USART_PORT_EXTERN)) {
+        return false;
+    }
+    for (int idx = 0; idx < sizeof(LinkRates) / sizeof(LinkRates[0]); idx++) {
+        if (LinkRates[idx] == baud) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+ * @brief Creates the confirmation and monitor timers.
+ ******************************************************************************/
+void initialize_link_rate(void) {
+    TimerID_Confirm = xTimerCreate(
+        "Link Rate Confirm",
+        pdMS_TO_TICKS(LINK_RATE_CONFIRM_MS),
+        pdFALSE,    // One shot: restarted for every switch
+        (void*)0,
+        link_rate_confirm_expired
+        );
+
+    TimerID_Monitor = xTimerCreate(
+        "Link Rate Monitor",
+        pdMS_TO_TICKS(LINK_RATE_MONITOR_MS),
+        pdTRUE,     // Autoreload: runs for as long as the link is up
+        (void*)1,
+        link_rate_monitor
+        );
+
+    TimerID_Retry = xTimerCreate(
+        "Link Rate Retry",
+        pdMS_TO_TICKS(LINK_RATE_RETRY_MS),
+        pdFALSE,    // One shot: started when a switch times out
+        (void*)2,
+        link_rate_retry
+        );
+
+    xTimerStart(TimerID_Monitor, 0);
+}
+
+/******************************************************************************
+ * @brief Returns the next supported candidate above baud, 0 if none is left.
+ ******************************************************************************/
+uint32_t link_rate_next(uint32_t baud) {
+    for (int idx = 0; idx < sizeof(LinkRates) / sizeof(LinkRates[0]); idx++) {
+        if (LinkRates[idx] > baud) {
+            return link_rate_supported(LinkRates[idx]) ? LinkRates[idx] : 0;
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * @brief Stops baud and everything above it from being proposed or accepted.
+ ******************************************************************************/
+void link_rate_limit(uint32_t baud) {
+    if (baud > LINK_RATE_BASE_BAUD && baud < RateCeiling) {
+        RateCeiling = baud;
+    }
+}
+
+/******************************************************************************
+ * @brief Handles a link rate request from the controller.
+ *
+ * @param baud: The rate proposed by the controller.
+ ******************************************************************************/
+void link_rate_handle_request(uint32_t baud) {
+    uint32_t current = usart_get_baud(USART_PORT_EXTERN);
+
+    // The controller's request replaces a switch still being retried
+    SwitchBaud = 0;
+    IsFallbackSwitch = false;
+
+    // Repeated at the new rate: the controller hears us, keep it
+    if (PendingBaud != 0 && baud == PendingBaud) {
+        xTimerStop(TimerID_Confirm, portMAX_DELAY);
+        PendingBaud = 0;
+        send_linkRate_message(baud);
+        return;
+    }
+
+    // The base rate is always accepted, it is where a fallback lands
+    if (baud != LINK_RATE_BASE_BAUD && !link_rate_supported(baud)) {
+        send_linkRate_message(current); // Refuse by echoing the rate we stay at
+        return;
+    }
+
+    send_linkRate_message(baud); // Echo at the old rate, then switch
+    if (baud != current) {
+        lane_flush(portMAX_DELAY); // The echo and everything queued before it
+        PreviousBaud = current;
+        PendingBaud = (baud == LINK_RATE_BASE_BAUD) ? 0 : baud;
+        usart_set_baud(USART_PORT_EXTERN, baud, portMAX_DELAY);
+        if (PendingBaud != 0) {
+            xTimerReset(TimerID_Confirm, portMAX_DELAY);
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Returns the number of automatic fallbacks since reset.
+ ******************************************************************************/
+uint32_t link_rate_fallbacks(void) {
+    return FallbackCount;
+}
@@ -0,0 +1,311 @@
+/*
+ * Comm_Reliable.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include "User/L2/Comm_Datalink.h" // Header for communication functionalities
+#include "User/L2/Comm_Reliable.h" // Header for reliable delivery
+
+//Required FreeRTOS header files
+#include "FreeRTOS.h"
+#include "timers.h"
+#include "semphr.h"
+
+// A data frame the platform has sent but the controller has not acknowledged.
+// Slots are indexed by sequence number modulo RELIABLE_WINDOW_MAX.
+struct ReliableSlot {
+    uint8_t sensorType;
+    uint16_t data;
+    uint32_t sample_tick; // When the reading was taken, resent unchanged
+    uint32_t sent_order; // Value of SendOrder at the last transmission
+    TickType_t sent_tick;
+    uint8_t retries;
+    bool IsPending;
+};
+
+// A (re)transmission decided with WindowMutex held, sent once it is released
+struct ReliableSend {
+    uint8_t seq;
+    uint8_t sensorType;
+    uint16_t data;
+    uint32_t sample_tick;
+};
+
+static struct ReliableSlot Slots[RELIABLE_WINDOW_MAX];
+// Taken by the sensor timers, the retransmit timer and ack handling. Nothing
+// is sent while it is held, so it is never held across a wait for the lanes.
+static SemaphoreHandle_t WindowMutex;
+static TimerHandle_t TimerID_Retransmit;
+static volatile uint8_t Window = 0; // Negotiated window, 0 when reliable mode is off
+static uint8_t BaseSeq = 0, NextSeq = 0; // Platform: oldest unacknowledged and next new sequence number
+static uint32_t SendOrder = 0;      // Platform: counts transmissions, orders first sends and resends alike
+static uint8_t ExpectedSeq = 0;     // Controller: first sequence number not received
+static uint16_t Received = 0;       // Controller: bit i set if ExpectedSeq + i arrived
+static struct ReliableStats Stats;
+
+/******************************************************************************
+ * @brief Records a (re)transmission of a window slot and copies out what to
+ * send. Called with WindowMutex held.
+ ******************************************************************************/
+static void reliable_transmit(uint8_t seq, struct ReliableSend* send) {
+    struct ReliableSlot* slot = &Slots[seq % RELIABLE_WINDOW_MAX];
+
+    slot->sent_order = ++SendOrder;
+    slot->sent_tick = xTaskGetTickCount();
+    send->seq = seq;
+    send->sensorType = slot->sensorType;
+    send->data = slot->data;
+    send->sample_tick = slot->sample_tick;
+}
+
+/******************************************************************************
+ * @brief Resends a frame, or gives it up once it has used all its retries.
+ * Called with WindowMutex held.
+ *
+ * @return True if send was filled in.
+ ******************************************************************************/
+static bool reliable_retransmit(uint8_t seq, struct ReliableSend* send) {
+    struct ReliableSlot* slot = &Slots[seq % RELIABLE_WINDOW_MAX];
+
+    if (slot->retries >= RELIABLE_MAX_RETRIES) {
+        slot->IsPending = false;
+        Stats.given_up++;
+        return false;
+    }
+    slot->retries++;
+    Stats.retransmits++;
+    reliable_transmit(seq, send);
+    return true;
+}
+
+/******************************************************************************
+ * @brief Puts frames decided under WindowMutex on the wire. Called after it
+ * is released.
+ ******************************************************************************/
+static void reliable_send(const struct ReliableSend* sends, uint8_t count) {
+    for (uint8_t idx = 0; idx < count; idx++) {
+        send_sensorDataSeq_message(sends[idx].sensorType, sends[idx].data, sends[idx].seq, sends[idx].sample_tick);
+    }
+}
+
+/******************************************************************************
+ * @brief Moves the start of the window past frames that need nothing more.
+ * Called with WindowMutex held.
+ ******************************************************************************/
+static void reliable_advance(void) {
+    while (BaseSeq != NextSeq && !Slots[BaseSeq % RELIABLE_WINDOW_MAX].IsPending) {
+        BaseSeq++;
+    }
+}
+
+/******************************************************************************
+ * @brief Timer callback: resends frames that have waited RELIABLE_RTO_MS for
+ * an acknowledgment.
+ ******************************************************************************/
+static void reliable_retransmit_expired(TimerHandle_t xTimer) {
+    static struct ReliableSend sends[RELIABLE_WINDOW_MAX]; // Off the timer task stack, the only caller
+    TickType_t now = xTaskGetTickCount();
+    uint8_t count = 0;
+
+    xSemaphoreTake(WindowMutex, portMAX_DELAY);
+    for (uint8_t seq = BaseSeq; seq != NextSeq; seq++) {
+        struct ReliableSlot* slot = &Slots[seq % RELIABLE_WINDOW_MAX];
+        if (slot->IsPending && now - slot->sent_tick >= pdMS_TO_TICKS(RELIABLE_RTO_MS)
+                && reliable_retransmit(seq, &sends[count])) {
+            count++;
+        }
+    }
+    reliable_advance();
+    xSemaphoreGive(WindowMutex);
+
+    reliable_send(sends, count);
+}
+
+/******************************************************************************
+ * @brief Creates the retransmit timer and the window lock.
+ ******************************************************************************/
+void initialize_reliable(void) {
+    WindowMutex = xSemaphoreCreateMutex();
+    TimerID_Retransmit = xTimerCreate(
+        "Reliable Retransmit",
+        pdMS_TO_TICKS(RELIABLE_RTO_MS / 2),
+        pdTRUE,     // Autoreload: runs while reliable mode is on
+        (void*)0,
+        reliable_retransmit_expired
+        );
+}
+
+bool reliable_is_active(void) {
+    return Window != 0;
+}
+
+/******************************************************************************
+ * @brief Controller side: forgets what was received before and expects
+ * sequence number 0 next, as the platform restarts numbering when it answers.
+ ******************************************************************************/
+void reliable_start(uint8_t window) {
+    ExpectedSeq = 0;
+    Received = 0;
+    Window = window;
+    Stats.window = window;
+}
+
+/******************************************************************************
+ * @brief Platform side of the handshake. Reliable mode needs the sequence
+ * number field, which only binary frames have.
+ ******************************************************************************/
+void reliable_handle_request(uint16_t window) {
+    if (comm_framing_is_ascii(get_sensor_framing())) {
+        window = 0;
+    } else if (window > RELIABLE_WINDOW_MAX) {
+        window = RELIABLE_WINDOW_MAX;
+    }
+
+    xSemaphoreTake(WindowMutex, portMAX_DELAY);
+    for (int idx = 0; idx < RELIABLE_WINDOW_MAX; idx++) {
+        Slots[idx].IsPending = false;
+    }
+    BaseSeq = NextSeq = 0;
+    Window = window;
+    Stats.window = window;
+    xSemaphoreGive(WindowMutex);
+
+    if (window != 0) {
+        xTimerStart(TimerID_Retransmit, portMAX_DELAY);
+    } else {
+        xTimerStop(TimerID_Retransmit, portMAX_DELAY);
+    }
+    send_reliable_message(window);
+}
+
+/******************************************************************************
+ * @brief Platform side: numbers a reading and sends it. Runs in the sensor
+ * timer callbacks, so a full window drops the reading rather than waiting.
+ * The window lock is only ever held for bookkeeping, never across a send, so
+ * taking it here waits at most for another task's few loads and stores.
+ ******************************************************************************/
+void reliable_send_data(enum SensorId_t sensorType, uint16_t data) {
+    struct ReliableSlot* slot;
+    struct ReliableSend send;
+
+    xSemaphoreTake(WindowMutex, portMAX_DELAY);
+    if ((uint8_t)(NextSeq - BaseSeq) >= Window) {
+        Stats.window_full++;
+        xSemaphoreGive(WindowMutex);
+        return;
+    }
+
+    slot = &Slots[NextSeq % RELIABLE_WINDOW_MAX];
+    slot->sensorType = sensorType;
+    slot->data = data;
+    slot->sample_tick = xTaskGetTickCount();
+    slot->retries = 0;
+    slot->IsPending = true;
+    reliable_transmit(NextSeq++, &send);
+    Stats.sent++;
+    xSemaphoreGive(WindowMutex);
+
+    reliable_send(&send, 1);
+}
+
+/******************************************************************************
+ * @brief Platform side: frees everything before the cumulative point and
+ * every frame selectively acknowledged after it. A pending frame last sent
+ * before the newest acknowledged one was lost on the way, so it is resent now
+ * instead of waiting for the timer.
+ ******************************************************************************/
+void reliable_handle_ack(const struct CommMessage* ack) {
+    static struct ReliableSend sends[RELIABLE_WINDOW_MAX]; // Off the RX task stack, the only caller
+    uint8_t in_flight, seq, count = 0;
+    uint32_t newest_order = 0;
+
+    if (!ack->HasSeq) {
+        return;
+    }
+
+    xSemaphoreTake(WindowMutex, portMAX_DELAY);
+    in_flight = NextSeq - BaseSeq;
+    if ((uint8_t)(ack->seq - BaseSeq) <= in_flight) {
+        for (seq = BaseSeq; seq != ack->seq; seq++) {
+            Slots[seq % RELIABLE_WINDOW_MAX].IsPending = false;
+        }
+    } else if ((uint8_t)(BaseSeq - ack->seq) >= RELIABLE_WINDOW_MAX) {
+        xSemaphoreGive(WindowMutex); // Refers to nothing still in the window
+        return;
+    }
+    // Otherwise the controller is still waiting for a frame given up here; its
+    // selective part is still good
+
+    for (int bit = 1; bit < RELIABLE_WINDOW_MAX; bit++) {
+        struct ReliableSlot* slot;
+        seq = ack->seq + bit;
+        if ((uint8_t)(seq - BaseSeq) >= in_flight) {
+            continue;
+        }
+        slot = &Slots[seq % RELIABLE_WINDOW_MAX];
+        if ((ack->params & (1 << bit)) && slot->IsPending) {
+            slot->IsPending = false;
+            if (slot->sent_order > newest_order) {
+                newest_order = slot->sent_order;
+            }
+        }
+    }
+    for (seq = BaseSeq; seq != NextSeq; seq++) {
+        struct ReliableSlot* slot = &Slots[seq % RELIABLE_WINDOW_MAX];
+        if (slot->IsPending && slot->sent_order < newest_order && reliable_retransmit(seq, &sends[count])) {
+            count++;
+        }
+    }
+    reliable_advance();
+    xSemaphoreGive(WindowMutex);
+
+    reliable_send(sends, count);
+}
+
+/******************************************************************************
+ * @brief Controller side: marks the frame received, slides the receive
+ * window over the frames that are now contiguous and acknowledges. Every
+ * frame is acknowledged, including duplicates, as their ack may have been lost.
+ ******************************************************************************/
+bool reliable_receive(const struct CommMessage* message) {
+    uint8_t offset = message->seq - ExpectedSeq;
+    bool IsNew;
+
+    if (offset < RELIABLE_WINDOW_MAX) {
+        IsNew = (Received & (1 << offset)) == 0;
+        Received |= 1 << offset;
+    } else if (offset < 128) {
+        // Past what can be tracked: the platform gave up on the oldest frames
+        while (offset >= RELIABLE_WINDOW_MAX) {
+            if ((Received & 1) == 0) {
+                Stats.skipped++;
+            }
+            Received >>= 1;
+            ExpectedSeq++;
+            offset--;
+        }
+        Received |= 1 << offset;
+        IsNew = true;
+    } else {
+        IsNew = false; // Before ExpectedSeq, already delivered
+    }
+
+    while (Received & 1) {
+        Received >>= 1;
+        ExpectedSeq++;
+    }
+
+    if (IsNew) {
+        Stats.delivered++;
+    } else {
+        Stats.duplicates++;
+    }
+    send_reliableAck_message(ExpectedSeq, Received);
+    return IsNew;
+}
+
+void get_reliable_stats(struct ReliableStats* stats) {
+    *stats = Stats;
+}
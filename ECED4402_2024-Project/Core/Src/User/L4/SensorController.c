@@ -10,19 +10,42 @@
 #include <stdio.h>
 
 #include "main.h"
+#include "User/L1/USART_Driver.h"
 #include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Binary.h"
+#include "User/L2/Comm_LinkRate.h"
+#include "User/L2/Comm_Reliable.h"
+#include "User/L2/Comm_Clock.h"
+#include "User/L2/Comm_Delta.h"
+#include "User/L2/Comm_Batch.h"
+#include "User/L2/Comm_Bus.h"
+#include "User/L2/Comm_Lanes.h"
 #include "User/L3/TurbiditySensor.h"
 #include "User/L3/MicroplasticSensor.h"
 #include "User/L3/DOLevelSensor.h"
 #include "User/L4/SensorPlatform.h"
 #include "User/L4/SensorController.h"
 #include "User/util.h"
+#include "User/format.h"
+#include "User/latency.h"
 
 //Required FreeRTOS header files
 #include "FreeRTOS.h"
 #include "Timers.h"
 #include "semphr.h"
 
+#define SENSOR_DEFAULT_PERIOD_MS 1000  // Sampling period of a sensor until changed by PERIOD
+#define SENSOR_MIN_PERIOD_MS     10
+#define SENSOR_MAX_PERIOD_MS     60000
+#define SENSOR_IDLE_POLL_MS      100   // Longest Parsing_S waits for a reading before checking for commands
+#define RECENT_READINGS_LENGTH   32    // Readings kept for DUMP
+#define HOSTPC_QUEUE_LENGTH      16    // Host PC commands waiting for the controller
+
+// Queue depths: all queues come from the 15 KB FreeRTOS heap (heap_1)
+#define SENSOR_QUEUE_LENGTH      (BUS_HOLD_MAX + 8) // Frames from the platform: a whole bus turn or batch, plus replies
+#define SCALED_QUEUE_LENGTH      16    // Readings waiting for CompressionTask
+#define LED_QUEUE_LENGTH         4     // LED updates, one per three readings
+
 QueueHandle_t Queue_Sensor_Data;
 QueueHandle_t Queue_HostPC_Data;
 QueueHandle_t Queue_Scaled_Data;
@@ -31,121 +54,604 @@ QueueHandle_t Queue_LED_Data;
 
 static enum ControllerState ControlState = Init_S; // Initialize to the starting state
 
+static struct LatencyHistogram LatencyHistograms[COMM_NODE_COUNT]; // Sample to LED update, per sensor
+
+static struct CommParser SensorParser; // USART6 frames, parsed in SensorPlatform_RX_Task
+
+static uint16_t SensorPeriods[COMM_NODE_COUNT]; // Sampling period of each sensor in ms, set by PERIOD
+static bool SensorDisabled[COMM_NODE_COUNT];    // Set by DISABLE, kept across RESET
+
+// The last readings passed on to the LEDs, for DUMP
+struct ReadingRecord {
+	uint8_t address;
+	enum SensorId_t sensorID;
+	uint16_t data;
+	uint32_t sample_tick;
+};
+static struct ReadingRecord RecentReadings[RECENT_READINGS_LENGTH];
+static uint32_t RecentReadingsCount = 0; // Readings recorded since power up; the newest is at (count - 1) % length
+
+
+
+
+/******************************************************************************
+Waits for the platform being talked to to answer a controller request.
+Returns false if no answer with that message ID arrives within timeout_ms of
+the last frame received.
+******************************************************************************/
+static bool wait_node_reply(enum CommMessageId messageId, struct CommMessage* reply, uint32_t timeout_ms){
+
+	while (xQueueReceive(Queue_Sensor_Data, reply, pdMS_TO_TICKS(timeout_ms)) == pdPASS) {
+		if (reply->address == comm_get_address() && reply->SensorID == Controller && reply->messageId == messageId) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool wait_control_reply(enum CommMessageId messageId, struct CommMessage* reply){
+
+	return wait_node_reply(messageId, reply, LINK_RATE_VERIFY_MS);
+}
+
+/******************************************************************************
+Waits for the platform to echo a controller request. Returns true only if the
+echo carries the requested params; different params mean it was refused.
+******************************************************************************/
+static bool wait_control_echo(enum CommMessageId messageId, uint16_t params){
+
+	struct CommMessage reply;
+
+	return wait_control_reply(messageId, &reply) && reply.params == params;
+}
+
+/******************************************************************************
+Moves USART6 to baud. The step is echoed at the old rate, then repeated and
+echoed again at the new one; a step that fails the second echo is undone on
+both sides and never tried again. Returns false if the link stayed where it was.
+******************************************************************************/
+static bool step_link_rate(uint32_t baud){
+
+	uint32_t previous = usart_get_baud(USART_PORT_EXTERN);
+
+	send_linkRate_message(baud);
+	if (!wait_control_echo(COMM_MSG_LINK_RATE, baud / 100)) {
+		return false; // Refused or not answered, stay at the current rate
+	}
+
+	usart_set_baud(USART_PORT_EXTERN, baud, portMAX_DELAY);
+	send_linkRate_message(baud);
+	if (!wait_control_echo(COMM_MSG_LINK_RATE, baud / 100)) {
+		link_rate_limit(baud);
+		usart_set_baud(USART_PORT_EXTERN, previous, portMAX_DELAY);
+		vTaskDelay(pdMS_TO_TICKS(LINK_RATE_CONFIRM_MS)); // Let the platform revert too
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************
+Reports the rate of USART6 to the Host PC.
+******************************************************************************/
+static void print_link_rate(){
+
+	char str[50], *pos;
+
+	pos = fmt_str(str, "Sensor link at ");
+	pos = fmt_u32(pos, usart_get_baud(USART_PORT_EXTERN));
+	fmt_end(fmt_str(pos, " baud.\r\n"));
+	print_str(str);
+}
+
+/******************************************************************************
+Steps USART6 up through the candidate rates until one fails.
+The rate reached is reported to the Host PC.
+******************************************************************************/
+static void negotiate_link_rate(){
+
+	uint32_t baud;
+
+	while ((baud = link_rate_next(usart_get_baud(USART_PORT_EXTERN))) != 0) {
+		if (!step_link_rate(baud)) {
+			break;
+		}
+	}
+	print_link_rate();
+}
+
+/******************************************************************************
+Asks the platform for the preferred framing. The platform answers in the old
+framing with the one it switches to; no answer means older firmware, which
+only speaks ASCII.
+******************************************************************************/
+static enum CommFraming request_framing(){
+
+	struct CommMessage reply;
+
+	send_framing_message(COMM_PREFERRED_FRAMING);
+	if (wait_control_reply(COMM_MSG_FRAMING, &reply) && reply.params <= COMM_PREFERRED_FRAMING) {
+		return reply.params;
+	}
+	return COMM_FRAMING_ASCII;
+}
+
+/******************************************************************************
+Reports the framing in use to the Host PC.
+******************************************************************************/
+static void print_framing(){
+
+	switch (get_sensor_framing()) {
+		case COMM_FRAMING_BINARY_CRC32:
+			print_str("Sensor link framing: binary, CRC-32.\r\n");
+			break;
+		case COMM_FRAMING_BINARY:
+			print_str("Sensor link framing: binary, CRC-16.\r\n");
+			break;
+		case COMM_FRAMING_ASCII_SHORT:
+			print_str("Sensor link framing: ASCII, short headers.\r\n");
+			break;
+		default:
+			print_str("Sensor link framing: ASCII.\r\n");
+			break;
+	}
+}
+
+static void negotiate_framing(){
+
+	set_sensor_framing(request_framing());
+	print_framing();
+}
+
+/******************************************************************************
+Turns on reliable delivery when the link is binary: the platform answers with
+the window it accepts, 0 or no answer leaves it off.
+******************************************************************************/
+static void negotiate_reliable(){
+
+	struct CommMessage reply;
+	uint8_t window = 0;
+	char str[50];
+
+	if (RELIABLE_WINDOW != 0 && !comm_framing_is_ascii(get_sensor_framing())) {
+		send_reliable_message(RELIABLE_WINDOW);
+		if (wait_control_reply(COMM_MSG_RELIABLE, &reply) && reply.params <= RELIABLE_WINDOW) {
+			window = reply.params;
+		}
+	}
+	reliable_start(window);
+
+	if (window != 0) {
+		fmt_end(fmt_str(fmt_u32(fmt_str(str, "Sensor link reliable, window "), window), ".\r\n"));
+		print_str(str);
+	} else {
+		print_str("Sensor link reliable mode off.\r\n");
+	}
+}
+
+/******************************************************************************
+Turns on delta compression of sensor data when the link is binary and not
+reliable: the platform answers with the keyframe interval it accepts, 0 or no
+answer leaves it off.
+******************************************************************************/
+static void negotiate_compression(){
+
+	struct CommMessage reply;
+	uint8_t interval = 0;
+	char str[50];
+
+	if (DELTA_KEYFRAME_INTERVAL != 0 && !comm_framing_is_ascii(get_sensor_framing()) && !reliable_is_active()) {
+		send_compression_message(DELTA_KEYFRAME_INTERVAL);
+		if (wait_control_reply(COMM_MSG_COMPRESSION, &reply) && reply.params <= DELTA_KEYFRAME_INTERVAL) {
+			interval = reply.params;
+		}
+	}
+	delta_start(interval);
+
+	if (interval != 0) {
+		fmt_end(fmt_str(fmt_u32(fmt_str(str, "Sensor data delta coded, keyframe every "), interval), ".\r\n"));
+		print_str(str);
+	} else {
+		print_str("Sensor data compression off.\r\n");
+	}
+}
+
+/******************************************************************************
+Turns on batching of sensor data when the link is binary and not reliable:
+the platform answers with the limits it accepts, 0 or no answer leaves it off.
+******************************************************************************/
+static void negotiate_batching(){
+
+	struct CommMessage reply;
+	uint16_t params = 0;
+	char str[60], *pos;
+
+	if (BATCH_MAX_COUNT > 1 && !comm_framing_is_ascii(get_sensor_framing()) && !reliable_is_active()) {
+		send_batch_message(BATCH_PARAMS(BATCH_MAX_COUNT, BATCH_MAX_DELAY_MS));
+		if (wait_control_reply(COMM_MSG_BATCH_CONFIG, &reply) && BATCH_PARAMS_COUNT(reply.params) <= BATCH_MAX_COUNT) {
+			params = reply.params;
+		}
+	}
+	batch_start(params);
+
+	if (BATCH_PARAMS_COUNT(params) != 0) {
+		pos = fmt_u32(fmt_str(str, "Sensor data batched, up to "), BATCH_PARAMS_COUNT(params));
+		pos = fmt_u32(fmt_str(pos, " readings or "), BATCH_PARAMS_DELAY_MS(params));
+		fmt_end(fmt_str(pos, " ms.\r\n"));
+		print_str(str);
+	} else {
+		print_str("Sensor data batching off.\r\n");
+	}
+}
+
+/******************************************************************************
+Writes a sensor's name, followed on a bus by the address of its platform.
+******************************************************************************/
+static char* fmt_sensor(char* out, uint8_t address, enum SensorId_t sensor){
+
+	out = fmt_str(out, comm_sensor_name(sensor));
+	if (address != COMM_ADDRESS_NONE){
+		out = fmt_u32(fmt_str(out, "@"), address);
+	}
+	return out;
+}
+
+/******************************************************************************
+Prints a sensor's name followed by text to the Host PC.
+******************************************************************************/
+static void print_sensor_str(uint8_t address, enum SensorId_t sensor, const char* text){
+
+	char str[50];
+
+	fmt_end(fmt_str(fmt_sensor(str, address, sensor), text));
+	print_str(str);
+}
+
+/******************************************************************************
+Waits for a sensor of the platform being talked to to acknowledge its enable.
+******************************************************************************/
+static bool wait_sensor_ack(enum SensorId_t sensor, TickType_t timeout){
+
+	struct CommMessage reply;
+
+	while (xQueueReceive(Queue_Sensor_Data, &reply, timeout) == pdPASS) {
+		if (reply.address == comm_get_address() && reply.SensorID == sensor && reply.messageId == COMM_MSG_ACK) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/******************************************************************************
+Sends a sensor of the platform being talked to its period, 0 to disable it,
+and waits for the acknowledgment. One at a time, so on a bus the platform
+never answers while the controller is still sending.
+******************************************************************************/
+static bool set_sensor_period(enum SensorId_t sensor, uint16_t period, TickType_t timeout){
+
+	send_sensorEnable_message(sensor, period);
+	return wait_sensor_ack(sensor, timeout);
+}
+
+/******************************************************************************
+Enables the sensors in the sensors mask that are not disabled, each with its
+period, on the platform being talked to.
+******************************************************************************/
+static void enable_sensors(uint16_t sensors, TickType_t timeout){
+
+	for (enum SensorId_t sensor = Controller + 1; comm_is_sensor(sensor); sensor++){
+		if ((sensors & (1u << sensor)) && !SensorDisabled[sensor]){
+			if (set_sensor_period(sensor, SensorPeriods[sensor], timeout)){
+				print_sensor_str(comm_get_address(), sensor, " sensor enabled.\r\n");
+			} else {
+				print_sensor_str(comm_get_address(), sensor, " sensor did not answer.\r\n");
+			}
+		}
+	}
+}
+
+/******************************************************************************
+Sends a new period, or 0 to disable, to every platform with the sensor. On a
+point-to-point link the acknowledgment is dropped with the other control
+frames in Parsing_S; on a bus each platform must answer before the next is
+addressed.
+******************************************************************************/
+static void update_sensor_period(enum SensorId_t sensor, uint16_t period){
+
+	if (COMM_BUS_MAX_ADDRESS == 0){
+		send_sensorEnable_message(sensor, period);
+		return;
+	}
+	for (uint8_t idx = 0; idx < bus_node_count(); idx++){
+		struct BusNode* node = bus_node(idx);
+		if (node->sensors & (1u << sensor)){
+			comm_set_address(node->address);
+			set_sensor_period(sensor, period, pdMS_TO_TICKS(BUS_REPLY_TIMEOUT_MS));
+		}
+	}
+}
+
+/******************************************************************************
+Finds the platforms on the bus by asking every address in turn.
+******************************************************************************/
+static void discover_bus(){
+
+	struct CommMessage reply;
+	char str[50];
+
+	bus_clear();
+	for (uint16_t address = 1; address <= COMM_BUS_MAX_ADDRESS; address++){
+		comm_set_address(address);
+		send_discover_message(0);
+		if (wait_node_reply(COMM_MSG_DISCOVER, &reply, BUS_REPLY_TIMEOUT_MS) && !bus_add_node(address, reply.params)){
+			break; // Registry full
+		}
+	}
+
+	fmt_end(fmt_str(fmt_u32(fmt_str(str, "Sensor bus: "), bus_node_count()), " platforms found.\r\n"));
+	print_str(str);
+}
+
+/******************************************************************************
+Starts every platform on a shared bus. The link rate is the bus's and is not
+negotiated, and reliable delivery, compression, batching and clock offsets
+are per link state that the platforms would share, so they stay off; polling
+already sends a platform's readings together. The framing is the best one
+every platform accepts.
+******************************************************************************/
+static void start_bus(){
+
+	enum CommFraming framing = COMM_PREFERRED_FRAMING, accepted;
 
-static void ResetMessageStruct(struct CommMessage* currentRxMessage){
+	discover_bus();
 
-	static const struct CommMessage EmptyMessage = {0};
-	*currentRxMessage = EmptyMessage;
+	for (uint8_t idx = 0; idx < bus_node_count(); idx++){
+		comm_set_address(bus_node(idx)->address);
+		accepted = request_framing();
+		if (accepted < framing){
+			framing = accepted;
+		}
+	}
+	set_sensor_framing(bus_node_count() != 0 ? framing : COMM_FRAMING_ASCII);
+	print_link_rate();
+	print_framing();
+
+	for (uint8_t idx = 0; idx < bus_node_count(); idx++){
+		comm_set_address(bus_node(idx)->address);
+		enable_sensors(bus_node(idx)->sensors, pdMS_TO_TICKS(BUS_REPLY_TIMEOUT_MS));
+	}
 }
 
+/******************************************************************************
+Resets every platform on the bus, and reports how many acknowledged.
+******************************************************************************/
+static void reset_bus(){
 
+	struct CommMessage reply;
+	uint8_t acked = 0;
+	char str[60], *pos;
 
+	for (uint8_t idx = 0; idx < bus_node_count(); idx++){
+		comm_set_address(bus_node(idx)->address);
+		send_sensorReset_message();
+		if (wait_node_reply(COMM_MSG_ACK, &reply, BUS_REPLY_TIMEOUT_MS)){
+			acked++;
+		}
+	}
+
+	pos = fmt_u32(fmt_str(str, "Reset acknowledged by "), acked);
+	pos = fmt_u32(fmt_str(pos, " of "), bus_node_count());
+	fmt_end(fmt_str(pos, " platforms.\r\n"));
+	print_str(str);
+}
+
+/******************************************************************************
+Applies a PERIOD, ENABLE, DISABLE or RATE command from the Host PC. The
+settings are kept for the next START; while running they are also sent to
+the platform at once, whose acknowledgement is dropped with the other
+control frames in Parsing_S.
+******************************************************************************/
+static void apply_host_command(const struct HostPCCommand* command){
+
+	bool IsRunning = (ControlState == Parsing_S);
+	char str[50], *pos;
+
+	switch (command->command) {
+		case PC_Command_PERIOD:
+			if (command->value < SENSOR_MIN_PERIOD_MS || command->value > SENSOR_MAX_PERIOD_MS) {
+				pos = fmt_u32(fmt_str(str, "Period must be "), SENSOR_MIN_PERIOD_MS);
+				pos = fmt_u32(fmt_str(pos, " to "), SENSOR_MAX_PERIOD_MS);
+				fmt_end(fmt_str(pos, " ms.\r\n"));
+				print_str(str);
+				break;
+			}
+			SensorPeriods[command->sensor] = command->value;
+			if (IsRunning && !SensorDisabled[command->sensor]) {
+				update_sensor_period(command->sensor, SensorPeriods[command->sensor]);
+			}
+			pos = fmt_str(fmt_str(str, comm_sensor_name(command->sensor)), " period ");
+			fmt_end(fmt_str(fmt_u32(pos, command->value), " ms.\r\n"));
+			print_str(str);
+			break;
+
+		case PC_Command_ENABLE:
+		case PC_Command_DISABLE:
+			SensorDisabled[command->sensor] = (command->command == PC_Command_DISABLE);
+			if (IsRunning) {
+				update_sensor_period(command->sensor, SensorDisabled[command->sensor] ? 0 : SensorPeriods[command->sensor]);
+			}
+			print_sensor_str(COMM_ADDRESS_NONE, command->sensor, SensorDisabled[command->sensor] ? " sensor disabled.\r\n" : " sensor enabled.\r\n");
+			break;
+
+		case PC_Command_RATE:
+			if (COMM_BUS_MAX_ADDRESS != 0) {
+				print_str("The rate of a shared bus is fixed.\r\n");
+			} else if (!IsRunning) {
+				print_str("Sensor link not started.\r\n");
+			} else if (command->value != usart_get_baud(USART_PORT_EXTERN) && link_rate_next(command->value - 1) != command->value) {
+				print_str("Rate not supported.\r\n");
+			} else if (command->value != usart_get_baud(USART_PORT_EXTERN) && !step_link_rate(command->value)) {
+				print_str("Rate change failed.\r\n");
+			}
+			print_link_rate();
+			break;
+
+		default:
+			break;
+	}
+}
+
+/******************************************************************************
+Passes a reading on to the LEDs and keeps it for DUMP. Returns false for
+frames that are not readings.
+******************************************************************************/
+static bool handle_reading(const struct CommMessage* message){
+
+	static ScaledData data_s;
+	struct ReadingRecord* record = &RecentReadings[RecentReadingsCount % RECENT_READINGS_LENGTH];
+
+	if (!comm_is_sensor(message->SensorID) || message->messageId != COMM_MSG_DATA) {
+		return false;
+	}
+	data_s.sensorID = message->SensorID;
+	data_s.data = message->params;
+	data_s.sample_tick = message->timestamp;
+
+	taskENTER_CRITICAL();
+	record->address = message->address;
+	record->sensorID = data_s.sensorID;
+	record->data = data_s.data;
+	record->sample_tick = data_s.sample_tick;
+	RecentReadingsCount++;
+	taskEXIT_CRITICAL();
+
+	xQueueSendToBack(Queue_Scaled_Data, &data_s, 0);
+	return true;
+}
+
+/******************************************************************************
+Gives every platform on the bus its turn: it is polled, sends what it holds
+and ends its turn, and only then is the next one addressed.
+******************************************************************************/
+static void poll_bus(){
+
+	struct CommMessage message;
+
+	for (uint8_t idx = 0; idx < bus_node_count(); idx++){
+		struct BusNode* node = bus_node(idx);
+
+		comm_set_address(node->address);
+		send_poll_message(0);
+		node->polls++;
+		while (1) {
+			if (xQueueReceive(Queue_Sensor_Data, &message, pdMS_TO_TICKS(BUS_REPLY_TIMEOUT_MS)) != pdPASS) {
+				node->timeouts++;
+				break;
+			}
+			if (message.address != node->address) {
+				continue;
+			}
+			if (message.SensorID == Controller && message.messageId == COMM_MSG_POLL) {
+				node->dropped += BUS_TURN_DROPPED(message.params);
+				break; // End of its turn
+			}
+			if (handle_reading(&message)) {
+				node->readings++;
+			}
+		}
+	}
+}
 
 /******************************************************************************
 This task is created from the main.
 ******************************************************************************/
 void SensorControllerTask(void *params) {
-	static ScaledData data_s;
     struct CommMessage receivedRxMessage;       // Message from the Sensor Platform
-    enum HostPCCommands HostPCInstruction;     // Command from the Host PC
-    uint8_t TurbidityAck = 0, MicroplasticAck = 0, DOLevelAck = 0;     // Acknowledgment flags for sensors
+    struct HostPCCommand HostPCInstruction;     // Command from the Host PC
+    TickType_t LastPollRound = 0;               // Start of the last poll round on a bus
+
+    for (enum SensorId_t sensor = Controller + 1; comm_is_sensor(sensor); sensor++) {
+        SensorPeriods[sensor] = SENSOR_DEFAULT_PERIOD_MS;
+    }
 
     while (1) {
         switch (ControlState) {
             case Init_S:
-                // Wait for a START command from the Host PC
+                // Wait for a START command from the Host PC, applying settings until then
                 if (xQueueReceive(Queue_HostPC_Data, &HostPCInstruction, portMAX_DELAY) == pdPASS) {
-                    if (HostPCInstruction == PC_Command_START) {
+                    if (HostPCInstruction.command == PC_Command_START) {
                         // Transition to Start state
                         print_str("Start command received from Host PC.\r\n");
                         ControlState = Start_S;
+                    } else {
+                        apply_host_command(&HostPCInstruction);
                     }
                 }
                 break;
 
             case Start_S:
-                // Send enable commands to sensors
-                send_sensorEnable_message(Turbidity, 1000);
-                send_sensorEnable_message(Microplastic, 1000);
-                send_sensorEnable_message(DOLevel, 1000);
-
-                // Wait for acknowledgments from both sensors
-                while (!(TurbidityAck && MicroplasticAck && DOLevelAck)) {
-                    if (xQueueReceive(Queue_Sensor_Data, &receivedRxMessage, portMAX_DELAY) == pdPASS) {
-                        if (receivedRxMessage.SensorID == Turbidity && receivedRxMessage.messageId == 01) {
-                            print_str("Turbidity sensor enabled.\r\n");
-                            TurbidityAck = 1;
-                        } else if (receivedRxMessage.SensorID == Microplastic && receivedRxMessage.messageId == 01) {
-                            print_str("Microplastic sensor enabled.\r\n");
-                            MicroplasticAck = 1;
-                        } else if (receivedRxMessage.SensorID == DOLevel && receivedRxMessage.messageId == 01) {
-                            print_str("DOLevel sensor enabled.\r\n");
-                            DOLevelAck = 1;
-                        }
-                    }
+                if (COMM_BUS_MAX_ADDRESS != 0) {
+                    start_bus(); // Find the platforms, then enable their sensors
+                    LastPollRound = xTaskGetTickCount();
+                    ControlState = Parsing_S;
+                    break;
                 }
 
-                // Transition to Parsing state once both sensors are acknowledged
+                // Move the sensor link to the fastest rate both sides handle
+                negotiate_link_rate();
+                negotiate_framing();
+                negotiate_reliable();
+                negotiate_compression();
+                negotiate_batching();
+                clock_sync_start(); // Timestamped readings need the platform clock offset
+
+                // Enable the sensors with their periods, waiting for each acknowledgment
+                enable_sensors(UINT16_MAX, portMAX_DELAY);
+
+                // Transition to Parsing state once the sensors are acknowledged
                 ControlState = Parsing_S;
                 break;
 
             case Parsing_S:
             	HAL_GPIO_WritePin(GPIOC, GPIO_PIN_3, GPIO_PIN_SET);
-                // Process sensor data
-                if (xQueueReceive(Queue_Sensor_Data, &receivedRxMessage, portMAX_DELAY) == pdPASS) {
-                    if (receivedRxMessage.SensorID == Turbidity && receivedRxMessage.messageId == 03) {
-//                        char Turbidity_data[50];
-//                        sprintf(Turbidity_data, "Turbidity Data: %ld\r\n", receivedRxMessage.params);
-//                        print_str(Turbidity_data);
-                        data_s.sensorID = Turbidity;
-                        data_s.data = receivedRxMessage.params;
-
-                    } else if (receivedRxMessage.SensorID == Microplastic && receivedRxMessage.messageId == 03) {
-//                        char Microplastic_data[50];
-//                        sprintf(Microplastic_data, "Microplastic Data: %ld\r\n", receivedRxMessage.params);
-//                        print_str(Microplastic_data);
-                        data_s.sensorID = Microplastic;
-                        data_s.data = receivedRxMessage.params;
-
-                    } else if (receivedRxMessage.SensorID == DOLevel && receivedRxMessage.messageId == 03) {
-//                        char DOLevel_data[50];
-//                        sprintf(DOLevel_data, "DOLevel Data: %ld\r\n", receivedRxMessage.params);
-//                        print_str(DOLevel_data);
-                        data_s.sensorID = DOLevel;
-                        data_s.data = receivedRxMessage.params;
-
-                    }
-
-                    xQueueSendToBack(Queue_Scaled_Data, &data_s, 0);
-
+                if (COMM_BUS_MAX_ADDRESS != 0) {
+                    // One turn for every platform, then wait for the next round
+                    poll_bus();
+                    vTaskDelayUntil(&LastPollRound, pdMS_TO_TICKS(BUS_POLL_INTERVAL_MS));
+                } else if (xQueueReceive(Queue_Sensor_Data, &receivedRxMessage, pdMS_TO_TICKS(SENSOR_IDLE_POLL_MS)) == pdPASS) {
+                    // Process sensor data; the timeout keeps Host PC commands
+                    // answered while every sensor is disabled
+                    handle_reading(&receivedRxMessage);
                 }
 
 
-                // Check for a RESET command from the Host PC
+                // Check for a RESET or a settings command from the Host PC
                 if (xQueueReceive(Queue_HostPC_Data, &HostPCInstruction, 0) == pdPASS) {
-                    if (HostPCInstruction == PC_Command_RESET) {
+                    if (HostPCInstruction.command == PC_Command_RESET) {
                         print_str("Reset command received from Host PC.\r\n");
                         ControlState = Reset_S;
+                    } else {
+                        apply_host_command(&HostPCInstruction);
                     }
                 }
                 break;
 
             case Reset_S:
 				disableLED();
+                if (COMM_BUS_MAX_ADDRESS != 0) {
+                    reset_bus();
+                    ControlState = Init_S;
+                    break;
+                }
+
                 // Send reset command to the Sensor Platform
                 send_sensorReset_message();
                 print_str("Sending reset command to Sensor Platform.\r\n");
 
                 // Wait for reset acknowledgment
                 if (xQueueReceive(Queue_Sensor_Data, &receivedRxMessage, portMAX_DELAY) == pdPASS) {
-                    if (receivedRxMessage.SensorID == Controller && receivedRxMessage.messageId == 01) {
+                    if (receivedRxMessage.SensorID == Controller && receivedRxMessage.messageId == COMM_MSG_ACK) {
                         print_str("Reset acknowledgment received.\r\n");
 
-                        // Reset flags
-                        TurbidityAck = 0;
-                        MicroplasticAck = 0;
-                        DOLevelAck = 0;
-
                         // Transition back to Init state
                         ControlState = Init_S;
                     }
@@ -158,8 +664,11 @@ void SensorControllerTask(void *params) {
                 break;
         }
 
-        // Add a small delay to prevent task starvation
-        vTaskDelay(100 / portTICK_RATE_MS);
+        // Add a small delay to prevent task starvation. Parsing_S blocks on
+        // its queue instead, so readings are taken as fast as they arrive.
+        if (ControlState != Parsing_S) {
+            vTaskDelay(100 / portTICK_RATE_MS);
+        }
     }
 }
 
@@ -167,28 +676,281 @@ void SensorControllerTask(void *params) {
 
 
 
+/******************************************************************************
+Hands a frame decoded by SensorPlatform_RX_Task to the Sensor Controller Task.
+******************************************************************************/
+static void queue_sensor_message(const struct CommMessage* message, void* context){
+
+	struct CommMessage local = *message;
+
+	// Time answers are used here, with as little delay as possible
+	if (message->SensorID == Controller && message->messageId == COMM_MSG_CLOCK){
+		clock_handle_reply(message);
+		return;
+	}
+
+	// Numbered data frames are acknowledged here; repeats are not passed on
+	if (message->HasSeq && message->messageId == COMM_MSG_DATA && !reliable_receive(message)){
+		return;
+	}
+
+	// From here on the timestamp is in controller ticks. Readings without one
+	// are stamped on arrival, so their latency starts at the controller.
+	if (message->HasTimestamp && clock_is_synchronised()){
+		local.timestamp = clock_to_local(message->timestamp);
+	} else {
+		local.timestamp = xTaskGetTickCount();
+	}
+	xQueueSendToBack(Queue_Sensor_Data, &local, 0);
+}
+
 /*
- * This task reads the queue of characters from the Sensor Platform when available
- * It then sends the processed data to the Sensor Controller Task
+ * This task reads the characters from the Sensor Platform when available,
+ * a whole span per read, and sends every frame found to the Sensor Controller Task
  */
 void SensorPlatform_RX_Task(){
-	struct CommMessage currentRxMessage = {0};
-	Queue_Sensor_Data = xQueueCreate(80, sizeof(struct CommMessage));
+	uint8_t span[COMM_PARSER_CHUNK_LENGTH];
+	uint16_t length;
+
+	Queue_Sensor_Data = xQueueCreate(SENSOR_QUEUE_LENGTH, sizeof(struct CommMessage));
+	configASSERT(Queue_Sensor_Data != NULL);
+	comm_parser_init(&SensorParser, USART_PORT_EXTERN);
 
 	request_sensor_read();  // requests a usart read (through the callback)
 
 	while(1){
-		parse_sensor_message(&currentRxMessage);
+		length = read_sensor_bytes(span, sizeof(span), portMAX_DELAY);
+		comm_parse_span(&SensorParser, span, length, queue_sensor_message, NULL);
+	}
+}
 
-		if(currentRxMessage.IsMessageReady == true && currentRxMessage.IsCheckSumValid == true){
 
-			xQueueSendToBack(Queue_Sensor_Data, &currentRxMessage, 0);
-			ResetMessageStruct(&currentRxMessage);
+
+/******************************************************************************
+Prints the link health counters of every UART to the Host PC.
+******************************************************************************/
+static void print_usart_stats(){
+
+	static const char* const Labels[] = {" rx=", " tx=", " ore=", " fe=", " ne=", " pe=",
+			" rxdrop=", " txdrop=", " peak=", " rearm=", " thr=", " paused=", " refused="};
+	static const char* const ReliableLabels[] = {" window=", " delivered=", " dup=", " skipped="};
+	static const char* const DeltaLabels[] = {" interval=", " key=", " delta=", " unresolved=", " resync="};
+	static const char* const BatchLabels[] = {" count=", " delay=", " frames=", " readings="};
+	static const char* const BusLabels[] = {" sensors=", " polls=", " timeouts=", " readings=", " dropped="};
+	static const char* const ParserLabels[] = {" resyncs=", " rejected=", " scanned="};
+	static const char* const LaneNames[COMM_LANE_COUNT] = {"lane control", "lane alarm", "lane telemetry"};
+	static const char* const LaneLabels[] = {" depth=", " peak=", " frames=", " waits=", " dropped=", " maxwait="};
+	// Static, HostPC_RX_Task is the only caller and its whole stack is 912 bytes
+	static struct UsartStats stats;
+	static struct ReliableStats reliable;
+	static struct DeltaStats delta;
+	static struct BatchStats batch;
+	static struct CommParserStats parser;
+	static struct LaneStats lane_stats;
+	static char str[180];
+	char *pos;
+
+	for (enum UsartPort port = 0; port < USART_PORT_COUNT; port++){
+		get_usart_stats(port, &stats);
+		const uint32_t values[] = {stats.bytes_rx, stats.bytes_tx, stats.overrun_errors,
+				stats.framing_errors, stats.noise_errors, stats.parity_errors,
+				stats.rx_dropped, stats.tx_dropped, stats.rx_peak_level, stats.rearm_failures,
+				stats.rx_throttles, stats.tx_pauses, stats.tx_refused};
+
+		pos = fmt_str(str, usart_port_name(port));
+		for (int idx = 0; idx < sizeof(values) / sizeof(values[0]); idx++){
+			pos = fmt_str(pos, Labels[idx]);
+			pos = fmt_u32(pos, values[idx]);
 		}
+		fmt_end(fmt_str(pos, "\r\n"));
+		print_str(str);
+	}
+
+	comm_parser_stats(&SensorParser, &parser);
+	const uint32_t parser_values[] = {parser.resyncs, parser.rejected, parser.scanned};
+	pos = fmt_str(str, "USART6 parser");
+	for (int idx = 0; idx < sizeof(parser_values) / sizeof(parser_values[0]); idx++){
+		pos = fmt_str(pos, ParserLabels[idx]);
+		pos = fmt_u32(pos, parser_values[idx]);
 	}
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+
+	pos = fmt_str(str, "USART6 link=");
+	pos = fmt_u32(pos, usart_get_baud(USART_PORT_EXTERN));
+	pos = fmt_str(pos, " baud fallbacks=");
+	pos = fmt_u32(pos, link_rate_fallbacks());
+	pos = fmt_str(pos, crc32_is_hardware() ? " crc32=unit" : " crc32=software");
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+
+	for (enum CommLane lane = COMM_LANE_CONTROL; lane < COMM_LANE_COUNT; lane++){
+		get_lane_stats(lane, &lane_stats);
+		const uint32_t lane_values[] = {lane_stats.depth, lane_stats.peak_depth, lane_stats.frames,
+				lane_stats.waits, lane_stats.dropped, lane_stats.max_wait_ms};
+
+		pos = fmt_str(str, LaneNames[lane]);
+		for (int idx = 0; idx < sizeof(lane_values) / sizeof(lane_values[0]); idx++){
+			pos = fmt_str(pos, LaneLabels[idx]);
+			pos = fmt_u32(pos, lane_values[idx]);
+		}
+		fmt_end(fmt_str(pos, "ms\r\n"));
+		print_str(str);
+	}
+
+	get_reliable_stats(&reliable);
+	const uint32_t reliable_values[] = {reliable.window, reliable.delivered, reliable.duplicates, reliable.skipped};
+	pos = fmt_str(str, "reliable");
+	for (int idx = 0; idx < sizeof(reliable_values) / sizeof(reliable_values[0]); idx++){
+		pos = fmt_str(pos, ReliableLabels[idx]);
+		pos = fmt_u32(pos, reliable_values[idx]);
+	}
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+
+	get_delta_stats(&delta);
+	const uint32_t delta_values[] = {delta.interval, delta.keyframes, delta.deltas, delta.unresolved, delta.resyncs};
+	pos = fmt_str(str, "delta");
+	for (int idx = 0; idx < sizeof(delta_values) / sizeof(delta_values[0]); idx++){
+		pos = fmt_str(pos, DeltaLabels[idx]);
+		pos = fmt_u32(pos, delta_values[idx]);
+	}
+	// Params and timestamp bytes as full values over bytes actually received
+	pos = fmt_str(pos, " ratio=");
+	pos = fmt_fixed(pos, delta.sent_bytes ? (uint64_t)delta.full_bytes * 100 / delta.sent_bytes : 100, 2, 2, 1);
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+
+	get_batch_stats(&batch);
+	const uint32_t batch_values[] = {batch.max_count, batch.max_delay_ms, batch.frames, batch.readings};
+	pos = fmt_str(str, "batch");
+	for (int idx = 0; idx < sizeof(batch_values) / sizeof(batch_values[0]); idx++){
+		pos = fmt_str(pos, BatchLabels[idx]);
+		pos = fmt_u32(pos, batch_values[idx]);
+	}
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+
+	// One line per platform on a shared bus
+	for (uint8_t node_idx = 0; node_idx < bus_node_count(); node_idx++){
+		const struct BusNode* node = bus_node(node_idx);
+		const uint32_t node_values[] = {node->sensors, node->polls, node->timeouts, node->readings, node->dropped};
+		pos = fmt_u32(fmt_str(str, "node@"), node->address);
+		for (int idx = 0; idx < sizeof(node_values) / sizeof(node_values[0]); idx++){
+			pos = fmt_str(pos, BusLabels[idx]);
+			pos = fmt_u32(pos, node_values[idx]);
+		}
+		fmt_end(fmt_str(pos, "\r\n"));
+		print_str(str);
+	}
+
+	// Least stack HostPC_RX_Task has had left, in words
+	pos = fmt_u32(fmt_str(str, "HostPC_RX_Task stack free="), uxTaskGetStackHighWaterMark(NULL));
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+}
+
+/******************************************************************************
+Prints the sample to LED latency distribution of each sensor to the Host PC.
+******************************************************************************/
+static void print_latency_stats(){
+
+	struct LatencyHistogram histogram;
+	char str[100], *pos;
+
+	for (enum SensorId_t sensor = Controller + 1; comm_is_sensor(sensor); sensor++){
+		taskENTER_CRITICAL();
+		histogram = LatencyHistograms[sensor];
+		taskEXIT_CRITICAL();
+
+		pos = fmt_str(str, comm_sensor_name(sensor));
+		pos = fmt_u32(fmt_str(pos, " n="), histogram.count);
+		pos = fmt_u32(fmt_str(pos, " p50="), latency_percentile(&histogram, 50));
+		pos = fmt_u32(fmt_str(pos, "ms p99="), latency_percentile(&histogram, 99));
+		pos = fmt_u32(fmt_str(pos, "ms max="), histogram.max);
+		fmt_end(fmt_str(pos, "ms\r\n"));
+		print_str(str);
+	}
+
+	if (clock_is_synchronised()){
+		int32_t offset = clock_offset();
+		pos = fmt_str(str, offset < 0 ? "clock offset=-" : "clock offset=");
+		pos = fmt_u32(pos, offset < 0 ? -(uint32_t)offset : (uint32_t)offset);
+		pos = fmt_u32(fmt_str(pos, "ms rtt="), clock_round_trip());
+		fmt_end(fmt_str(pos, "ms\r\n"));
+	} else {
+		fmt_end(fmt_str(str, "clock not synchronised, latency measured from arrival\r\n"));
+	}
+	print_str(str);
 }
 
+/******************************************************************************
+Prints the last count readings passed on to the LEDs, oldest first.
+******************************************************************************/
+static void print_recent_readings(uint32_t count){
+
+	struct ReadingRecord record;
+	uint32_t newest;
+	char str[50], *pos;
 
+	taskENTER_CRITICAL();
+	newest = RecentReadingsCount;
+	taskEXIT_CRITICAL();
+
+	if (count > newest){
+		count = newest;
+	}
+	if (count > RECENT_READINGS_LENGTH){
+		count = RECENT_READINGS_LENGTH;
+	}
+
+	for (uint32_t idx = newest - count; idx < newest; idx++){
+		taskENTER_CRITICAL();
+		record = RecentReadings[idx % RECENT_READINGS_LENGTH];
+		taskEXIT_CRITICAL();
+
+		pos = fmt_sensor(str, record.address, record.sensorID);
+		pos = fmt_u32(fmt_str(pos, " "), record.data);
+		pos = fmt_u32(fmt_str(pos, " t="), record.sample_tick);
+		fmt_end(fmt_str(pos, "\r\n"));
+		print_str(str);
+	}
+}
+
+/******************************************************************************
+Tells the Host PC what was wrong with a command line.
+******************************************************************************/
+static void print_command_error(const struct HostPCCommand* command){
+
+	char str[HOSTPC_LINE_LENGTH + 20];
+
+	if (command->usage == NULL){
+		print_str("Unknown command, HELP lists them.\r\n");
+	} else {
+		fmt_end(fmt_str(fmt_str(fmt_str(str, "Usage: "), command->usage), "\r\n"));
+		print_str(str);
+	}
+}
+
+/******************************************************************************
+Lists the Host PC commands.
+******************************************************************************/
+static void print_command_help(){
+
+	const char* usage;
+	char str[HOSTPC_LINE_LENGTH + 10], *pos;
+
+	for (uint8_t idx = 0; (usage = hostPC_command_usage(idx)) != NULL; idx++){
+		fmt_end(fmt_str(fmt_str(str, usage), "\r\n"));
+		print_str(str);
+	}
+	pos = fmt_str(str, "<sensor> is one of");
+	for (enum SensorId_t sensor = Controller + 1; comm_is_sensor(sensor); sensor++){
+		pos = fmt_str(fmt_str(pos, " "), comm_sensor_name(sensor));
+	}
+	fmt_end(fmt_str(pos, "\r\n"));
+	print_str(str);
+}
 
 /*
  * This task reads the queue of characters from the Host PC when available
@@ -196,21 +958,44 @@ void SensorPlatform_RX_Task(){
  */
 void HostPC_RX_Task(){
 
-	enum HostPCCommands HostPCCommand = PC_Command_NONE;
+	struct HostPCCommand HostPCCommand;
 
-	Queue_HostPC_Data = xQueueCreate(80, sizeof(enum HostPCCommands));
+	Queue_HostPC_Data = xQueueCreate(HOSTPC_QUEUE_LENGTH, sizeof(struct HostPCCommand));
+	configASSERT(Queue_HostPC_Data != NULL);
 
 	request_hostPC_read();
 
 	while(1){
-		HostPCCommand = parse_hostPC_message();
+		parse_hostPC_message(&HostPCCommand);
 
-		if (HostPCCommand == PC_Command_START){
+		if (HostPCCommand.command == PC_Command_START){
 			print_str("Start Instruction received!\r\n");
 		}
 
-		if (HostPCCommand != PC_Command_NONE){
-			xQueueSendToBack(Queue_HostPC_Data, &HostPCCommand, 0);
+		// Answered here, the controller state machine never sees them
+		switch (HostPCCommand.command){
+			case PC_Command_NONE:
+				break;
+			case PC_Command_STATS:
+				print_usart_stats();
+				break;
+			case PC_Command_LATENCY:
+				print_latency_stats();
+				break;
+			case PC_Command_DUMP:
+				print_recent_readings(HostPCCommand.value);
+				break;
+			case PC_Command_HELP:
+				print_command_help();
+				break;
+			case PC_Command_INVALID:
+				print_command_error(&HostPCCommand);
+				break;
+			default:
+				if (xQueueSendToBack(Queue_HostPC_Data, &HostPCCommand, 0) != pdPASS){
+					print_str("Busy, command dropped.\r\n");
+				}
+				break;
 		}
 
 	}
@@ -268,9 +1053,23 @@ void WhiteLEDTask(void *params)
  * This task reads the queue of characters from the Sensor Platform when available
  * It then sends the processed data to the Sensor Controller Task
  */
+/******************************************************************************
+Adds the time from sample to LED update of a reading that is new in this update.
+******************************************************************************/
+static void record_latency(const LEDSensorData* led){
+
+	if (led->IsFresh && comm_is_sensor(led->sensorID)){
+		uint32_t latency = xTaskGetTickCount() - led->sample_tick;
+		taskENTER_CRITICAL();
+		latency_record(&LatencyHistograms[led->sensorID], latency);
+		taskEXIT_CRITICAL();
+	}
+}
+
 void LEDControllerTask(void *params) {
     LEDData received_LEDData;
-    Queue_LED_Data = xQueueCreate(80, sizeof(LEDData));
+    Queue_LED_Data = xQueueCreate(LED_QUEUE_LENGTH, sizeof(LEDData));
+    configASSERT(Queue_LED_Data != NULL);
 
 
 
@@ -282,6 +1081,9 @@ void LEDControllerTask(void *params) {
                     updateLEDStatus(received_LEDData.turbidity.sensorID, received_LEDData.turbidity.status);
                     updateLEDStatus(received_LEDData.microplastics.sensorID, received_LEDData.microplastics.status);
                     updateLEDStatus(received_LEDData.do_levels.sensorID, received_LEDData.do_levels.status);
+                    record_latency(&received_LEDData.turbidity);
+                    record_latency(&received_LEDData.microplastics);
+                    record_latency(&received_LEDData.do_levels);
                 }
                 break;
             default:
@@ -425,7 +1227,8 @@ void CompressionTask(void *params){
 	static LEDData send_LEDData;
 	static uint8_t count = 0;
 	static float val = 0.0;
-	Queue_Scaled_Data = xQueueCreate(80, sizeof(LEDData));
+	Queue_Scaled_Data = xQueueCreate(SCALED_QUEUE_LENGTH, sizeof(ScaledData));
+	configASSERT(Queue_Scaled_Data != NULL);
 	ScaledData data_s;
 	do {
 		if (xQueueReceive(Queue_Scaled_Data, &data_s, portMAX_DELAY) == pdPASS) {
@@ -433,26 +1236,32 @@ void CompressionTask(void *params){
 			case Turbidity:
 				char Turbidity_data_string[20];
 				val = (float)data_s.data/100.0;
-				sprintf(Turbidity_data_string, "%04.01f\r\n", val);
+				fmt_end(fmt_str(fmt_fixed(Turbidity_data_string, data_s.data, 2, 1, 2), "\r\n")); // "%04.01f"
 				print_str(Turbidity_data_string);
 				send_LEDData.turbidity.sensorID = Turbidity;
 				send_LEDData.turbidity.status = get_LEDstatus(Turbidity, val);
+				send_LEDData.turbidity.sample_tick = data_s.sample_tick;
+				send_LEDData.turbidity.IsFresh = true;
 				break;
 			case Microplastic:
 				char Microplastic_data_string[20];
 				val = (float)data_s.data/1.0;
-				sprintf(Microplastic_data_string, "%-4.0f\r\n", val);
+				fmt_end(fmt_str(fmt_pad(Microplastic_data_string, fmt_u32(Microplastic_data_string, data_s.data), 4), "\r\n")); // "%-4.0f"
 				print_str(Microplastic_data_string);
 				send_LEDData.microplastics.sensorID = Microplastic;
 				send_LEDData.microplastics.status = get_LEDstatus(Microplastic, val);
+				send_LEDData.microplastics.sample_tick = data_s.sample_tick;
+				send_LEDData.microplastics.IsFresh = true;
 				break;
 			case DOLevel:
 				char DOLevel_data_string[20];
 				val = (float)data_s.data/100.0;
-				sprintf(DOLevel_data_string, "%-4.02f\r\n", val);
+				fmt_end(fmt_str(fmt_fixed(DOLevel_data_string, data_s.data, 2, 2, 1), "\r\n")); // "%-4.02f"
 				print_str(DOLevel_data_string);
 				send_LEDData.do_levels.sensorID = DOLevel;
 				send_LEDData.do_levels.status = get_LEDstatus(DOLevel, val);
+				send_LEDData.do_levels.sample_tick = data_s.sample_tick;
+				send_LEDData.do_levels.IsFresh = true;
 				break;
 			default:
 				break;
@@ -461,6 +1270,9 @@ void CompressionTask(void *params){
 			count++;
 			if (count == 3){
 				xQueueSendToBack(Queue_LED_Data, &send_LEDData, 0);
+				send_LEDData.turbidity.IsFresh = false;
+				send_LEDData.microplastics.IsFresh = false;
+				send_LEDData.do_levels.IsFresh = false;
 				count = 0;
 			}
 
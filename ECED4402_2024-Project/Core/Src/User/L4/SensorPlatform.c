@@ -8,23 +8,139 @@
 #include <stdio.h>
 
 #include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_LinkRate.h"
+#include "User/L2/Comm_Reliable.h"
+#include "User/L2/Comm_Clock.h"
+#include "User/L2/Comm_Delta.h"
+#include "User/L2/Comm_Batch.h"
+#include "User/L2/Comm_Bus.h"
 #include "User/L3/TurbiditySensor.h"
 #include "User/L3/MicroplasticSensor.h"
 #include "User/L3/DOLevelSensor.h"
 #include "User/L4/SensorPlatform.h"
 #include "User/util.h"
+#include "User/format.h"
 
 //Required FreeRTOS header files
 #include "FreeRTOS.h"
 #include "Timers.h"
 #include "semphr.h"
 
+// This platform's address on a shared bus, COMM_ADDRESS_NONE for a
+// point-to-point link. Each platform on one bus is built with its own.
+#ifndef PLATFORM_NODE_ADDRESS
+#define PLATFORM_NODE_ADDRESS COMM_ADDRESS_NONE
+#endif
+
+// The platform's sensors: X(node, timer name, timer callback)
+#define PLATFORM_SENSOR_TABLE(X) \
+	X(Turbidity,    "Turbidity Sensor Task",    RunTurbiditySensor) \
+	X(Microplastic, "Microplastic Sensor Task", RunMicroplasticSensor) \
+	X(DOLevel,      "DOLevel Sensor Task",      RunDOLevelSensor)
+
+typedef void (*PlatformHandler)(const struct CommMessage* message);
+
+static TimerHandle_t SensorTimers[COMM_NODE_COUNT]; // Indexed by node, NULL for the controller
+
 static void ResetMessageStruct(struct CommMessage* currentRxMessage){
 
 	static const struct CommMessage EmptyMessage = {0};
 	*currentRxMessage = EmptyMessage;
 }
 
+static void handle_reset(const struct CommMessage* message){
+
+	for (enum SensorId_t sensor = Controller; sensor < COMM_NODE_COUNT; sensor++){
+		if (SensorTimers[sensor] != NULL){
+			xTimerStop(SensorTimers[sensor], portMAX_DELAY);
+		}
+	}
+	send_ack_message(RemoteSensingPlatformReset);
+}
+
+static void handle_sensor_enable(const struct CommMessage* message){
+
+	if (SensorTimers[message->SensorID] == NULL){
+		return; // A node this platform does not have
+	}
+	if (message->params == 0){
+		xTimerStop(SensorTimers[message->SensorID], portMAX_DELAY); // Period 0 disables the sensor
+	} else {
+		xTimerChangePeriod(SensorTimers[message->SensorID], message->params, portMAX_DELAY);
+		xTimerStart(SensorTimers[message->SensorID], portMAX_DELAY);
+	}
+	send_ack_message(COMM_ACK_TYPE(message->SensorID));
+}
+
+static void handle_link_rate(const struct CommMessage* message){
+	link_rate_handle_request((uint32_t)message->params * 100);
+}
+
+static void handle_framing(const struct CommMessage* message){
+	handle_framing_request(message->params);
+}
+
+static void handle_reliable(const struct CommMessage* message){
+	reliable_handle_request(message->params);
+}
+
+static void handle_clock(const struct CommMessage* message){
+	clock_handle_request();
+}
+
+static void handle_compression(const struct CommMessage* message){
+	delta_handle_request(message->params);
+}
+
+static void handle_batch(const struct CommMessage* message){
+	batch_handle_request(message->params);
+}
+
+static void handle_poll(const struct CommMessage* message){
+	bus_handle_poll();
+}
+
+static void handle_discover(const struct CommMessage* message){
+
+	uint16_t sensors = 0;
+
+	for (enum SensorId_t sensor = Controller + 1; comm_is_sensor(sensor); sensor++){
+		if (SensorTimers[sensor] != NULL){
+			sensors |= 1u << sensor;
+		}
+	}
+	send_discover_message(sensors);
+}
+
+// Messages from the controller, by message ID; IDs without a handler (acks,
+// data) are ignored
+static const PlatformHandler ControllerHandlers[COMM_MESSAGE_ID_COUNT] = {
+	[COMM_MSG_RESET_ENABLE] = handle_reset,
+	[COMM_MSG_LINK_RATE]    = handle_link_rate,
+	[COMM_MSG_FRAMING]      = handle_framing,
+	[COMM_MSG_RELIABLE]     = handle_reliable,
+	[COMM_MSG_RELIABLE_ACK] = reliable_handle_ack,
+	[COMM_MSG_CLOCK]        = handle_clock,
+	[COMM_MSG_COMPRESSION]  = handle_compression,
+	[COMM_MSG_BATCH_CONFIG] = handle_batch,
+	[COMM_MSG_POLL]         = handle_poll,
+	[COMM_MSG_DISCOVER]     = handle_discover,
+};
+
+// Messages addressed to one of the sensors, by message ID
+static const PlatformHandler SensorHandlers[COMM_MESSAGE_ID_COUNT] = {
+	[COMM_MSG_RESET_ENABLE] = handle_sensor_enable,
+};
+
+#define PLATFORM_SENSOR_TIMER(node, name, callback) \
+	SensorTimers[node] = xTimerCreate( \
+		name, \
+		TimerDefaultPeriod,		/* Period: changed by the enable command */ \
+		pdTRUE,		/* Autoreload: Continue running till deleted or stopped */ \
+		(void*)(node - Turbidity), \
+		callback \
+		);
+
 /******************************************************************************
 This task is created from the main.
 It is responsible for managing the messages from the datalink.
@@ -33,32 +149,11 @@ It is also responsible for starting the timers for each sensor
 void SensorPlatformTask(void *params)
 {
 	const TickType_t TimerDefaultPeriod = 1000;
-	TimerHandle_t TimerID_TurbiditySensor, TimerID_MicroplasticSensor, TimerID_DOLevelSensor;
+	const PlatformHandler* handlers;
+	char str[30];
 
-
-	TimerID_TurbiditySensor = xTimerCreate(
-		"Turbidity Sensor Task",
-		TimerDefaultPeriod,		// Period: Needed to be changed based on parameter
-		pdTRUE,		// Autoreload: Continue running till deleted or stopped
-		(void*)0,
-		RunTurbiditySensor
-		);
-
-	TimerID_MicroplasticSensor = xTimerCreate(
-		"Microplastic Sensor Task",
-		TimerDefaultPeriod,		// Period: Needed to be changed based on parameter
-		pdTRUE,		// Autoreload: Continue running till deleted or stopped
-		(void*)1,
-		RunMicroplasticSensor
-		);
-
-	TimerID_DOLevelSensor = xTimerCreate(
-		"DOLevel Sensor Task",
-		TimerDefaultPeriod,		// Period: Needed to be changed based on parameter
-		pdTRUE,		// Autoreload: Continue running till deleted or stopped
-		(void*)2,
-		RunDOLevelSensor
-		);
+	PLATFORM_SENSOR_TABLE(PLATFORM_SENSOR_TIMER)
+	bus_join(PLATFORM_NODE_ADDRESS);
 
 
 	print_str("Start Instruction received!\r\n");
@@ -72,68 +167,17 @@ void SensorPlatformTask(void *params)
 
 		parse_sensor_message(&currentRxMessage);
 
-		if(currentRxMessage.IsMessageReady == true && currentRxMessage.IsCheckSumValid == true){
-
-			switch(currentRxMessage.SensorID){
-				case Controller:
-					print_str("Reached Here CONTROLLER!\r\n");
-					switch(currentRxMessage.messageId){
-						case 0:
-							xTimerStop(TimerID_TurbiditySensor, portMAX_DELAY);
-							xTimerStop(TimerID_MicroplasticSensor, portMAX_DELAY);
-							xTimerStop(TimerID_DOLevelSensor, portMAX_DELAY);
-							send_ack_message(RemoteSensingPlatformReset);
-							break;
-						case 1: //Do Nothing
-							break;
-						case 3: //Do Nothing
-							break;
-						}
-					break;
-				case Turbidity:
-					print_str("Reached Here TURBIDITY!\r\n");
-					switch(currentRxMessage.messageId){
-						case 0:
-							xTimerChangePeriod(TimerID_TurbiditySensor, currentRxMessage.params, portMAX_DELAY);
-							xTimerStart(TimerID_TurbiditySensor, portMAX_DELAY);
-							send_ack_message(TurbiditySensorEnable);
-							break;
-						case 1: //Do Nothing
-							break;
-						case 3: //Do Nothing
-							break;
-					}
-					break;
-				case Microplastic:
-					print_str("Reached Here MICROPLASTIC!\r\n");
-					switch(currentRxMessage.messageId){
-						case 0:
-							xTimerChangePeriod(TimerID_MicroplasticSensor, currentRxMessage.params, portMAX_DELAY);
-							xTimerStart(TimerID_MicroplasticSensor, portMAX_DELAY);
-							send_ack_message(MicroplasticSensorEnable);
-							break;
-						case 1: //Do Nothing
-							break;
-						case 3: //Do Nothing
-							break;
-					}
-					break;
-				case DOLevel:
-					print_str("Reached Here DOLevel!\r\n");
-					switch(currentRxMessage.messageId){
-						case 0:
-							xTimerChangePeriod(TimerID_DOLevelSensor, currentRxMessage.params, portMAX_DELAY);
-							xTimerStart(TimerID_DOLevelSensor, portMAX_DELAY);
-							send_ack_message(DOLevelSensorEnable);
-							break;
-						case 1: //Do Nothing
-							break;
-						case 3: //Do Nothing
-							break;
-					}
-					break;
-					default://Should not get here
-						break;
+		// On a bus, frames for and from the other platforms are heard too
+		if(currentRxMessage.IsMessageReady == true && currentRxMessage.IsCheckSumValid == true
+				&& currentRxMessage.address == PLATFORM_NODE_ADDRESS
+				&& currentRxMessage.SensorID != None && currentRxMessage.messageId < COMM_MESSAGE_ID_COUNT){
+
+			fmt_end(fmt_str(fmt_str(fmt_str(str, "Reached Here "), comm_sensor_name(currentRxMessage.SensorID)), "!\r\n"));
+			print_str(str);
+
+			handlers = (currentRxMessage.SensorID == Controller) ? ControllerHandlers : SensorHandlers;
+			if (handlers[currentRxMessage.messageId] != NULL){
+				handlers[currentRxMessage.messageId](&currentRxMessage);
 			}
 			ResetMessageStruct(&currentRxMessage);
 		}
@@ -0,0 +1,114 @@
+/*
+ * format.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+#include "User/format.h"
+
+// "00" to "99": two digits per table lookup and per division by 100
+static const char DigitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char HexDigits[] = "0123456789abcdef";
+
+static const uint32_t PowersOf10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+// Writes exactly digits characters of value, most significant first
+static char* fmt_digits(char* out, uint32_t value, uint8_t digits){
+	char* end = out + digits;
+	char* pos = end;
+
+	while (pos - out >= 2){
+		uint32_t pair = (value % 100) * 2;
+		value /= 100;
+		pos -= 2;
+		pos[0] = DigitPairs[pair];
+		pos[1] = DigitPairs[pair + 1];
+	}
+	if (pos != out){
+		*--pos = '0' + (value % 10);
+	}
+	return end;
+}
+
+// Number of decimal digits in value, at least 1
+static uint8_t count_digits(uint32_t value){
+	uint8_t digits = 1;
+
+	while (digits < 10 && value >= PowersOf10[digits]){
+		digits++;
+	}
+	return digits;
+}
+
+char* fmt_str(char* out, const char* str){
+	while (*str){
+		*out++ = *str++;
+	}
+	return out;
+}
+
+// Like "%lu"
+char* fmt_u32(char* out, uint32_t value){
+	return fmt_digits(out, value, count_digits(value));
+}
+
+// Like "%08lu", the params field of an ASCII frame
+char* fmt_u32_pad8(char* out, uint32_t value){
+	return fmt_digits(out, value % 100000000, 8);
+}
+
+// Like "%02x", the checksum of an ASCII frame
+char* fmt_hex2(char* out, uint8_t value){
+	out[0] = HexDigits[value >> 4];
+	out[1] = HexDigits[value & 0x0F];
+	return out + 2;
+}
+
+// Writes value / 10^scale rounded to decimals places, with the integer part
+// zero padded to int_digits. fmt_fixed(out, 1234, 2, 1, 2) writes "12.3",
+// as sprintf("%04.1f", 12.34) would.
+char* fmt_fixed(char* out, uint32_t value, uint8_t scale, uint8_t decimals, uint8_t int_digits){
+	uint32_t integer, fraction;
+	uint8_t digits;
+
+	if (decimals < scale){
+		uint32_t divisor = PowersOf10[scale - decimals];
+		value = value / divisor + ((value % divisor) >= divisor / 2 ? 1 : 0);
+	} else {
+		value *= PowersOf10[decimals - scale];
+	}
+	integer = value / PowersOf10[decimals];
+	fraction = value % PowersOf10[decimals];
+
+	digits = count_digits(integer);
+	out = fmt_digits(out, integer, digits > int_digits ? digits : int_digits);
+	if (decimals){
+		*out++ = '.';
+		out = fmt_digits(out, fraction, decimals);
+	}
+	return out;
+}
+
+// Appends spaces until the text from start is width characters, like "%-4"
+char* fmt_pad(char* start, char* out, uint8_t width){
+	while (out - start < width){
+		*out++ = ' ';
+	}
+	return out;
+}
+
+char* fmt_end(char* out){
+	*out = '\0';
+	return out;
+}
@@ -0,0 +1,58 @@
+/*
+ * latency.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+#include "User/latency.h"
+
+// Bucket holding a latency: the value itself below 16, above that the power
+// of two it falls in and which half of it
+static uint8_t latency_bucket(uint32_t latency){
+	uint8_t msb, bucket;
+
+	if (latency < 16){
+		return latency;
+	}
+	msb = 31 - __builtin_clz(latency);
+	bucket = 16 + (msb - 4) * 2 + ((latency >> (msb - 1)) & 1);
+	return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Largest latency a bucket holds
+static uint32_t latency_bucket_limit(uint8_t bucket){
+	uint8_t msb;
+
+	if (bucket < 16){
+		return bucket;
+	}
+	msb = 4 + (bucket - 16) / 2;
+	return (1UL << msb) + (((bucket - 16) & 1) + 1) * (1UL << (msb - 1)) - 1;
+}
+
+void latency_record(struct LatencyHistogram* histogram, uint32_t latency){
+	histogram->buckets[latency_bucket(latency)]++;
+	histogram->count++;
+	if (latency > histogram->max){
+		histogram->max = latency;
+	}
+}
+
+// Upper limit of the bucket holding the percent-th percentile, so the value
+// reported is never below the true one. 0 when nothing was recorded.
+uint32_t latency_percentile(const struct LatencyHistogram* histogram, uint8_t percent){
+	uint32_t rank = (histogram->count * percent + 99) / 100;
+	uint32_t seen = 0;
+
+	if (histogram->count == 0){
+		return 0;
+	}
+	for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++){
+		seen += histogram->buckets[bucket];
+		if (seen >= rank){
+			uint32_t limit = latency_bucket_limit(bucket);
+			return limit < histogram->max ? limit : histogram->max;
+		}
+	}
+	return histogram->max;
+}
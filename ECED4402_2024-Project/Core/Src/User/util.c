@@ -10,28 +10,25 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 
-static SemaphoreHandle_t mutexHandle_print_str;
+#include "User/L1/USART_Driver.h"
+
 extern UART_HandleTypeDef huart2;
 
 void util_init(){
-	mutexHandle_print_str = xSemaphoreCreateMutex();
-}
-
-static void print_str_local(char * str){
-	HAL_UART_Transmit(&huart2,(uint8_t*) str, strlen(str), HAL_MAX_DELAY);
+	configure_usart_tx(USART_PORT_HOSTPC);
 }
 
-
+// Returns once the string is queued, the DMA engine serializes writers
 void print_str(char * str){
-	xSemaphoreTake(mutexHandle_print_str, portMAX_DELAY);
-	print_str_local(str);
-	xSemaphoreGive(mutexHandle_print_str);
+	usart_tx_write(USART_PORT_HOSTPC, (uint8_t*) str, strlen(str), portMAX_DELAY);
 }
 void print_str_ISR(char * str){
-	print_str_local(str);
+	usart_tx_write_ISR(USART_PORT_HOSTPC, (uint8_t*) str, strlen(str));
 }
 
 void print_str_unsafe(char * str){
+	// Let queued DMA output drain so the blocking HAL transmit does not collide with it
+	usart_tx_flush(USART_PORT_HOSTPC, portMAX_DELAY);
 	for(int i =0; i<strlen(str);i++){
 		HAL_UART_Transmit(&huart2,(uint8_t*) &str[i], 1, HAL_MAX_DELAY);
 		for(int j=0;j<100000;j++);
@@ -0,0 +1,428 @@
+/*
+ * freertos_host.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#define _GNU_SOURCE // Recursive mutex initializer
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_rtos.h" // Kernel of the host tests
+
+#include "queue.h"
+#include "semphr.h"
+
+#define HOST_TIMER_MAX   16
+#define HOST_PENDED_MAX  16
+
+// A queue, semaphore or mutex. Semaphores are queues of zero-sized items.
+struct HostQueue {
+    uint8_t* storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;  // Oldest item
+    UBaseType_t count; // Items waiting
+};
+
+struct HostTimer {
+    const char* name;
+    TickType_t period;
+    TickType_t expiry;
+    UBaseType_t IsAutoReload;
+    bool IsActive;
+    void* id;
+    TimerCallbackFunction_t callback;
+};
+
+struct HostPended {
+    PendedFunction_t function;
+    void* param1;
+    uint32_t param2;
+};
+
+_Static_assert(sizeof(struct HostQueue) <= sizeof(StaticQueue_t), "StaticQueue_t holds a host queue");
+
+static TickType_t TickCount;
+static struct HostTimer Timers[HOST_TIMER_MAX];
+static uint32_t TimerCount;
+static struct HostPended Pended[HOST_PENDED_MAX];
+static uint32_t PendedCount;
+static pthread_mutex_t CriticalLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t NotifyLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t NotifyCond = PTHREAD_COND_INITIALIZER;
+static uint32_t NotifyValue;
+static uint32_t NotifyGiven; // Notifications given since start
+static StaticTask_t HostTask;      // Handle returned for every task
+static StaticTask_t HostTimerTask; // The timer daemon, current while callbacks run
+static TaskHandle_t CurrentTask = (TaskHandle_t)&HostTask;
+
+/******************************************************************************
+ * @brief Port layer
+ ******************************************************************************/
+void vPortEnterCritical(void) {
+    pthread_mutex_lock(&CriticalLock);
+}
+
+void vPortExitCritical(void) {
+    pthread_mutex_unlock(&CriticalLock);
+}
+
+void vPortHostAssert(void) {
+    fprintf(stderr, "configASSERT failed\n");
+    abort();
+}
+
+void* pvPortMalloc(size_t xSize) {
+    return calloc(1, xSize);
+}
+
+void vPortFree(void* pv) {
+    free(pv);
+}
+
+uint64_t host_time_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/******************************************************************************
+ * @brief Queues and semaphores
+ ******************************************************************************/
+static QueueHandle_t host_queue_init(struct HostQueue* queue, UBaseType_t length, UBaseType_t item_size,
+                                     uint8_t* storage, UBaseType_t count) {
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = count;
+    return (QueueHandle_t)queue;
+}
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize,
+                                  const uint8_t ucQueueType) {
+    struct HostQueue* queue = pvPortMalloc(sizeof(struct HostQueue));
+
+    return host_queue_init(queue, uxQueueLength, uxItemSize, pvPortMalloc(uxQueueLength * uxItemSize + 1), 0);
+}
+
+QueueHandle_t xQueueGenericCreateStatic(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize,
+                                        uint8_t* pucQueueStorage, StaticQueue_t* pxStaticQueue,
+                                        const uint8_t ucQueueType) {
+    return host_queue_init((struct HostQueue*)pxStaticQueue, uxQueueLength, uxItemSize, pucQueueStorage, 0);
+}
+
+QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType) {
+    return host_queue_init(pvPortMalloc(sizeof(struct HostQueue)), 1, 0, NULL, 1);
+}
+
+QueueHandle_t xQueueCreateMutexStatic(const uint8_t ucQueueType, StaticQueue_t* pxStaticQueue) {
+    return host_queue_init((struct HostQueue*)pxStaticQueue, 1, 0, NULL, 1);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount) {
+    return host_queue_init(pvPortMalloc(sizeof(struct HostQueue)), uxMaxCount, 0, NULL, uxInitialCount);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphoreStatic(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount,
+                                                  StaticQueue_t* pxStaticQueue) {
+    return host_queue_init((struct HostQueue*)pxStaticQueue, uxMaxCount, 0, NULL, uxInitialCount);
+}
+
+// Nothing else runs to free a slot or give the semaphore, so a wait fails at once
+static void host_queue_wait_failed(TickType_t xTicksToWait) {
+    if (xTicksToWait == portMAX_DELAY) {
+        fprintf(stderr, "A task would wait forever on a queue\n");
+        abort();
+    }
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void* const pvItemToQueue, TickType_t xTicksToWait,
+                             const BaseType_t xCopyPosition) {
+    struct HostQueue* queue = (struct HostQueue*)xQueue;
+    UBaseType_t slot;
+
+    vPortEnterCritical();
+    if (queue->count == queue->length) {
+        vPortExitCritical();
+        host_queue_wait_failed(xTicksToWait);
+        return errQUEUE_FULL;
+    }
+    if (xCopyPosition == queueSEND_TO_FRONT) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (pvItemToQueue != NULL) {
+        memcpy(&queue->storage[slot * queue->item_size], pvItemToQueue, queue->item_size);
+    }
+    queue->count++;
+    vPortExitCritical();
+    return pdPASS;
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void* const pvItemToQueue,
+                                    BaseType_t* const pxHigherPriorityTaskWoken, const BaseType_t xCopyPosition) {
+    return xQueueGenericSend(xQueue, pvItemToQueue, 0, xCopyPosition);
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t* const pxHigherPriorityTaskWoken) {
+    return xQueueGenericSend(xQueue, NULL, 0, queueSEND_TO_BACK);
+}
+
+static BaseType_t host_queue_take(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait,
+                                  bool IsPeek) {
+    struct HostQueue* queue = (struct HostQueue*)xQueue;
+
+    vPortEnterCritical();
+    if (queue->count == 0) {
+        vPortExitCritical();
+        host_queue_wait_failed(xTicksToWait);
+        return errQUEUE_EMPTY;
+    }
+    if (pvBuffer != NULL) {
+        memcpy(pvBuffer, &queue->storage[queue->head * queue->item_size], queue->item_size);
+    }
+    if (!IsPeek) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+    }
+    vPortExitCritical();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait) {
+    return host_queue_take(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait) {
+    return host_queue_take(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void* const pvBuffer,
+                                BaseType_t* const pxHigherPriorityTaskWoken) {
+    return host_queue_take(xQueue, pvBuffer, 0, false);
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait) {
+    return host_queue_take(xQueue, NULL, xTicksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue) {
+    return ((struct HostQueue*)xQueue)->count;
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue) {
+    return ((struct HostQueue*)xQueue)->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue) {
+    return ((struct HostQueue*)xQueue)->length - ((struct HostQueue*)xQueue)->count;
+}
+
+BaseType_t xQueueGenericReset(QueueHandle_t xQueue, BaseType_t xNewQueue) {
+    ((struct HostQueue*)xQueue)->head = 0;
+    ((struct HostQueue*)xQueue)->count = 0;
+    return pdPASS;
+}
+
+/******************************************************************************
+ * @brief Tasks and notifications
+ ******************************************************************************/
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+                       void* const pvParameters, UBaseType_t uxPriority, TaskHandle_t* const pxCreatedTask) {
+    if (pxCreatedTask != NULL) {
+        *pxCreatedTask = (TaskHandle_t)&HostTask;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t pxTaskCode, const char* const pcName, const uint32_t ulStackDepth,
+                               void* const pvParameters, UBaseType_t uxPriority, StackType_t* const puxStackBuffer,
+                               StaticTask_t* const pxTaskBuffer) {
+    return (TaskHandle_t)pxTaskBuffer;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return CurrentTask;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return TickCount;
+}
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return TickCount;
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay) {
+    host_advance_ticks(xTicksToDelay);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken) {
+    pthread_mutex_lock(&NotifyLock);
+    NotifyValue++;
+    NotifyGiven++;
+    pthread_cond_signal(&NotifyCond);
+    pthread_mutex_unlock(&NotifyLock);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    uint32_t value;
+
+    pthread_mutex_lock(&NotifyLock);
+    if (xTicksToWait == portMAX_DELAY) {
+        while (NotifyValue == 0) {
+            pthread_cond_wait(&NotifyCond, &NotifyLock);
+        }
+    } else if (NotifyValue == 0 && xTicksToWait != 0) {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)(xTicksToWait % 1000) * 1000000L * portTICK_PERIOD_MS;
+        deadline.tv_sec += xTicksToWait / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&NotifyCond, &NotifyLock, &deadline);
+    }
+    value = NotifyValue;
+    if (value != 0) {
+        NotifyValue = xClearCountOnExit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&NotifyLock);
+    return value;
+}
+
+/******************************************************************************
+ * @brief Software timers. A callback runs once its expiry tick is reached;
+ * functions pended from anywhere run before the timers of the next tick.
+ ******************************************************************************/
+TimerHandle_t xTimerCreate(const char* const pcTimerName, const TickType_t xTimerPeriodInTicks,
+                           const UBaseType_t uxAutoReload, void* const pvTimerID,
+                           TimerCallbackFunction_t pxCallbackFunction) {
+    struct HostTimer* timer;
+
+    if (TimerCount == HOST_TIMER_MAX) {
+        return NULL;
+    }
+    timer = &Timers[TimerCount++];
+    timer->name = pcTimerName;
+    timer->period = xTimerPeriodInTicks;
+    timer->IsAutoReload = uxAutoReload;
+    timer->id = pvTimerID;
+    timer->callback = pxCallbackFunction;
+    timer->IsActive = false;
+    return (TimerHandle_t)timer;
+}
+
+BaseType_t xTimerGenericCommand(TimerHandle_t xTimer, const BaseType_t xCommandID, const TickType_t xOptionalValue,
+                                BaseType_t* const pxHigherPriorityTaskWoken, const TickType_t xTicksToWait) {
+    struct HostTimer* timer = (struct HostTimer*)xTimer;
+
+    switch (xCommandID) {
+        case tmrCOMMAND_START:
+        case tmrCOMMAND_RESET:
+        case tmrCOMMAND_START_FROM_ISR:
+        case tmrCOMMAND_RESET_FROM_ISR:
+            timer->IsActive = true;
+            timer->expiry = TickCount + timer->period;
+            break;
+        case tmrCOMMAND_CHANGE_PERIOD:
+        case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR:
+            timer->period = xOptionalValue;
+            timer->IsActive = true;
+            timer->expiry = TickCount + timer->period;
+            break;
+        case tmrCOMMAND_STOP:
+        case tmrCOMMAND_STOP_FROM_ISR:
+        case tmrCOMMAND_DELETE:
+            timer->IsActive = false;
+            break;
+        default:
+            return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void* pvTimerGetTimerID(const TimerHandle_t xTimer) {
+    return ((struct HostTimer*)xTimer)->id;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer) {
+    return ((struct HostTimer*)xTimer)->IsActive;
+}
+
+TickType_t xTimerGetPeriod(TimerHandle_t xTimer) {
+    return ((struct HostTimer*)xTimer)->period;
+}
+
+TaskHandle_t xTimerGetTimerDaemonTaskHandle(void) {
+    return (TaskHandle_t)&HostTimerTask;
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t xFunctionToPend, void* pvParameter1, uint32_t ulParameter2,
+                                  TickType_t xTicksToWait) {
+    if (PendedCount == HOST_PENDED_MAX) {
+        return pdFAIL;
+    }
+    Pended[PendedCount++] = (struct HostPended){ xFunctionToPend, pvParameter1, ulParameter2 };
+    return pdPASS;
+}
+
+BaseType_t xTimerPendFunctionCallFromISR(PendedFunction_t xFunctionToPend, void* pvParameter1,
+                                         uint32_t ulParameter2, BaseType_t* pxHigherPriorityTaskWoken) {
+    return xTimerPendFunctionCall(xFunctionToPend, pvParameter1, ulParameter2, 0);
+}
+
+void host_advance_ticks(TickType_t ticks) {
+    TaskHandle_t caller = CurrentTask;
+
+    CurrentTask = (TaskHandle_t)&HostTimerTask;
+    while (ticks-- > 0) {
+        TickCount++;
+        for (uint32_t idx = 0; idx < PendedCount; idx++) {
+            Pended[idx].function(Pended[idx].param1, Pended[idx].param2); // May pend more
+        }
+        PendedCount = 0;
+        for (uint32_t idx = 0; idx < TimerCount; idx++) {
+            struct HostTimer* timer = &Timers[idx];
+
+            if (!timer->IsActive || timer->expiry != TickCount) {
+                continue;
+            }
+            if (timer->IsAutoReload) {
+                timer->expiry += timer->period;
+            } else {
+                timer->IsActive = false;
+            }
+            timer->callback((TimerHandle_t)timer);
+        }
+    }
+    CurrentTask = caller;
+}
+
+uint32_t host_active_timers(void) {
+    uint32_t count = 0;
+
+    for (uint32_t idx = 0; idx < TimerCount; idx++) {
+        count += Timers[idx].IsActive ? 1 : 0;
+    }
+    return count;
+}
+
+uint32_t host_notifications(void) {
+    uint32_t count;
+
+    pthread_mutex_lock(&NotifyLock);
+    count = NotifyGiven;
+    pthread_mutex_unlock(&NotifyLock);
+    return count;
+}
@@ -0,0 +1,46 @@
+/*
+ * host_rtos.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef TESTS_STUBS_HOST_RTOS_H_ // Include guard to prevent multiple inclusions
+#define TESTS_STUBS_HOST_RTOS_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+// The kernel of the host tests. Tasks are created but never run: a test
+// calls the functions under test itself and moves time on with
+// host_advance_ticks(), which runs the timer callbacks and pended functions
+// that come due on the way, in the order the timer daemon would. Queues and
+// semaphores never block; a call that would wait forever aborts the test.
+// Task notifications are the exception and do block, so a producer thread
+// can wake a consumer thread as an ISR wakes a task.
+
+/**
+ * @brief Moves the tick count on, one tick at a time, running what comes due.
+ * @param ticks Number of ticks.
+ */
+void host_advance_ticks(TickType_t ticks);
+
+/**
+ * @brief Number of timers currently running.
+ */
+uint32_t host_active_timers(void);
+
+/**
+ * @brief Number of task notifications given since start.
+ */
+uint32_t host_notifications(void);
+
+/**
+ * @brief Returns the current monotonic time in nanoseconds, for benchmarks.
+ */
+uint64_t host_time_ns(void);
+
+#endif /* TESTS_STUBS_HOST_RTOS_H_ */
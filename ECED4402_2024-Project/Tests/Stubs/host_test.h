@@ -0,0 +1,35 @@
+/*
+ * host_test.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef TESTS_STUBS_HOST_TEST_H_ // Include guard to prevent multiple inclusions
+#define TESTS_STUBS_HOST_TEST_H_
+
+#include <stdio.h>
+
+// Checks of the host tests. A failed check is reported and counted; main()
+// ends with return host_test_summary(), so make stops at the first test
+// program that had a failure. Include it from the test's own file only.
+
+static unsigned HostChecks;
+static unsigned HostFailures;
+
+#define CHECK(condition) do { \
+        HostChecks++; \
+        if (!(condition)) { \
+            HostFailures++; \
+            if (HostFailures <= 20) { \
+                printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            } \
+        } \
+    } while (0)
+
+static inline int host_test_summary(const char* name) {
+    printf("%s: %u checks, %u failed\n", name, HostChecks, HostFailures);
+    return HostFailures == 0 ? 0 : 1;
+}
+
+#endif /* TESTS_STUBS_HOST_TEST_H_ */
@@ -0,0 +1,110 @@
+/*
+ * main.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef TESTS_STUBS_MAIN_H_ // Include guard to prevent multiple inclusions
+#define TESTS_STUBS_MAIN_H_
+
+// Stands in for the CubeMX main.h in the host tests: the few HAL types,
+// registers and pins the L1 modules use. The HAL functions are declared here
+// and defined by the tests that link the USART driver.
+
+#include <stdint.h>
+
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+typedef enum { HAL_OK, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { GPIO_PIN_RESET, GPIO_PIN_SET } GPIO_PinState;
+
+typedef struct {
+    volatile uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct {
+    volatile uint32_t ODR, IDR;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct {
+    USART_TypeDef* Instance;
+    UART_InitTypeDef Init;
+    volatile uint32_t gState;
+    volatile uint32_t RxState;
+    volatile uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+// Peripherals sit in 1 KB slots of a 32 KB aligned block, like an APB bus,
+// so the driver's slot lookup sees the same slot numbers as on the target
+typedef union {
+    USART_TypeDef usart;
+    GPIO_TypeDef gpio;
+    uint8_t slot[1024];
+} HostPeripheralSlot;
+
+extern HostPeripheralSlot HostPeripherals[32];
+
+#define USART1 (&HostPeripherals[4].usart)
+#define USART2 (&HostPeripherals[17].usart)
+#define USART6 (&HostPeripherals[5].usart)
+#define GPIOA  (&HostPeripherals[0].gpio)
+#define GPIOB  (&HostPeripherals[1].gpio)
+#define GPIOC  (&HostPeripherals[2].gpio)
+
+#define GPIO_PIN_5 ((uint16_t)0x0020)
+#define GPIO_PIN_8 ((uint16_t)0x0100)
+#define GPIO_PIN_9 ((uint16_t)0x0200)
+
+#define LD2_Pin             GPIO_PIN_5
+#define LD2_GPIO_Port       GPIOA
+#define SensorRTS_Pin       GPIO_PIN_8
+#define SensorRTS_GPIO_Port GPIOC
+#define SensorCTS_Pin       GPIO_PIN_9
+#define SensorCTS_GPIO_Port GPIOC
+
+#define USART_SR_PE     0x0001U
+#define USART_SR_FE     0x0002U
+#define USART_SR_NE     0x0004U
+#define USART_SR_ORE    0x0008U
+#define USART_SR_IDLE   0x0010U
+#define USART_SR_RXNE   0x0020U
+#define USART_SR_TC     0x0040U
+#define USART_SR_TXE    0x0080U
+#define USART_CR1_IDLEIE 0x0010U
+#define USART_CR1_RXNEIE 0x0020U
+#define USART_CR1_TCIE   0x0040U
+#define USART_CR1_TXEIE  0x0080U
+#define USART_CR3_DMAT   0x0080U
+
+#define ATOMIC_SET_BIT(REG, BIT)   ((REG) |= (BIT))
+#define ATOMIC_CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+
+#define HAL_UART_STATE_READY 0x20U
+#define HAL_UART_ERROR_PE    0x01U
+#define HAL_UART_ERROR_NE    0x02U
+#define HAL_UART_ERROR_FE    0x04U
+#define HAL_UART_ERROR_ORE   0x08U
+#define UART_OVERSAMPLING_16 0x0000U
+#define UART_OVERSAMPLING_8  0x8000U
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size);
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+#endif /* TESTS_STUBS_MAIN_H_ */
@@ -0,0 +1,61 @@
+/*
+ * portmacro.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef TESTS_STUBS_PORTMACRO_H_ // Include guard to prevent multiple inclusions
+#define TESTS_STUBS_PORTMACRO_H_
+
+// FreeRTOS port for the host tests. Found before the ARM_CM4F port on the
+// include path, so the kernel headers compile for the build machine. Nothing
+// is scheduled: freertos_host.c implements the kernel calls the firmware
+// modules make, see host_rtos.h.
+
+#include <stdint.h>
+
+#define portCHAR        char
+#define portFLOAT       float
+#define portDOUBLE      double
+#define portLONG        long
+#define portSHORT       short
+#define portSTACK_TYPE  uint32_t
+#define portBASE_TYPE   long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY           (TickType_t)0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH        (-1)
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT      8
+#define portPOINTER_SIZE_TYPE   uintptr_t
+
+// A yield from an ISR has nothing to switch to
+#define portYIELD()                             do { } while (0)
+#define portEND_SWITCHING_ISR(xSwitchRequired)  do { (void)(xSwitchRequired); } while (0)
+#define portYIELD_FROM_ISR(x)                   portEND_SWITCHING_ISR(x)
+
+// Critical sections take one lock shared by the host threads
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+extern void vPortHostAssert(void);
+#define portSET_INTERRUPT_MASK_FROM_ISR()       (vPortEnterCritical(), 0)
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)    do { (void)(x); vPortExitCritical(); } while (0)
+#define portDISABLE_INTERRUPTS()                vPortHostAssert() // Only reached from configASSERT()
+#define portENABLE_INTERRUPTS()                 do { } while (0)
+#define portENTER_CRITICAL()                    vPortEnterCritical()
+#define portEXIT_CRITICAL()                     vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void* pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters)       void vFunction(void* pvParameters)
+
+#define portNOP() do { } while (0)
+#define portMEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif /* TESTS_STUBS_PORTMACRO_H_ */
@@ -0,0 +1,20 @@
+/*
+ * reent.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef TESTS_STUBS_REENT_H_ // Include guard to prevent multiple inclusions
+#define TESTS_STUBS_REENT_H_
+
+// configUSE_NEWLIB_REENTRANT puts a newlib reentrancy block in every task;
+// the host C library has none, so the kernel headers get an empty one
+
+struct _reent {
+    int _errno;
+};
+
+#define _REENT_INIT_PTR(x)
+
+#endif /* TESTS_STUBS_REENT_H_ */
@@ -0,0 +1,51 @@
+/*
+ * stm32f4xx_ll_usart.h
+ *
+ *  Created on: Dec 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#ifndef TESTS_STUBS_STM32F4XX_LL_USART_H_ // Include guard to prevent multiple inclusions
+#define TESTS_STUBS_STM32F4XX_LL_USART_H_
+
+// The LL USART calls used by the driver, acting on the host register block.
+// A byte written to DR is passed to HostUsart_Transmit(), defined by the test.
+
+#include <stdbool.h>
+
+#include "main.h"
+
+void HostUsart_Transmit(USART_TypeDef* USARTx, uint8_t Value);
+
+#define LL_USART_ReadReg(INSTANCE, REG) ((INSTANCE)->REG)
+
+static inline uint8_t LL_USART_ReceiveData8(USART_TypeDef* USARTx) {
+    USARTx->SR &= ~USART_SR_RXNE;
+    return (uint8_t)USARTx->DR;
+}
+
+static inline void LL_USART_TransmitData8(USART_TypeDef* USARTx, uint8_t Value) {
+    HostUsart_Transmit(USARTx, Value);
+}
+
+static inline bool LL_USART_IsActiveFlag_TXE(USART_TypeDef* USARTx) {
+    return (USARTx->SR & USART_SR_TXE) != 0;
+}
+
+static inline void LL_USART_EnableIT_RXNE(USART_TypeDef* USARTx) {
+    USARTx->CR1 |= USART_CR1_RXNEIE;
+}
+
+static inline void LL_USART_EnableIT_TXE(USART_TypeDef* USARTx) {
+    USARTx->CR1 |= USART_CR1_TXEIE;
+}
+
+static inline void LL_USART_DisableIT_TXE(USART_TypeDef* USARTx) {
+    USARTx->CR1 &= ~USART_CR1_TXEIE;
+}
+
+static inline bool LL_USART_IsEnabledIT_TXE(USART_TypeDef* USARTx) {
+    return (USARTx->CR1 & USART_CR1_TXEIE) != 0;
+}
+
+#endif /* TESTS_STUBS_STM32F4XX_LL_USART_H_ */
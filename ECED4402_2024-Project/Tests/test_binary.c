@@ -0,0 +1,215 @@
+/*
+ * test_binary.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "host_rtos.h"
+#include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Binary.h"
+
+// Encoder and decoder of the binary framing: every field combination round
+// trips, frames never contain the delimiter, and damaged or truncated frames
+// are rejected. The benchmark then compares how many readings per second the
+// sensor link carries at 115200 baud in each framing, and what a frame costs
+// to build and decode on the host.
+
+#define LINK_BAUD       115200
+#define LINK_BYTE_BITS  10   // Start, 8 data, stop
+#define BENCH_READINGS  100000
+
+// ASCII frames as Comm_Datalink.c builds them, see enum CommFraming
+#define ASCII_FRAME_LENGTH       (1 + COMM_NODE_NAME_LENGTH + 4 + 8 + 3 + 2 + 1) // "$SENSR,MM,PPPPPPPP,*,CS\n"
+#define ASCII_SHORT_FRAME_LENGTH (1 + 2 + 1 + 8 + 3 + 2 + 1)                     // "$sM,PPPPPPPP,*,CS\n"
+
+static bool has_zero(const uint8_t* data, uint16_t length) {
+    return memchr(data, BINARY_FRAME_DELIMITER, length) != NULL;
+}
+
+static bool same_message(const struct CommMessage* a, const struct CommMessage* b) {
+    return a->address == b->address && a->SensorID == b->SensorID && a->messageId == b->messageId
+           && a->params == b->params && a->HasSeq == b->HasSeq && (!a->HasSeq || a->seq == b->seq)
+           && a->HasTimestamp == b->HasTimestamp && (!a->HasTimestamp || a->timestamp == b->timestamp)
+           && a->IsDelta == b->IsDelta;
+}
+
+static uint32_t random_timestamp(void) {
+    static const uint32_t Ranges[] = { 0x80, 0x4000, 0x200000, 0x10000000, 0xFFFFFFFF };
+
+    return ((uint32_t)rand() * 65599u + rand()) % Ranges[rand() % 5];
+}
+
+/******************************************************************************
+ * @brief Every sensor, message ID and optional field, with and without an
+ * address, under both CRCs.
+ ******************************************************************************/
+static void test_single_round_trip(void) {
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1];
+    struct CommMessage sent = {0}, received[BINARY_BATCH_MAX];
+    uint16_t length;
+
+    srand(11);
+    for (int round = 0; round < 20000; round++) {
+        enum BinaryIntegrity integrity = (round & 1) ? BINARY_CRC32 : BINARY_CRC16;
+        bool has_params = (rand() % 4) != 0;
+
+        sent = (struct CommMessage){0};
+        sent.address = (rand() % 3 == 0) ? 1 + rand() % COMM_ADDRESS_MAX : COMM_ADDRESS_NONE;
+        sent.SensorID = Controller + rand() % (COMM_NODE_COUNT - Controller);
+        sent.messageId = rand() % COMM_MESSAGE_ID_COUNT;
+        if (sent.SensorID == Controller && sent.messageId == BINARY_BATCH_MESSAGEID) {
+            sent.messageId = COMM_MSG_DATA; // Reserved for batch frames
+        }
+        sent.HasSeq = has_params && rand() % 2;
+        sent.HasTimestamp = has_params && rand() % 2;
+        sent.IsDelta = has_params && rand() % 4 == 0;
+        sent.params = has_params ? rand() % 65536 : 0;
+        sent.seq = sent.HasSeq ? rand() % 256 : 0;
+        sent.timestamp = sent.HasTimestamp ? random_timestamp() : 0;
+
+        length = binary_frame_encode(frame, &sent, has_params, integrity);
+        CHECK(length >= 2 && length <= BINARY_FRAME_MAX_ENCODED + 1);
+        CHECK(!has_zero(frame, length - 1) && frame[length - 1] == BINARY_FRAME_DELIMITER);
+        CHECK(binary_frame_decode(frame, length - 1, integrity, received) == 1);
+        CHECK(same_message(&sent, &received[0]));
+    }
+}
+
+static void test_batch_round_trip(void) {
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1];
+    struct CommMessage sent[BINARY_BATCH_MAX], received[BINARY_BATCH_MAX];
+    uint16_t length;
+    uint8_t address;
+
+    srand(12);
+    for (int round = 0; round < 5000; round++) {
+        enum BinaryIntegrity integrity = (round & 1) ? BINARY_CRC32 : BINARY_CRC16;
+        uint8_t count = 1 + rand() % BINARY_BATCH_MAX;
+
+        address = (rand() % 2) ? 1 + rand() % COMM_ADDRESS_MAX : COMM_ADDRESS_NONE;
+        for (uint8_t reading = 0; reading < count; reading++) {
+            sent[reading] = (struct CommMessage){0};
+            sent[reading].address = address;
+            sent[reading].SensorID = Turbidity + rand() % (COMM_NODE_COUNT - Turbidity);
+            sent[reading].messageId = COMM_MSG_DATA;
+            sent[reading].params = rand() % 65536;
+            sent[reading].HasTimestamp = rand() % 2;
+            sent[reading].timestamp = sent[reading].HasTimestamp ? random_timestamp() : 0;
+            sent[reading].IsDelta = rand() % 2;
+        }
+
+        length = binary_batch_encode(frame, sent, count, address, integrity);
+        CHECK(length <= BINARY_FRAME_MAX_ENCODED + 1);
+        CHECK(!has_zero(frame, length - 1) && frame[length - 1] == BINARY_FRAME_DELIMITER);
+        CHECK(binary_frame_decode(frame, length - 1, integrity, received) == count);
+        for (uint8_t reading = 0; reading < count; reading++) {
+            CHECK(same_message(&sent[reading], &received[reading]));
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Flipped bits and missing bytes, in a single frame and a full batch.
+ ******************************************************************************/
+static void test_damaged_frames(void) {
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1], copy[BINARY_FRAME_MAX_ENCODED + 1];
+    struct CommMessage sent[BINARY_BATCH_MAX] = {0}, received[BINARY_BATCH_MAX];
+    uint16_t length;
+    uint32_t accepted = 0;
+
+    for (uint8_t reading = 0; reading < BINARY_BATCH_MAX; reading++) {
+        sent[reading].SensorID = Turbidity + reading % 3;
+        sent[reading].messageId = COMM_MSG_DATA;
+        sent[reading].params = 1000 + 997 * reading;
+        sent[reading].HasTimestamp = true;
+        sent[reading].timestamp = 123456 + reading;
+    }
+
+    for (int kind = 0; kind < 4; kind++) {
+        enum BinaryIntegrity integrity = (kind & 1) ? BINARY_CRC32 : BINARY_CRC16;
+
+        if (kind < 2) {
+            sent[0].HasSeq = true;
+            sent[0].seq = 77;
+            length = binary_frame_encode(frame, &sent[0], true, integrity) - 1;
+        } else {
+            length = binary_batch_encode(frame, sent, BINARY_BATCH_MAX, 42, integrity) - 1;
+        }
+
+        for (uint16_t bit = 0; bit < length * 8; bit++) {
+            memcpy(copy, frame, length);
+            copy[bit / 8] ^= 1 << (bit % 8);
+            accepted += binary_frame_decode(copy, length, integrity, received) != 0;
+        }
+        for (uint16_t cut = 0; cut < length; cut++) {
+            memcpy(copy, frame, length);
+            accepted += binary_frame_decode(copy, cut, integrity, received) != 0;
+        }
+    }
+    CHECK(accepted == 0);
+}
+
+/******************************************************************************
+ * @brief Readings per second on the link in each framing, and host cost of
+ * building and decoding a frame. Readings are 0 to 9999 with timestamps off,
+ * as sent by default.
+ ******************************************************************************/
+static void benchmark_framings(void) {
+    static uint8_t frames[BENCH_READINGS / BINARY_BATCH_MAX][BINARY_FRAME_MAX_ENCODED + 1];
+    static uint16_t lengths[BENCH_READINGS / BINARY_BATCH_MAX];
+    struct CommMessage reading = { .SensorID = Turbidity, .messageId = COMM_MSG_DATA };
+    struct CommMessage batch[BINARY_BATCH_MAX], received[BINARY_BATCH_MAX];
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1];
+    uint64_t single_bytes = 0, batch_bytes = 0, start, encode_ns, decode_ns;
+    uint32_t decoded = 0;
+    const double bytes_per_s = (double)LINK_BAUD / LINK_BYTE_BITS;
+
+    srand(13);
+    start = host_time_ns();
+    for (int idx = 0; idx < BENCH_READINGS; idx++) {
+        reading.params = rand() % 10000;
+        single_bytes += binary_frame_encode(frame, &reading, true, BINARY_CRC16);
+    }
+    encode_ns = host_time_ns() - start;
+
+    for (int idx = 0; idx < BENCH_READINGS / BINARY_BATCH_MAX; idx++) {
+        for (int slot = 0; slot < BINARY_BATCH_MAX; slot++) {
+            batch[slot] = reading;
+            batch[slot].params = rand() % 10000;
+        }
+        lengths[idx] = binary_batch_encode(frames[idx], batch, BINARY_BATCH_MAX, COMM_ADDRESS_NONE, BINARY_CRC16);
+        batch_bytes += lengths[idx];
+    }
+
+    start = host_time_ns();
+    for (int idx = 0; idx < BENCH_READINGS / BINARY_BATCH_MAX; idx++) {
+        decoded += binary_frame_decode(frames[idx], lengths[idx] - 1, BINARY_CRC16, received);
+    }
+    decode_ns = host_time_ns() - start;
+    CHECK(decoded == BENCH_READINGS);
+
+    printf("%-22s %6s %14s\n", "framing at 115200", "bytes", "readings/s");
+    printf("%-22s %6u %14.0f\n", "ascii", ASCII_FRAME_LENGTH, bytes_per_s / ASCII_FRAME_LENGTH);
+    printf("%-22s %6u %14.0f\n", "ascii short", ASCII_SHORT_FRAME_LENGTH, bytes_per_s / ASCII_SHORT_FRAME_LENGTH);
+    printf("%-22s %6.2f %14.0f\n", "binary, crc-16", (double)single_bytes / BENCH_READINGS,
+           bytes_per_s * BENCH_READINGS / single_bytes);
+    printf("%-22s %6.2f %14.0f\n", "binary batch of 8", (double)batch_bytes / BENCH_READINGS,
+           bytes_per_s * BENCH_READINGS / batch_bytes);
+    printf("host: encode %.0f ns/frame, batch decode %.0f ns/reading\n",
+           (double)encode_ns / BENCH_READINGS, (double)decode_ns / BENCH_READINGS);
+
+    CHECK(single_bytes * 2 < (uint64_t)BENCH_READINGS * ASCII_FRAME_LENGTH);
+}
+
+int main(void) {
+    test_single_round_trip();
+    test_batch_round_trip();
+    test_damaged_frames();
+    benchmark_framings();
+    return host_test_summary("test_binary");
+}
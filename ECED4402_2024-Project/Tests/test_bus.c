@@ -0,0 +1,350 @@
+/*
+ * test_bus.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "host_test.h"
+#include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Lanes.h"
+#include "User/L2/Comm_Bus.h"
+
+// A shared bus with BUS_PLATFORMS virtual platforms. Each platform is a child
+// process running the real datalink and Comm_Bus.c, so each has its own
+// address and hold buffer as separate boards would. Every byte put on the bus
+// reaches the controller (this process) and every other platform. The
+// controller discovers the platforms, then polls them in rounds; a polled
+// platform sends the readings it took since its last turn and ends the turn.
+// Half the rounds run in ASCII, the rest after switching every platform to
+// binary CRC-32 framing, where a turn's readings go out as batch frames.
+// Checks: discovery finds exactly the platforms; only the polled platform
+// ever answers; every turn's readings come from it, in order, and match its
+// end-of-turn count.
+
+#define BUS_PLATFORMS     24
+#define BUS_ADDRESSES     40   // Addresses the controller tries
+#define BUS_ROUNDS        100
+#define BUS_WAIT_MS       200  // Longest silence before a turn counts as timed out
+#define BUS_DISCOVER_MS   30   // Time an absent address is given to answer
+#define LINK_BAUD         115200
+#define LINK_BYTE_BITS    10
+#define BUS_QUEUE_LENGTH  256
+
+struct BusPlatform {
+    uint8_t address;
+    pid_t pid;
+    int down; // Bus to platform
+    int up;   // Platform to bus
+};
+
+static struct BusPlatform Platforms[BUS_PLATFORMS];
+static int BusOut = -1;              // A platform's end of its up pipe, -1 in the controller
+static struct CommMessage Queue[BUS_QUEUE_LENGTH]; // Controller: frames heard, in order
+static uint16_t QueueHead, QueueTail;
+static struct CommParser Parser;
+static uint64_t BusBytes;            // Controller: bytes put on the bus by anyone
+static uint32_t BusWriteErrors;
+
+/******************************************************************************
+ * @brief The lanes and drivers the datalink sends through. Everything the
+ * controller sends goes on the bus at once; a platform's bytes go to the
+ * controller, which passes them on to the other platforms.
+ ******************************************************************************/
+static void bus_write(int skip, const uint8_t* data, uint16_t length) {
+    if (BusOut >= 0) {
+        BusWriteErrors += (write(BusOut, data, length) != length);
+        return;
+    }
+    BusBytes += length;
+    for (int idx = 0; idx < BUS_PLATFORMS; idx++) {
+        if (idx != skip) {
+            BusWriteErrors += (write(Platforms[idx].down, data, length) != length);
+        }
+    }
+}
+
+bool lane_writev(enum CommLane lane, const struct UsartTxSegment* segments, uint8_t count, TickType_t timeout) {
+    for (uint8_t seg = 0; seg < count; seg++) {
+        bus_write(-1, segments[seg].data, segments[seg].length);
+    }
+    return true;
+}
+
+bool lane_write(enum CommLane lane, const uint8_t* data, uint16_t length, TickType_t timeout) {
+    bus_write(-1, data, length);
+    return true;
+}
+
+bool lane_is_alarm(enum SensorId_t sensor, uint16_t value) {
+    return false;
+}
+
+void initialize_lanes(void) {}
+void configure_usart_extern(void) {}
+void configure_usart_hostPC(void) {}
+void initialize_link_rate(void) {}
+void initialize_reliable(void) {}
+void initialize_clock_sync(void) {}
+
+uint16_t read_usart_bytes(enum UsartPort port, uint8_t* data, uint16_t length, TickType_t timeout) {
+    return 0;
+}
+
+uint16_t read_hostPC_bytes(uint8_t* data, uint16_t length, TickType_t timeout) {
+    return 0;
+}
+
+bool reliable_is_active(void) {
+    return false;
+}
+
+void reliable_send_data(enum SensorId_t sensorType, uint16_t data) {
+}
+
+bool clock_timestamps_enabled(void) {
+    return false;
+}
+
+/******************************************************************************
+ * @brief Platform side: answers frames addressed to it. A poll first takes
+ * 0 to 21 readings, sometimes more than the hold buffer keeps, numbered so
+ * the controller can tell their order and which platform took them.
+ ******************************************************************************/
+static void platform_frame(const struct CommMessage* message, void* context) {
+    static uint16_t Counter;
+    uint8_t address = comm_get_address();
+
+    if (message->address != address || message->SensorID != Controller) {
+        return; // Another platform's frame, or one for another address
+    }
+    switch (message->messageId) {
+        case COMM_MSG_DISCOVER:
+            send_discover_message((1u << Turbidity) | ((address & 1) ? (1u << DOLevel) : 0));
+            break;
+        case COMM_MSG_FRAMING:
+            handle_framing_request(message->params);
+            break;
+        case COMM_MSG_POLL:
+            for (int reading = rand() % 22; reading > 0; reading--) {
+                Counter = (Counter + 1) % 1000;
+                send_sensorData_message((Counter & 1) ? Turbidity : DOLevel, address * 1000 + Counter);
+            }
+            bus_handle_poll();
+            break;
+        default:
+            break;
+    }
+}
+
+static void platform_main(const struct BusPlatform* platform) {
+    uint8_t data[256];
+    ssize_t length;
+
+    BusOut = platform->up;
+    srand(platform->address);
+    comm_parser_init(&Parser, USART_PORT_EXTERN);
+    bus_join(platform->address);
+    while ((length = read(platform->down, data, sizeof(data))) > 0) {
+        comm_parse_span(&Parser, data, length, platform_frame, NULL);
+    }
+    _exit(0);
+}
+
+static void start_platforms(void) {
+    for (int idx = 0; idx < BUS_PLATFORMS; idx++) {
+        int down[2], up[2];
+
+        Platforms[idx].address = 1 + (idx * BUS_ADDRESSES) / BUS_PLATFORMS; // Spread out, with gaps
+        if (pipe(down) != 0 || pipe(up) != 0) {
+            abort();
+        }
+        Platforms[idx].pid = fork();
+        if (Platforms[idx].pid == 0) {
+            close(down[1]);
+            close(up[0]);
+            for (int other = 0; other < idx; other++) {
+                close(Platforms[other].down);
+                close(Platforms[other].up);
+            }
+            Platforms[idx].down = down[0];
+            Platforms[idx].up = up[1];
+            platform_main(&Platforms[idx]);
+        }
+        close(down[0]);
+        close(up[1]);
+        Platforms[idx].down = down[1];
+        Platforms[idx].up = up[0];
+    }
+}
+
+static void stop_platforms(void) {
+    for (int idx = 0; idx < BUS_PLATFORMS; idx++) {
+        close(Platforms[idx].down);
+        close(Platforms[idx].up);
+    }
+    for (int idx = 0; idx < BUS_PLATFORMS; idx++) {
+        waitpid(Platforms[idx].pid, NULL, 0);
+    }
+}
+
+/******************************************************************************
+ * @brief Controller side: the next frame heard on the bus, false after
+ * timeout_ms of silence.
+ ******************************************************************************/
+static void controller_frame(const struct CommMessage* message, void* context) {
+    Queue[QueueTail++ % BUS_QUEUE_LENGTH] = *message;
+}
+
+static bool bus_next(struct CommMessage* message, int timeout_ms) {
+    while (QueueHead == QueueTail) {
+        struct pollfd fds[BUS_PLATFORMS];
+        uint8_t data[512];
+
+        for (int idx = 0; idx < BUS_PLATFORMS; idx++) {
+            fds[idx] = (struct pollfd){ .fd = Platforms[idx].up, .events = POLLIN };
+        }
+        if (poll(fds, BUS_PLATFORMS, timeout_ms) <= 0) {
+            return false;
+        }
+        for (int idx = 0; idx < BUS_PLATFORMS; idx++) {
+            ssize_t length;
+
+            if (!(fds[idx].revents & POLLIN) || (length = read(fds[idx].fd, data, sizeof(data))) <= 0) {
+                continue;
+            }
+            bus_write(idx, data, length);
+            comm_parse_span(&Parser, data, length, controller_frame, NULL);
+        }
+    }
+    *message = Queue[QueueHead++ % BUS_QUEUE_LENGTH];
+    return true;
+}
+
+static bool bus_reply(enum CommMessageId id, struct CommMessage* message, int timeout_ms) {
+    while (bus_next(message, timeout_ms)) {
+        if (message->address == comm_get_address() && message->SensorID == Controller && message->messageId == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_discovery(void) {
+    struct CommMessage message;
+    bool IsExpected = true;
+
+    for (uint8_t address = 1; address <= BUS_ADDRESSES; address++) {
+        comm_set_address(address);
+        send_discover_message(0);
+        if (bus_reply(COMM_MSG_DISCOVER, &message, BUS_DISCOVER_MS)) {
+            bus_add_node(address, message.params);
+        }
+    }
+
+    CHECK(bus_node_count() == BUS_PLATFORMS);
+    for (uint8_t idx = 0; idx < bus_node_count() && idx < BUS_PLATFORMS; idx++) {
+        uint8_t address = Platforms[idx].address;
+
+        IsExpected &= bus_node(idx)->address == address;
+        IsExpected &= bus_node(idx)->sensors == ((1u << Turbidity) | ((address & 1) ? (1u << DOLevel) : 0));
+    }
+    CHECK(IsExpected);
+    printf("discovery: %u of %d platforms found on %d addresses\n", bus_node_count(), BUS_PLATFORMS, BUS_ADDRESSES);
+}
+
+/******************************************************************************
+ * @brief Moves every platform, then the controller, to another framing.
+ ******************************************************************************/
+static void switch_framing(enum CommFraming framing) {
+    struct CommMessage message;
+    uint8_t answered = 0;
+
+    for (uint8_t idx = 0; idx < bus_node_count(); idx++) {
+        comm_set_address(bus_node(idx)->address);
+        send_framing_message(framing);
+        answered += bus_reply(COMM_MSG_FRAMING, &message, BUS_WAIT_MS) && message.params == framing;
+    }
+    set_sensor_framing(framing);
+    CHECK(answered == bus_node_count());
+}
+
+static void test_poll_rounds(void) {
+    static uint16_t Last[COMM_ADDRESS_MAX + 1];
+    struct CommMessage message;
+    uint32_t stray = 0, miscounted = 0, misordered = 0, timeouts = 0, dropped = 0, unaccounted = 0;
+
+    for (int half = 0; half < 2; half++) {
+        uint64_t bytes = BusBytes;
+        uint32_t readings = 0;
+
+        if (half == 1) {
+            switch_framing(COMM_FRAMING_BINARY_CRC32);
+            bytes = BusBytes;
+        }
+        for (int round = 0; round < BUS_ROUNDS / 2; round++) {
+            for (uint8_t idx = 0; idx < bus_node_count(); idx++) {
+                struct BusNode* node = bus_node(idx);
+                uint16_t turn = 0, before = Last[node->address] % 1000;
+
+                comm_set_address(node->address);
+                send_poll_message(0);
+                node->polls++;
+                for (;;) {
+                    if (!bus_next(&message, BUS_WAIT_MS)) {
+                        node->timeouts++;
+                        timeouts++;
+                        break;
+                    }
+                    if (message.address != node->address || message.SensorID == None) {
+                        stray++;
+                        continue;
+                    }
+                    if (message.SensorID == Controller && message.messageId == COMM_MSG_POLL) {
+                        // Every reading taken since the last turn was either sent or reported dropped
+                        uint16_t taken = (Last[node->address] % 1000 + 1000 - before) % 1000;
+
+                        miscounted += (BUS_TURN_SENT(message.params) != turn);
+                        unaccounted += (taken != turn + BUS_TURN_DROPPED(message.params));
+                        node->dropped += BUS_TURN_DROPPED(message.params);
+                        dropped += BUS_TURN_DROPPED(message.params);
+                        break;
+                    }
+                    if (message.messageId == COMM_MSG_DATA) {
+                        misordered += (message.params / 1000 != node->address
+                                       || message.params % 1000 == Last[node->address] % 1000);
+                        Last[node->address] = message.params;
+                        turn++;
+                    }
+                }
+                node->readings += turn;
+                readings += turn;
+            }
+        }
+        printf("%-16s %u readings, %.1f bus bytes per reading, poll round of %u platforms %.1f ms at %d baud\n",
+               half == 0 ? "ascii:" : "binary crc-32:", readings, (double)(BusBytes - bytes) / readings,
+               bus_node_count(), (BusBytes - bytes) * 1000.0 * LINK_BYTE_BITS / LINK_BAUD / (BUS_ROUNDS / 2),
+               LINK_BAUD);
+    }
+
+    printf("%u stray frames, %u miscounted turns, %u readings out of order, %u timeouts, %u dropped by full hold buffers\n",
+           stray, miscounted, misordered, timeouts, dropped);
+    CHECK(stray == 0 && miscounted == 0 && misordered == 0 && timeouts == 0);
+    CHECK(dropped > 0 && unaccounted == 0); // Polls take up to 21 readings, more than BUS_HOLD_MAX
+    CHECK(BusWriteErrors == 0);
+}
+
+int main(void) {
+    start_platforms();
+    comm_parser_init(&Parser, USART_PORT_EXTERN);
+    test_discovery();
+    test_poll_rounds();
+    stop_platforms();
+    return host_test_summary("test_bus");
+}
@@ -0,0 +1,141 @@
+/*
+ * test_crc.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Binary.h"
+
+// Cross-checks the CRCs closing binary frames. The host build computes
+// CRC-32 from a lookup table; the target feeds whole words to the STM32 CRC
+// unit and adds the last 0 to 3 bytes bit by bit. Both are compared here with
+// a bitwise reference and with the published check values, and the target
+// split is replayed with a model of the unit over every length.
+
+#define CHECK_BYTES 64
+
+/******************************************************************************
+ * @brief CRC-32/MPEG-2 one bit at a time, the reference for everything else.
+ ******************************************************************************/
+static uint32_t crc32_reference(uint32_t crc, const uint8_t* data, uint16_t length) {
+    for (uint16_t idx = 0; idx < length; idx++) {
+        crc ^= (uint32_t)data[idx] << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/******************************************************************************
+ * @brief What the CRC unit does with one write to its data register: the
+ * word is XORed into the register and shifted through MSB first.
+ ******************************************************************************/
+static uint32_t crc_unit_write(uint32_t crc, uint32_t word) {
+    crc ^= word;
+    for (int bit = 0; bit < 32; bit++) {
+        crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+    }
+    return crc;
+}
+
+/******************************************************************************
+ * @brief crc32_mpeg2() as built for the target: words through the unit, then
+ * the remaining bytes in software.
+ ******************************************************************************/
+static uint32_t crc32_target_model(const uint8_t* data, uint16_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    uint16_t idx = 0;
+
+    for (; idx + 4 <= length; idx += 4) {
+        crc = crc_unit_write(crc, ((uint32_t)data[idx] << 24) | ((uint32_t)data[idx + 1] << 16)
+                                  | ((uint32_t)data[idx + 2] << 8) | data[idx + 3]);
+    }
+    return crc32_reference(crc, &data[idx], length - idx);
+}
+
+static void test_check_values(void) {
+    static const uint8_t Check[] = "123456789";
+
+    CHECK(crc32_mpeg2(Check, 9) == 0x0376E6E7);
+    CHECK(crc32_reference(0xFFFFFFFF, Check, 9) == 0x0376E6E7);
+    CHECK(crc32_target_model(Check, 9) == 0x0376E6E7);
+    CHECK(crc16_ccitt(0xFFFF, Check, 9) == 0x29B1);
+    CHECK(crc32_mpeg2(Check, 0) == 0xFFFFFFFF);
+    CHECK(crc16_ccitt(0xFFFF, Check, 0) == 0xFFFF);
+    CHECK(!crc32_is_hardware());
+}
+
+static void test_every_length(void) {
+    uint8_t data[CHECK_BYTES];
+
+    srand(14);
+    for (int round = 0; round < 200; round++) {
+        for (int idx = 0; idx < CHECK_BYTES; idx++) {
+            data[idx] = (round == 0) ? 0x00 : (round == 1) ? 0xFF : (uint8_t)rand();
+        }
+        for (uint16_t length = 0; length <= CHECK_BYTES; length++) {
+            uint32_t expected = crc32_reference(0xFFFFFFFF, data, length);
+
+            CHECK(crc32_mpeg2(data, length) == expected);
+            CHECK(crc32_target_model(data, length) == expected);
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief The self-test pattern of initialize_binary_framing(), so a change to
+ * it is checked against the reference as well.
+ ******************************************************************************/
+static void test_self_test_pattern(void) {
+    static const uint8_t Pattern[] = {
+        '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x00, 0xFF, 0x5A, 0xA5, 0x80, 0x01
+    };
+
+    for (uint16_t length = 4; length <= sizeof(Pattern); length++) {
+        CHECK(crc32_target_model(Pattern, length) == crc32_reference(0xFFFFFFFF, Pattern, length));
+    }
+}
+
+/******************************************************************************
+ * @brief A frame is only accepted with the CRC the link was negotiated to.
+ ******************************************************************************/
+static void test_negotiated_width(void) {
+    struct CommMessage message = {0}, decoded[BINARY_BATCH_MAX];
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1], copy[BINARY_FRAME_MAX_ENCODED + 1];
+    uint16_t length;
+
+    message.SensorID = Turbidity;
+    message.messageId = COMM_MSG_DATA;
+    message.params = 4321;
+    for (enum BinaryIntegrity sent = BINARY_CRC16; sent <= BINARY_CRC32; sent++) {
+        length = binary_frame_encode(frame, &message, true, sent);
+        for (enum BinaryIntegrity expected = BINARY_CRC16; expected <= BINARY_CRC32; expected++) {
+            memcpy(copy, frame, length);
+            CHECK(binary_frame_decode(copy, length - 1, expected, decoded) == (sent == expected ? 1 : 0));
+        }
+        memcpy(copy, frame, length);
+        CHECK(binary_frame_decode(copy, length - 1, sent, decoded) == 1 && decoded[0].params == 4321);
+
+        // Every single-bit error in the stuffed bytes is caught
+        for (uint16_t bit = 0; bit < (length - 1) * 8; bit++) {
+            memcpy(copy, frame, length);
+            copy[bit / 8] ^= 1 << (bit % 8);
+            CHECK(binary_frame_decode(copy, length - 1, sent, decoded) == 0);
+        }
+    }
+}
+
+int main(void) {
+    test_check_values();
+    test_every_length();
+    test_self_test_pattern();
+    test_negotiated_width();
+    return host_test_summary("test_crc");
+}
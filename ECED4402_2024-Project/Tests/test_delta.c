@@ -0,0 +1,217 @@
+/*
+ * test_delta.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "host_rtos.h"
+#include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Binary.h"
+#include "User/L2/Comm_Delta.h"
+
+// Delta compression of the readings the simulated sensors produce. Each
+// reading goes through delta_encode() and binary_frame_encode() as on the
+// platform, then binary_frame_decode() and delta_decode() as on the
+// controller, and must come out unchanged. Reported per sample: bytes on the
+// wire, the params and timestamp bytes against full values, and the cost of
+// each side in host time and cycles. The last runs damage frames on the way,
+// or drop them on the platform as a full lane does, and check that a delta is
+// never applied to the wrong base.
+
+#define ROUNDS       30000 // Readings per sensor
+#define SAMPLES      (ROUNDS * 3)
+
+struct DeltaRun {
+    double wire_bytes;  // Per sample, COBS, CRC and delimiter included
+    double ratio;       // Params and timestamp bytes, full over sent
+    double encode_ns, decode_ns, encode_cycles, decode_cycles;
+    uint32_t wrong, unresolved, resyncs, dropped;
+};
+
+static struct CommMessage Readings[SAMPLES];
+static uint8_t Frames[SAMPLES][BINARY_FRAME_MAX_ENCODED + 1];
+static uint16_t Lengths[SAMPLES];
+
+/******************************************************************************
+ * @brief The datalink functions Comm_Delta.c calls.
+ ******************************************************************************/
+enum CommFraming get_sensor_framing(void) {
+    return COMM_FRAMING_BINARY;
+}
+
+bool reliable_is_active(void) {
+    return false;
+}
+
+void send_compression_message(uint8_t interval) {
+}
+
+static inline uint64_t cycles_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0; // No cycle counter read on this host; only the times are meaningful
+#endif
+}
+
+/******************************************************************************
+ * @brief Readings shaped like those of the L3 sensor simulations: slow
+ * triangle waves in steps, plus a little noise, in the units they are sent in.
+ ******************************************************************************/
+static void generate_readings(bool HasTimestamp) {
+    double turbidity = 5, dolevel = 6;
+    int microplastic = 300;
+    bool IsTurbidityUp = true, IsMicroplasticUp = true, IsDOLevelUp = true;
+    uint32_t tick;
+
+    srand(18);
+    for (int round = 0; round < ROUNDS; round++) {
+        struct CommMessage* message = &Readings[round * 3];
+
+        tick = round * 1000;
+        turbidity += IsTurbidityUp ? 0.5 : -0.5;
+        IsTurbidityUp = (turbidity >= 55) ? false : (turbidity <= 5) ? true : IsTurbidityUp;
+        microplastic += IsMicroplasticUp ? 20 : -20;
+        IsMicroplasticUp = (microplastic >= 1000) ? false : (microplastic <= 300) ? true : IsMicroplasticUp;
+        dolevel += IsDOLevelUp ? 0.1 : -0.1;
+        IsDOLevelUp = (dolevel >= 9) ? false : (dolevel <= 4) ? true : IsDOLevelUp;
+
+        message[0] = (struct CommMessage){ .SensorID = Turbidity,
+                                           .params = (turbidity + ((rand() % 5) + 1) / 10.0) * 100 };
+        message[1] = (struct CommMessage){ .SensorID = Microplastic, .params = microplastic + rand() % 50 };
+        message[2] = (struct CommMessage){ .SensorID = DOLevel,
+                                           .params = (dolevel + ((rand() % 20) + 1) / 100.0) * 100 };
+        for (int sensor = 0; sensor < 3; sensor++) {
+            message[sensor].messageId = COMM_MSG_DATA;
+            message[sensor].HasTimestamp = HasTimestamp;
+            message[sensor].timestamp = HasTimestamp ? tick + sensor * 3 : 0;
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Sends every reading through both sides. With damage set, about
+ * that fraction of frames have a byte altered on the way; with drop set,
+ * about that fraction are encoded but never sent, as when their lane is full.
+ ******************************************************************************/
+static struct DeltaRun run_delta(uint8_t interval, bool HasTimestamp, double damage, double drop) {
+    struct DeltaRun run = {0};
+    struct DeltaDecoder decoder = {0};
+    struct DeltaStats before, after;
+    struct CommMessage received[BINARY_BATCH_MAX];
+    uint64_t wire_bytes = 0, start_ns, start_cycles;
+
+    generate_readings(HasTimestamp);
+    delta_handle_request(interval);
+    delta_start(interval);
+
+    srand(17);
+    start_ns = host_time_ns();
+    start_cycles = cycles_now();
+    for (int idx = 0; idx < SAMPLES; idx++) {
+        struct CommMessage message = Readings[idx];
+
+        delta_encode(&message);
+        Lengths[idx] = binary_frame_encode(Frames[idx], &message, true, BINARY_CRC16);
+        if (drop > 0 && (double)rand() / RAND_MAX < drop) {
+            delta_frame_lost(message.SensorID);
+            Lengths[idx] = 0;
+            run.dropped++;
+        }
+    }
+    run.encode_cycles = (double)(cycles_now() - start_cycles) / SAMPLES;
+    run.encode_ns = (double)(host_time_ns() - start_ns) / SAMPLES;
+
+    srand(81);
+    for (int idx = 0; idx < SAMPLES; idx++) {
+        wire_bytes += Lengths[idx];
+        if (Lengths[idx] != 0 && damage > 0 && (double)rand() / RAND_MAX < damage) {
+            Frames[idx][rand() % (Lengths[idx] - 1)] ^= 0x10;
+        }
+    }
+
+    get_delta_stats(&before);
+    start_ns = host_time_ns();
+    start_cycles = cycles_now();
+    for (int idx = 0; idx < SAMPLES; idx++) {
+        if (Lengths[idx] == 0) {
+            continue; // Never sent, the controller sees nothing
+        }
+        if (binary_frame_decode(Frames[idx], Lengths[idx] - 1, BINARY_CRC16, received) != 1) {
+            delta_invalidate(&decoder);
+            continue;
+        }
+        if (!delta_decode(&decoder, &received[0])) {
+            continue;
+        }
+        run.wrong += (received[0].SensorID != Readings[idx].SensorID || received[0].params != Readings[idx].params
+                      || received[0].timestamp != Readings[idx].timestamp);
+    }
+    run.decode_cycles = (double)(cycles_now() - start_cycles) / SAMPLES;
+    run.decode_ns = (double)(host_time_ns() - start_ns) / SAMPLES;
+    get_delta_stats(&after);
+
+    run.wire_bytes = (double)wire_bytes / SAMPLES;
+    run.ratio = (double)(after.full_bytes - before.full_bytes) / (after.sent_bytes - before.sent_bytes);
+    run.unresolved = after.unresolved - before.unresolved;
+    run.resyncs = after.resyncs - before.resyncs;
+    return run;
+}
+
+static void test_compression(void) {
+    static const struct { const char* name; uint8_t interval; bool HasTimestamp; } Runs[] = {
+        { "full values", 0, false },
+        { "delta, keyframe 8", DELTA_KEYFRAME_INTERVAL, false },
+        { "delta, keyframe 64", DELTA_KEYFRAME_MAX, false },
+        { "full values +ts", 0, true },
+        { "delta, keyframe 8 +ts", DELTA_KEYFRAME_INTERVAL, true },
+        { "delta, keyframe 64 +ts", DELTA_KEYFRAME_MAX, true },
+    };
+    struct DeltaRun run[6];
+
+    printf("%-24s %10s %7s %9s %9s %9s %9s\n", "", "wire B/smp", "ratio", "enc ns", "enc cyc", "dec ns", "dec cyc");
+    for (int idx = 0; idx < 6; idx++) {
+        run[idx] = run_delta(Runs[idx].interval, Runs[idx].HasTimestamp, 0, 0);
+        printf("%-24s %10.2f %7.2f %9.1f %9.0f %9.1f %9.0f\n", Runs[idx].name, run[idx].wire_bytes, run[idx].ratio,
+               run[idx].encode_ns, run[idx].encode_cycles, run[idx].decode_ns, run[idx].decode_cycles);
+        CHECK(run[idx].wrong == 0 && run[idx].unresolved == 0);
+    }
+
+    CHECK(run[0].ratio == 1.0 && run[3].ratio == 1.0);
+    CHECK(run[1].wire_bytes < run[0].wire_bytes && run[4].wire_bytes < run[3].wire_bytes);
+    CHECK(run[1].ratio > 1.5 && run[4].ratio > 1.5);
+}
+
+static void test_damaged_link(void) {
+    struct DeltaRun run = run_delta(DELTA_KEYFRAME_INTERVAL, true, 0.01, 0);
+
+    printf("1%% of frames damaged: %u resyncs, %u deltas dropped waiting for a keyframe, %u wrong\n",
+           run.resyncs, run.unresolved, run.wrong);
+    CHECK(run.wrong == 0);
+    CHECK(run.resyncs > 0 && run.unresolved > 0);
+}
+
+/******************************************************************************
+ * @brief A dropped frame leaves nothing on the wire to resync on: the next
+ * frame of its sensor must be a keyframe, or its delta lands on the wrong base.
+ ******************************************************************************/
+static void test_dropped_frames(void) {
+    struct DeltaRun run = run_delta(DELTA_KEYFRAME_INTERVAL, true, 0, 0.01);
+
+    printf("1%% of frames dropped: %u dropped, %u deltas dropped waiting for a keyframe, %u wrong\n",
+           run.dropped, run.unresolved, run.wrong);
+    CHECK(run.dropped > 0);
+    CHECK(run.wrong == 0 && run.unresolved == 0 && run.resyncs == 0);
+}
+
+int main(void) {
+    test_compression();
+    test_damaged_link();
+    test_dropped_frames();
+    return host_test_summary("test_delta");
+}
@@ -0,0 +1,321 @@
+/*
+ * test_flow_control.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <string.h>
+
+#include "host_test.h"
+
+// The driver is built into the test so its port table can be reconfigured
+// between runs; everything outside it (DMA, pins, the peer) is simulated here.
+#include "../Core/Src/User/L1/USART_Driver.c"
+
+// A peer streams ASCII bytes into the sensor link at full line rate while the
+// parser only drains 8 bytes every 12 byte times. The receive DMA raises its
+// event at half buffer, full buffer and idle line, as on the target. The peer
+// reacts to RTS or XOFF after PEER_SKID more bytes, like a UART that cannot
+// recall what is already in its FIFO. Without flow control the RX ring
+// overflows; with either kind the same stream arrives complete and in order.
+
+#define PEER_BYTES      6000
+#define PEER_SKID       4  // Bytes a peer still sends after being told to stop
+#define PARSER_PERIOD   12 // Byte times between two parser reads
+#define PARSER_READ     8  // Bytes taken per read
+
+HostPeripheralSlot HostPeripherals[32] __attribute__((aligned(32768)));
+UART_HandleTypeDef huart2 = { .Instance = USART2, .Init = { .BaudRate = 115200 } };
+UART_HandleTypeDef huart6 = { .Instance = USART6, .Init = { .BaudRate = 115200 } };
+
+static uint8_t* DmaRxBuffer;  // Set by HAL_UARTEx_ReceiveToIdle_DMA()
+static uint16_t DmaRxSize;
+static uint16_t DmaRxPos;
+static bool IsTxDmaBusy;
+static uint8_t TxDmaRefusals; // Transmit requests the HAL still has to refuse
+static GPIO_PinState CtsLevel = GPIO_PIN_RESET;
+static bool PeerStopRequest;  // RTS raised or XOFF received, not yet released
+static int PeerSkid;
+
+struct FlowRun {
+    uint32_t received;
+    uint32_t errors;     // Bytes out of order
+    uint32_t byte_times; // Line time until the parser had everything
+    bool IsReleased;     // The peer was let go again once the ring drained
+    struct UsartStats stats;
+};
+
+/******************************************************************************
+ * @brief HAL and LL fakes used by the driver.
+ ******************************************************************************/
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart) {
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    DmaRxBuffer = pData;
+    DmaRxSize = Size;
+    DmaRxPos = 0;
+    huart->RxState = HAL_UART_STATE_READY + 2; // Busy receiving
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size) {
+    if (TxDmaRefusals > 0) {
+        TxDmaRefusals--;
+        return HAL_BUSY;
+    }
+    IsTxDmaBusy = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart) {
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart) {
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (GPIOx == SensorRTS_GPIO_Port && GPIO_Pin == SensorRTS_Pin) {
+        PeerStopRequest = (PinState == GPIO_PIN_SET);
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx == SensorCTS_GPIO_Port && GPIO_Pin == SensorCTS_Pin) ? CtsLevel : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) {
+    return 42000000;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void) {
+    return 84000000;
+}
+
+void HostUsart_Transmit(USART_TypeDef* USARTx, uint8_t Value) {
+    if (USARTx == USART6 && (Value == FLOW_XOFF || Value == FLOW_XON)) {
+        PeerStopRequest = (Value == FLOW_XOFF);
+    }
+}
+
+/******************************************************************************
+ * @brief One byte arriving on the sensor link, stored by the receive DMA.
+ ******************************************************************************/
+static void dma_receive(uint8_t byte) {
+    DmaRxBuffer[DmaRxPos++] = byte;
+    if (DmaRxPos == DmaRxSize / 2 || DmaRxPos == DmaRxSize) {
+        HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    }
+    if (DmaRxPos == DmaRxSize) {
+        DmaRxPos = 0;
+    }
+}
+
+static bool peer_may_send(void) {
+    if (!PeerStopRequest) {
+        PeerSkid = PEER_SKID;
+        return true;
+    }
+    if (PeerSkid > 0) {
+        PeerSkid--;
+        return true;
+    }
+    return false;
+}
+
+static void complete_tx_burst(void) {
+    if (IsTxDmaBusy) {
+        IsTxDmaBusy = false;
+        HAL_UART_TxCpltCallback(&huart6);
+    }
+}
+
+static void reset_link(uint8_t flow) {
+    UsartPortDesc* p = &usart_ports[USART_PORT_EXTERN];
+
+    memset(&p->stats, 0, sizeof(p->stats));
+    memset(&p->tx, 0, sizeof(p->tx));
+    p->IsPeerThrottled = false;
+    p->flow = flow;
+    huart6.RxState = HAL_UART_STATE_READY;
+    USART6->SR = USART_SR_TXE;
+    PeerStopRequest = false;
+    CtsLevel = GPIO_PIN_RESET;
+    IsTxDmaBusy = false;
+    TxDmaRefusals = 0;
+
+    configure_usart_extern();
+}
+
+/******************************************************************************
+ * @brief Streams PEER_BYTES into the link with the given flow control.
+ ******************************************************************************/
+static struct FlowRun run_stream(uint8_t flow) {
+    struct FlowRun run = {0};
+    uint8_t data[PARSER_READ];
+    uint32_t sent = 0;
+    bool WasSending = false;
+
+    reset_link(flow);
+
+    while (run.received + usart_ports[USART_PORT_EXTERN].stats.rx_dropped < PEER_BYTES) {
+        if (sent < PEER_BYTES && peer_may_send()) {
+            dma_receive('A' + sent % 26); // Never an XON or XOFF
+            sent++;
+            WasSending = true;
+        } else if (WasSending) {
+            HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos); // Idle line
+            WasSending = false;
+        }
+        complete_tx_burst();
+
+        if (++run.byte_times % PARSER_PERIOD == 0) {
+            uint16_t count = read_usart_bytes(USART_PORT_EXTERN, data, sizeof(data), 0);
+
+            for (uint16_t idx = 0; idx < count; idx++) {
+                run.errors += (data[idx] != 'A' + (run.received + idx) % 26);
+            }
+            run.received += count;
+        }
+    }
+
+    run.IsReleased = !PeerStopRequest;
+    get_usart_stats(USART_PORT_EXTERN, &run.stats);
+    return run;
+}
+
+static void print_run(const char* name, const struct FlowRun* run) {
+    printf("%-9s received %4u/%u, dropped %4u, throttles %3u, peak level %3u/%u, %u byte times\n",
+           name, run->received, PEER_BYTES, run->stats.rx_dropped, run->stats.rx_throttles,
+           run->stats.rx_peak_level, RX_RING_LENGTH, run->byte_times);
+}
+
+static void test_slow_consumer(void) {
+    struct FlowRun none = run_stream(USART_FLOW_NONE);
+    struct FlowRun rtscts = run_stream(USART_FLOW_RTSCTS);
+    struct FlowRun xonxoff = run_stream(USART_FLOW_XONXOFF);
+
+    print_run("none", &none);
+    print_run("rts/cts", &rtscts);
+    print_run("xon/xoff", &xonxoff);
+
+    CHECK(none.stats.rx_dropped > 0);
+    CHECK(none.stats.rx_throttles == 0);
+
+    CHECK(rtscts.received == PEER_BYTES && rtscts.errors == 0);
+    CHECK(rtscts.stats.rx_dropped == 0 && rtscts.stats.rx_throttles > 0);
+    CHECK(rtscts.stats.rx_peak_level < RX_RING_LENGTH && rtscts.IsReleased);
+
+    CHECK(xonxoff.received == PEER_BYTES && xonxoff.errors == 0);
+    CHECK(xonxoff.stats.rx_dropped == 0 && xonxoff.stats.rx_throttles > 0);
+    CHECK(xonxoff.stats.rx_peak_level < RX_RING_LENGTH && xonxoff.IsReleased);
+}
+
+/******************************************************************************
+ * @brief The other direction: the peer pausing our transmitter.
+ ******************************************************************************/
+static void test_peer_pauses_us(void) {
+    static const uint8_t Stream[] = { 'a', 'b', FLOW_XOFF, 'c', FLOW_XON, 'd' };
+    UsartPortDesc* p = &usart_ports[USART_PORT_EXTERN];
+    uint8_t data[8];
+
+    reset_link(USART_FLOW_RTSCTS);
+    CtsLevel = GPIO_PIN_SET;
+    HAL_GPIO_EXTI_Callback(SensorCTS_Pin);
+    CHECK(p->tx.paused && p->stats.tx_pauses == 1);
+    CtsLevel = GPIO_PIN_RESET;
+    HAL_GPIO_EXTI_Callback(SensorCTS_Pin);
+    CHECK(!p->tx.paused);
+
+    // XON/XOFF act on our transmitter and never reach the parser
+    reset_link(USART_FLOW_XONXOFF);
+    for (uint16_t idx = 0; idx < 3; idx++) {
+        dma_receive(Stream[idx]);
+    }
+    HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    CHECK(p->tx.paused && p->stats.tx_pauses == 1);
+    for (uint16_t idx = 3; idx < sizeof(Stream); idx++) {
+        dma_receive(Stream[idx]);
+    }
+    HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    CHECK(!p->tx.paused);
+    CHECK(read_usart_bytes(USART_PORT_EXTERN, data, sizeof(data), 0) == 4 && memcmp(data, "abcd", 4) == 0);
+}
+
+/******************************************************************************
+ * @brief A burst the HAL refuses stays queued and goes out on the next kick,
+ * and a flush waits for bytes held back while we are paused.
+ ******************************************************************************/
+static void test_tx_flush(void) {
+    UsartPortDesc* p = &usart_ports[USART_PORT_EXTERN];
+
+    reset_link(USART_FLOW_NONE);
+    TxDmaRefusals = 1;
+    CHECK(usart_tx_write(USART_PORT_EXTERN, (const uint8_t*)"hello", 5, 0));
+    CHECK(!p->tx.busy && p->tx.length[p->tx.fill] == 5 && p->stats.tx_refused == 1);
+    CHECK(!usart_tx_flush(USART_PORT_EXTERN, 0) && p->tx.busy); // Kicked again, now on the wire
+    complete_tx_burst();
+    CHECK(usart_tx_flush(USART_PORT_EXTERN, 0));
+
+    reset_link(USART_FLOW_XONXOFF);
+    dma_receive(FLOW_XOFF);
+    HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    CHECK(usart_tx_write(USART_PORT_EXTERN, (const uint8_t*)"abc", 3, 0));
+    CHECK(p->tx.paused && !p->tx.busy && !usart_tx_flush(USART_PORT_EXTERN, 0));
+    dma_receive(FLOW_XON);
+    HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    CHECK(p->tx.busy);
+    complete_tx_burst();
+    CHECK(usart_tx_flush(USART_PORT_EXTERN, 0));
+}
+
+/******************************************************************************
+ * @brief Our XOFF/XON gets out while the peer has paused us: it waits in its
+ * own slot for the data register, never behind the held back DMA buffers.
+ ******************************************************************************/
+static void test_flow_char_while_paused(void) {
+    UsartPortDesc* p = &usart_ports[USART_PORT_EXTERN];
+    uint8_t data[RX_RING_LENGTH];
+
+    reset_link(USART_FLOW_XONXOFF);
+    dma_receive(FLOW_XOFF);
+    HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    CHECK(usart_tx_write(USART_PORT_EXTERN, (const uint8_t*)"abc", 3, 0));
+
+    USART6->SR &= ~USART_SR_TXE; // A byte is still in the data register
+    for (uint32_t idx = 0; idx < USART_RX_HIGH_WATERMARK; idx++) {
+        dma_receive('A');
+    }
+    HAL_UARTEx_RxEventCallback(&huart6, DmaRxPos);
+    CHECK(p->IsPeerThrottled && !PeerStopRequest && p->tx.flow_pending == FLOW_XOFF);
+    CHECK((USART6->CR1 & USART_CR1_TXEIE) && p->tx.length[p->tx.fill] == 3);
+
+    USART6->SR |= USART_SR_TXE;
+    usart_irq_handler(USART_PORT_EXTERN);
+    CHECK(PeerStopRequest && p->tx.flow_pending == 0 && !(USART6->CR1 & USART_CR1_TXEIE));
+
+    read_usart_bytes(USART_PORT_EXTERN, data, sizeof(data), 0);
+    CHECK(!p->IsPeerThrottled && !PeerStopRequest); // XON went straight out
+    CHECK(p->tx.paused && p->tx.length[p->tx.fill] == 3);
+}
+
+int main(void) {
+    configure_usart_hostPC();
+    test_slow_consumer();
+    test_peer_pauses_us();
+    test_tx_flush();
+    test_flow_char_while_paused();
+    return host_test_summary("test_flow_control");
+}
@@ -0,0 +1,194 @@
+/*
+ * test_format.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "User/format.h"
+
+// The formatter in format.c against the sprintf calls it replaced: the same
+// text over the whole input range, then time and stack per call for an ASCII
+// data frame and a controller reading. Built with FORMAT_PROBE_SPRINTF or
+// FORMAT_PROBE_FMT, it is instead the smallest program building a data frame
+// one way; the Makefile links both statically and prints their sizes, the
+// flash cost of each. Time, stack and size are host (x86-64, glibc) figures:
+// they compare the two approaches, the target's newlib numbers differ.
+
+#define SAMPLE_VALUE    1234
+#define SAMPLE_CHECKSUM 0x5A
+
+#if defined(FORMAT_PROBE_SPRINTF) || defined(FORMAT_PROBE_FMT)
+
+int main(int argc, char** argv) {
+    char frame[32];
+    int length;
+
+#ifdef FORMAT_PROBE_SPRINTF
+    length = sprintf(frame, "$TURBD,03,%08u,*,%02x\n", (unsigned)argc, (unsigned)argc);
+#else
+    length = fmt_hex2(fmt_str(fmt_u32_pad8(fmt_str(frame, "$TURBD,03,"), argc), ",*,"), argc) - frame;
+#endif
+    return write(1, frame, length) == length ? 0 : 1;
+}
+
+#else
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "host_rtos.h"
+
+#define BENCH_CALLS  5000000
+#define PROBE_STACK  (64 * 1024)
+#define STACK_PAINT  0xA5
+
+static char Sink[64];
+
+static int frame_sprintf(uint32_t value, uint8_t checksum) {
+    return sprintf(Sink, "$TURBD,03,%08u,*,%02x\n", (unsigned)value, checksum);
+}
+
+static int frame_fmt(uint32_t value, uint8_t checksum) {
+    char* pos = fmt_str(fmt_u32_pad8(fmt_str(Sink, "$TURBD,03,"), value), ",*,");
+
+    return fmt_end(fmt_str(fmt_hex2(pos, checksum), "\n")) - Sink;
+}
+
+static int reading_sprintf(uint32_t value, uint8_t unused) {
+    return sprintf(Sink, "%04.01f\r\n", (float)value / 100.0);
+}
+
+static int reading_fmt(uint32_t value, uint8_t unused) {
+    return fmt_end(fmt_str(fmt_fixed(Sink, value, 2, 1, 2), "\r\n")) - Sink;
+}
+
+static int nothing(uint32_t value, uint8_t unused) {
+    return 0;
+}
+
+struct FormatCase {
+    const char* name;
+    int (*format)(uint32_t value, uint8_t checksum);
+};
+
+static const struct FormatCase Cases[] = {
+    { "data frame, sprintf", frame_sprintf },
+    { "data frame, fmt", frame_fmt },
+    { "reading, sprintf", reading_sprintf },
+    { "reading, fmt", reading_fmt },
+};
+
+/******************************************************************************
+ * @brief Same text as sprintf for every writer, over the values the firmware
+ * formats.
+ ******************************************************************************/
+static void test_matches_sprintf(void) {
+    char expected[64], actual[64];
+    uint32_t mismatches = 0;
+
+    for (uint32_t value = 0; value < 70000; value++) {
+        // A reading ending in 5 is an exact tie only in decimal: sprintf
+        // rounds the nearest binary value, which may lie on either side
+        if (value % 10 != 5) {
+            fmt_end(fmt_fixed(actual, value, 2, 1, 2));
+            sprintf(expected, "%04.01f", (float)value / 100.0);
+            mismatches += strcmp(actual, expected) != 0;
+        }
+
+        fmt_end(fmt_fixed(actual, value, 2, 2, 1));
+        sprintf(expected, "%-4.02f", (float)value / 100.0);
+        mismatches += strcmp(actual, expected) != 0;
+
+        fmt_end(fmt_pad(actual, fmt_u32(actual, value), 4));
+        sprintf(expected, "%-4.0f", (float)value);
+        mismatches += strcmp(actual, expected) != 0;
+
+        fmt_end(fmt_u32_pad8(actual, value * 997));
+        sprintf(expected, "%08u", value * 997 % 100000000);
+        mismatches += strcmp(actual, expected) != 0;
+
+        fmt_end(fmt_u32(actual, value * 61357));
+        sprintf(expected, "%u", value * 61357);
+        mismatches += strcmp(actual, expected) != 0;
+
+        fmt_end(fmt_hex2(actual, value));
+        sprintf(expected, "%02x", value & 0xFF);
+        mismatches += strcmp(actual, expected) != 0;
+    }
+    fmt_end(fmt_fixed(actual, 1215, 2, 1, 2));
+    CHECK(strcmp(actual, "12.2") == 0); // Ties round up
+    fmt_end(fmt_u32(actual, UINT32_MAX));
+    CHECK(strcmp(actual, "4294967295") == 0);
+    CHECK(mismatches == 0);
+
+    frame_fmt(SAMPLE_VALUE, SAMPLE_CHECKSUM);
+    strcpy(actual, Sink);
+    frame_sprintf(SAMPLE_VALUE, SAMPLE_CHECKSUM);
+    CHECK(strcmp(actual, Sink) == 0);
+}
+
+/******************************************************************************
+ * @brief Deepest stack reached by one call: the call runs on a thread whose
+ * stack was painted beforehand, as uxTaskGetStackHighWaterMark() measures a
+ * task on the target.
+ ******************************************************************************/
+static void* stack_probe(void* arg) {
+    const struct FormatCase* probe = arg;
+
+    probe->format(SAMPLE_VALUE, SAMPLE_CHECKSUM);
+    return NULL;
+}
+
+static uint32_t stack_used(const struct FormatCase* probe) {
+    static uint8_t stack[PROBE_STACK] __attribute__((aligned(64)));
+    pthread_attr_t attr;
+    pthread_t thread;
+    uint32_t untouched = 0;
+
+    memset(stack, STACK_PAINT, sizeof(stack));
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    pthread_create(&thread, &attr, stack_probe, (void*)probe);
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+
+    while (untouched < sizeof(stack) && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    return sizeof(stack) - untouched;
+}
+
+static void benchmark_formatters(void) {
+    const struct FormatCase Empty = { "", nothing };
+    uint32_t baseline = stack_used(&Empty);
+    double ns[4];
+
+    printf("%-20s %10s %12s\n", "", "ns/call", "stack bytes");
+    for (int idx = 0; idx < 4; idx++) {
+        uint64_t start = host_time_ns();
+        volatile int length = 0;
+
+        for (uint32_t call = 0; call < BENCH_CALLS; call++) {
+            length += Cases[idx].format(call % 10000, call);
+        }
+        ns[idx] = (double)(host_time_ns() - start) / BENCH_CALLS;
+        printf("%-20s %10.1f %12u\n", Cases[idx].name, ns[idx], stack_used(&Cases[idx]) - baseline);
+    }
+
+    CHECK(ns[1] < ns[0] && ns[3] < ns[2]);
+    CHECK(stack_used(&Cases[1]) < stack_used(&Cases[0]));
+}
+
+int main(void) {
+    test_matches_sprintf();
+    benchmark_formatters();
+    return host_test_summary("test_format");
+}
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * test_reliable.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "host_rtos.h"
+#include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Binary.h"
+#include "User/L2/Comm_Reliable.h"
+
+// Goodput of reliable mode over a lossy link. Both ends of Comm_Reliable.c
+// run in one program: the platform numbers a reading every READING_PERIOD_MS
+// and the controller acknowledges what arrives. Each frame crosses the link
+// after LINK_LATENCY_MS, or is lost with the probability that one of its bits
+// is flipped (the CRC then rejects it) or that the whole frame is dropped.
+// Frame sizes are those of the real binary frames.
+//
+//   ./build/test_reliable               the sweep below, with checks
+//   ./build/test_reliable BER DROP      one run, e.g. 1e-4 0.02
+
+#define READINGS          10000
+#define READING_PERIOD_MS 20
+#define LINK_LATENCY_MS   2
+#define LINK_BYTE_BITS    10  // Start, 8 data, stop
+#define CHANNEL_DEPTH     64  // Frames in flight in one direction, far more than a window
+
+struct InFlight {
+    struct CommMessage message;
+    TickType_t due;
+};
+
+// One direction of the link
+struct Channel {
+    struct InFlight frames[CHANNEL_DEPTH];
+    uint16_t head, count;
+    uint32_t sent, lost;
+};
+
+struct LossyRun {
+    double ber, drop;
+    uint32_t delivered;    // Distinct readings the controller passed on
+    uint32_t delivered_twice;
+    uint32_t data_frames;  // Data frames put on the link, first sends and resends
+    uint32_t ticks;
+    struct ReliableStats stats;
+};
+
+static struct Channel ToController, ToPlatform;
+static bool IsAckedDuringSend; // An ack arrives while a data frame is being sent
+static uint32_t AcksDuringSend;
+static double BitErrorRate, DropRate;
+static uint8_t Delivered[READINGS];
+
+/******************************************************************************
+ * @brief Puts a frame on the link, or loses it.
+ ******************************************************************************/
+static void channel_send(struct Channel* channel, const struct CommMessage* message) {
+    uint8_t frame[BINARY_FRAME_MAX_ENCODED + 1];
+    uint16_t bits = binary_frame_encode(frame, message, true, BINARY_CRC16) * LINK_BYTE_BITS;
+    double survives = pow(1.0 - BitErrorRate, bits) * (1.0 - DropRate);
+    struct InFlight* slot;
+
+    channel->sent++;
+    if ((double)rand() / RAND_MAX >= survives || channel->count == CHANNEL_DEPTH) {
+        channel->lost++;
+        return;
+    }
+    slot = &channel->frames[(channel->head + channel->count++) % CHANNEL_DEPTH];
+    slot->message = *message;
+    slot->due = xTaskGetTickCount() + pdMS_TO_TICKS(LINK_LATENCY_MS);
+}
+
+/******************************************************************************
+ * @brief Takes the next frame that has crossed the link, false if none has.
+ ******************************************************************************/
+static bool channel_receive(struct Channel* channel, struct CommMessage* message) {
+    struct InFlight* slot = &channel->frames[channel->head];
+
+    if (channel->count == 0 || (int32_t)(xTaskGetTickCount() - slot->due) < 0) {
+        return false;
+    }
+    *message = slot->message;
+    channel->head = (channel->head + 1) % CHANNEL_DEPTH;
+    channel->count--;
+    return true;
+}
+
+/******************************************************************************
+ * @brief The datalink functions Comm_Reliable.c sends through.
+ ******************************************************************************/
+enum CommFraming get_sensor_framing(void) {
+    return COMM_FRAMING_BINARY;
+}
+
+void send_reliable_message(uint8_t window) {
+}
+
+void send_sensorDataSeq_message(enum SensorId_t sensorType, uint16_t data, uint8_t seq, uint32_t sample_tick) {
+    const struct CommMessage message = {
+        .SensorID = sensorType, .messageId = COMM_MSG_DATA, .params = data,
+        .seq = seq, .HasSeq = true, .timestamp = sample_tick, .HasTimestamp = true,
+    };
+
+    if (IsAckedDuringSend) {
+        // Takes the window lock; the host kernel aborts if the send still holds it
+        const struct CommMessage ack = { .messageId = COMM_MSG_RELIABLE_ACK, .seq = seq, .HasSeq = true };
+
+        reliable_handle_ack(&ack);
+        AcksDuringSend++;
+    }
+    channel_send(&ToController, &message);
+}
+
+void send_reliableAck_message(uint8_t next_seq, uint16_t received) {
+    const struct CommMessage message = {
+        .SensorID = Controller, .messageId = COMM_MSG_RELIABLE_ACK, .params = received,
+        .seq = next_seq, .HasSeq = true,
+    };
+
+    channel_send(&ToPlatform, &message);
+}
+
+static void stats_delta(struct ReliableStats* delta, const struct ReliableStats* before) {
+    uint32_t* after_field = &delta->sent;
+    const uint32_t* before_field = &before->sent;
+
+    for (; after_field <= &delta->skipped; after_field++, before_field++) {
+        *after_field -= *before_field;
+    }
+}
+
+/******************************************************************************
+ * @brief Streams READINGS readings, then lets the retries run out.
+ ******************************************************************************/
+static struct LossyRun run_lossy(double ber, double drop) {
+    struct LossyRun run = { .ber = ber, .drop = drop };
+    const uint32_t drain_ticks = pdMS_TO_TICKS(RELIABLE_RTO_MS) * (RELIABLE_MAX_RETRIES + 2);
+    struct ReliableStats before;
+    struct CommMessage message;
+    uint32_t offered = 0, idle = 0;
+
+    memset(&ToController, 0, sizeof(ToController));
+    memset(&ToPlatform, 0, sizeof(ToPlatform));
+    memset(Delivered, 0, sizeof(Delivered));
+    BitErrorRate = ber;
+    DropRate = drop;
+    srand(16);
+
+    reliable_handle_request(RELIABLE_WINDOW);
+    reliable_start(RELIABLE_WINDOW);
+    get_reliable_stats(&before);
+
+    while (offered < READINGS || idle < drain_ticks) {
+        if (offered < READINGS && run.ticks % pdMS_TO_TICKS(READING_PERIOD_MS) == 0) {
+            reliable_send_data(Turbidity, offered++);
+        }
+        while (channel_receive(&ToController, &message)) {
+            if (reliable_receive(&message)) {
+                run.delivered_twice += Delivered[message.params];
+                Delivered[message.params] = 1;
+                run.delivered++;
+            }
+        }
+        while (channel_receive(&ToPlatform, &message)) {
+            reliable_handle_ack(&message);
+        }
+        host_advance_ticks(1);
+        run.ticks++;
+        idle = (offered < READINGS) ? 0 : idle + 1;
+    }
+
+    get_reliable_stats(&run.stats);
+    stats_delta(&run.stats, &before);
+    run.data_frames = ToController.sent;
+    return run;
+}
+
+static void print_run(const struct LossyRun* run) {
+    double seconds = (double)run->ticks * portTICK_PERIOD_MS / 1000;
+
+    printf("%8.0e %5.2f %8.2f%% %10.1f %9.2f %6u %6u %7u %5u\n",
+           run->ber, run->drop, 100.0 * run->delivered / READINGS, run->delivered / seconds,
+           (double)run->data_frames / run->delivered, run->stats.retransmits, run->stats.window_full,
+           run->stats.given_up, run->stats.duplicates);
+}
+
+static void print_header(void) {
+    printf("%d readings every %d ms, window %d, RTO %d ms, %d retries\n", READINGS, READING_PERIOD_MS,
+           RELIABLE_WINDOW, RELIABLE_RTO_MS, RELIABLE_MAX_RETRIES);
+    printf("%8s %5s %9s %10s %9s %6s %6s %7s %5s\n", "ber", "drop", "delivered", "readings/s",
+           "tx/frame", "retx", "full", "gaveup", "dups");
+}
+
+static void test_lossy_sweep(void) {
+    static const double Sweep[][2] = {
+        { 0, 0 }, { 1e-5, 0 }, { 1e-4, 0 }, { 1e-3, 0 }, { 0, 0.01 }, { 0, 0.05 }, { 1e-4, 0.02 }, { 3e-3, 0.10 },
+    };
+
+    print_header();
+    for (unsigned idx = 0; idx < sizeof(Sweep) / sizeof(Sweep[0]); idx++) {
+        struct LossyRun run = run_lossy(Sweep[idx][0], Sweep[idx][1]);
+
+        print_run(&run);
+        CHECK(run.delivered_twice == 0);
+        CHECK(run.delivered == run.stats.delivered);
+        if (Sweep[idx][0] == 0 && Sweep[idx][1] == 0) {
+            CHECK(run.delivered == READINGS && run.stats.retransmits == 0 && run.stats.duplicates == 0);
+        } else if (Sweep[idx][0] <= 1e-4 && Sweep[idx][1] <= 0.05) {
+            CHECK(run.delivered == READINGS); // Every loss repaired
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Frames are sent with the window lock released, so a send that waits
+ * for a lane never holds up the ack handler or the timers.
+ ******************************************************************************/
+static void test_send_unlocked(void) {
+    struct CommMessage message;
+
+    reliable_handle_request(RELIABLE_WINDOW);
+    IsAckedDuringSend = true;
+    reliable_send_data(Turbidity, 1);
+    reliable_send_data(Turbidity, 2);
+    host_advance_ticks(pdMS_TO_TICKS(RELIABLE_RTO_MS)); // The retransmit timer resends frame 1
+    IsAckedDuringSend = false;
+    CHECK(AcksDuringSend == 3);
+    while (channel_receive(&ToController, &message)) {
+    }
+    reliable_handle_request(0);
+}
+
+int main(int argc, char** argv) {
+    initialize_reliable();
+
+    if (argc == 3) {
+        struct LossyRun run = run_lossy(atof(argv[1]), atof(argv[2]));
+
+        print_header();
+        print_run(&run);
+        return 0;
+    }
+    test_lossy_sweep();
+    test_send_unlocked();
+    return host_test_summary("test_reliable");
+}
@@ -0,0 +1,247 @@
+/*
+ * test_resync.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "host_rtos.h"
+#include "User/L2/Comm_Datalink.h"
+#include "User/L2/Comm_Lanes.h"
+
+// Parser throughput and recovery on noisy sensor streams. The streams are
+// built by the real datalink, ASCII and binary frames mixed as requested,
+// with bursts of random bytes inserted between frames, then parsed in
+// COMM_PARSER_CHUNK_LENGTH spans as comm_parser_read() hands them over.
+// Reported per stream: parse rate, frames recovered, and the parser's
+// resync, rejected and word-scanned counters. A burst may cost the frame
+// that follows it (its garbage runs into the frame) but never more, and no
+// frame may come out that was not sent.
+
+#define STREAM_BYTES   (8u << 20)
+#define STREAM_SLACK   8192  // Room for the frame and burst that cross STREAM_BYTES
+#define FRAME_WINDOW   64    // Frames a recovered one is looked for among, after the last match
+
+struct SentFrame {
+    uint8_t sensor;
+    uint16_t value;
+};
+
+struct StreamCase {
+    const char* name;
+    double burst_rate;  // Chance of a burst after each frame
+    uint16_t burst_max; // Bytes in a burst, 1 to this many
+    double ascii;       // Fraction of frames sent in ASCII
+};
+
+static uint8_t* Stream;
+static size_t StreamLength;
+static struct SentFrame* Sent;
+static uint32_t SentCount, Bursts;
+static uint32_t Matched, Unmatched, Cursor; // Recovered frames found among those sent, and not found
+
+/******************************************************************************
+ * @brief The lanes and drivers the datalink sends through: frames are
+ * appended to the stream.
+ ******************************************************************************/
+bool lane_writev(enum CommLane lane, const struct UsartTxSegment* segments, uint8_t count, TickType_t timeout) {
+    for (uint8_t seg = 0; seg < count; seg++) {
+        memcpy(&Stream[StreamLength], segments[seg].data, segments[seg].length);
+        StreamLength += segments[seg].length;
+    }
+    return true;
+}
+
+bool lane_write(enum CommLane lane, const uint8_t* data, uint16_t length, TickType_t timeout) {
+    const struct UsartTxSegment segment = { data, length };
+
+    return lane_writev(lane, &segment, 1, timeout);
+}
+
+bool lane_is_alarm(enum SensorId_t sensor, uint16_t value) {
+    return false;
+}
+
+void initialize_lanes(void) {}
+void configure_usart_extern(void) {}
+void configure_usart_hostPC(void) {}
+void initialize_link_rate(void) {}
+void initialize_reliable(void) {}
+void initialize_clock_sync(void) {}
+
+uint16_t read_usart_bytes(enum UsartPort port, uint8_t* data, uint16_t length, TickType_t timeout) {
+    return 0;
+}
+
+uint16_t read_hostPC_bytes(uint8_t* data, uint16_t length, TickType_t timeout) {
+    return 0;
+}
+
+bool reliable_is_active(void) {
+    return false;
+}
+
+void reliable_send_data(enum SensorId_t sensorType, uint16_t data) {
+}
+
+bool clock_timestamps_enabled(void) {
+    return false;
+}
+
+static void build_stream(const struct StreamCase* stream, unsigned seed) {
+    srand(seed);
+    StreamLength = 0;
+    SentCount = 0;
+    Bursts = 0;
+
+    while (StreamLength < STREAM_BYTES) {
+        struct SentFrame* frame = &Sent[SentCount++];
+
+        frame->sensor = Turbidity + rand() % 3;
+        frame->value = rand() % 3000;
+        set_sensor_framing((double)rand() / RAND_MAX < stream->ascii ? COMM_FRAMING_ASCII : COMM_FRAMING_BINARY);
+        send_sensorData_message(frame->sensor, frame->value);
+
+        if (stream->burst_rate > 0 && (double)rand() / RAND_MAX < stream->burst_rate) {
+            for (int count = 1 + rand() % stream->burst_max; count > 0; count--) {
+                Stream[StreamLength++] = rand();
+            }
+            Bursts++;
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Matches each recovered frame with one sent: the first among the next
+ * FRAME_WINDOW that has the same sensor and value.
+ ******************************************************************************/
+static void recovered_frame(const struct CommMessage* message, void* context) {
+    for (uint32_t idx = Cursor; idx < SentCount && idx < Cursor + FRAME_WINDOW; idx++) {
+        if (message->messageId == COMM_MSG_DATA && message->SensorID == Sent[idx].sensor
+            && message->params == Sent[idx].value) {
+            Cursor = idx + 1;
+            Matched++;
+            return;
+        }
+    }
+    Unmatched++;
+}
+
+static void test_streams(void) {
+    static const struct StreamCase Streams[] = {
+        { "clean binary", 0, 0, 0 },
+        { "clean ascii", 0, 0, 1 },
+        { "mixed, 1% bursts <= 64", 0.01, 64, 0.5 },
+        { "binary, 20% bursts <= 256", 0.2, 256, 0 },
+        { "ascii, 20% bursts <= 256", 0.2, 256, 1 },
+    };
+    static struct CommParser parser;
+
+    printf("%-26s %8s %9s %8s %9s %8s %8s\n", "", "MB/s", "recovered", "bursts", "resyncs", "rejected", "scanned");
+    for (unsigned idx = 0; idx < sizeof(Streams) / sizeof(Streams[0]); idx++) {
+        struct CommParserStats stats;
+        uint64_t start;
+        double seconds;
+
+        build_stream(&Streams[idx], idx);
+        set_sensor_framing(COMM_FRAMING_BINARY); // The receiving side of a binary link, ASCII is still accepted
+        comm_parser_init(&parser, USART_PORT_EXTERN);
+        Matched = Unmatched = Cursor = 0;
+
+        start = host_time_ns();
+        for (size_t pos = 0; pos < StreamLength; pos += COMM_PARSER_CHUNK_LENGTH) {
+            size_t length = StreamLength - pos;
+
+            comm_parse_span(&parser, &Stream[pos], length < COMM_PARSER_CHUNK_LENGTH ? length : COMM_PARSER_CHUNK_LENGTH,
+                            recovered_frame, NULL);
+        }
+        seconds = (host_time_ns() - start) / 1e9;
+        comm_parser_stats(&parser, &stats);
+
+        printf("%-26s %8.1f %8.2f%% %8u %9u %8u %7.1f%%\n", Streams[idx].name, StreamLength / seconds / 1e6,
+               100.0 * Matched / SentCount, Bursts, stats.resyncs, stats.rejected,
+               100.0 * stats.scanned / StreamLength);
+        CHECK(Unmatched == 0);
+        CHECK(Matched + Bursts >= SentCount); // At most the frame after each burst is lost
+        if (Bursts == 0) {
+            // A '$' in binary payload is counted as rejected by the ASCII machine, never as a lost frame
+            CHECK(Matched == SentCount && stats.resyncs == 0);
+            CHECK(Streams[idx].ascii < 1 || stats.rejected == 0);
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Nothing but random bytes, as when the controller starts listening on
+ * a line carrying something else. Frames found here are noise that passed
+ * every check, so they are reported rather than expected to be none.
+ ******************************************************************************/
+static void benchmark_noise(void) {
+    static struct CommParser parser;
+    struct CommParserStats stats;
+    uint64_t start;
+    uint32_t frames;
+
+    srand(23);
+    for (size_t pos = 0; pos < STREAM_BYTES; pos++) {
+        Stream[pos] = rand();
+    }
+    comm_parser_init(&parser, USART_PORT_EXTERN);
+    Matched = Unmatched = Cursor = 0;
+    SentCount = 0;
+
+    start = host_time_ns();
+    for (size_t pos = 0; pos < STREAM_BYTES; pos += COMM_PARSER_CHUNK_LENGTH) {
+        comm_parse_span(&parser, &Stream[pos], COMM_PARSER_CHUNK_LENGTH, recovered_frame, NULL);
+    }
+    frames = Unmatched;
+    comm_parser_stats(&parser, &stats);
+    printf("%-26s %8.1f %8u frames found, %u rejected, %.1f%% scanned\n", "pure noise",
+           STREAM_BYTES / ((host_time_ns() - start) / 1e9) / 1e6, frames, stats.rejected,
+           100.0 * stats.scanned / STREAM_BYTES);
+}
+
+/******************************************************************************
+ * @brief Each link has its own framing: a binary frame is only accepted by a
+ * parser whose link negotiated that framing, CRC included.
+ ******************************************************************************/
+static uint32_t parse_on(enum UsartPort port) {
+    static struct CommParser parser;
+
+    comm_parser_init(&parser, port);
+    Matched = Unmatched = Cursor = 0;
+    comm_parse_span(&parser, Stream, StreamLength, recovered_frame, NULL);
+    return Matched;
+}
+
+static void test_link_framing(void) {
+    StreamLength = 0;
+    SentCount = 1;
+    Sent[0] = (struct SentFrame){ Turbidity, 1234 };
+    set_sensor_framing(COMM_FRAMING_BINARY);
+    send_sensorData_message(Turbidity, 1234);
+
+    comm_set_link_framing(USART_PORT_HOSTPC, COMM_FRAMING_ASCII);
+    CHECK(parse_on(USART_PORT_EXTERN) == 1 && parse_on(USART_PORT_HOSTPC) == 0);
+    comm_set_link_framing(USART_PORT_HOSTPC, COMM_FRAMING_BINARY_CRC32);
+    CHECK(parse_on(USART_PORT_HOSTPC) == 0 && get_sensor_framing() == COMM_FRAMING_BINARY);
+    comm_set_link_framing(USART_PORT_HOSTPC, COMM_FRAMING_BINARY);
+    CHECK(parse_on(USART_PORT_HOSTPC) == 1);
+    comm_set_link_framing(USART_PORT_HOSTPC, COMM_FRAMING_ASCII);
+}
+
+int main(void) {
+    Stream = malloc(STREAM_BYTES + STREAM_SLACK);
+    Sent = malloc(sizeof(struct SentFrame) * STREAM_BYTES / BINARY_FRAME_MIN_RAW);
+    if (Stream == NULL || Sent == NULL) {
+        return 1;
+    }
+    test_link_framing();
+    test_streams();
+    benchmark_noise();
+    return host_test_summary("test_resync");
+}
@@ -0,0 +1,127 @@
+/*
+ * test_ring_buffer.c
+ *
+ *  Created on: Dec. 2, 2024
+ *      Author: Nnaemeka Nnadede & Temitope Onafalujo
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "host_rtos.h"
+#include "User/L1/Ring_Buffer.h"
+
+// The receive ring between the UART ISRs and the parser tasks. After a few
+// single-threaded checks of wrap-around and a full ring, a producer thread
+// plays the ISR and a consumer thread the parser task: the producer writes a
+// counting byte sequence in odd-sized pieces, retrying what did not fit, and
+// the consumer checks every byte arrives once and in order, mixing copying
+// reads with zero-copy spans and sleeping in ring_wait() whenever it is empty.
+
+#define STRESS_RING_SIZE 64
+#define STRESS_BYTES     20000000U
+
+static RingBuffer StressRing;
+static uint8_t StressStorage[STRESS_RING_SIZE];
+static uint32_t ProducerStalls; // Writes that found the ring full
+
+static void test_wrap_and_full(void) {
+    static uint8_t storage[16];
+    uint8_t data[16], out[16];
+    const uint8_t* span;
+    RingBuffer ring;
+
+    for (int idx = 0; idx < 16; idx++) {
+        data[idx] = idx + 1;
+    }
+    ring_init(&ring, storage, sizeof(storage));
+    CHECK(ring_count(&ring) == 0);
+    CHECK(ring_read_span(&ring, &span) == 0);
+
+    CHECK(ring_write_ISR(&ring, data, 10, NULL) == 10);
+    CHECK(ring_read(&ring, out, 6) == 6 && out[0] == 1 && out[5] == 6);
+
+    // 12 more bytes: 6 to the end of storage, 6 wrapped to the start
+    CHECK(ring_write_ISR(&ring, data, 12, NULL) == 12);
+    CHECK(ring_count(&ring) == 16);
+    CHECK(ring_write_ISR(&ring, data, 1, NULL) == 0); // Full
+    CHECK(ring_read_span(&ring, &span) == 10 && span[0] == 7);
+    ring_consume(&ring, 10);
+    CHECK(ring_read_span(&ring, &span) == 6 && span[0] == 7 && span[5] == 12);
+    CHECK(ring_read(&ring, out, 16) == 6 && out[5] == 12);
+    CHECK(ring_count(&ring) == 0);
+
+    // A write larger than the free space is cut short
+    CHECK(ring_write_ISR(&ring, data, 16, NULL) == 16);
+    ring_read(&ring, out, 4);
+    CHECK(ring_write_ISR(&ring, data, 8, NULL) == 4);
+}
+
+static void* stress_producer(void* arg) {
+    uint8_t piece[7];
+    uint32_t sent = 0;
+
+    while (sent < STRESS_BYTES) {
+        uint16_t length = (sent % 7) + 1, written;
+
+        if (length > STRESS_BYTES - sent) {
+            length = STRESS_BYTES - sent;
+        }
+        for (uint16_t idx = 0; idx < length; idx++) {
+            piece[idx] = (uint8_t)(sent + idx);
+        }
+        written = ring_write_ISR(&StressRing, piece, length, NULL);
+        if (written < length) {
+            ProducerStalls++;
+            sched_yield(); // A UART would drop the rest; the test waits instead
+        }
+        sent += written;
+    }
+    return NULL;
+}
+
+static void test_stress(void) {
+    uint8_t out[13];
+    const uint8_t* span;
+    uint32_t received = 0, errors = 0;
+    uint64_t start = host_time_ns(), elapsed;
+    pthread_t producer;
+
+    ring_init(&StressRing, StressStorage, sizeof(StressStorage));
+    pthread_create(&producer, NULL, stress_producer, NULL);
+
+    while (received < STRESS_BYTES) {
+        uint16_t count;
+
+        ring_wait(&StressRing, portMAX_DELAY);
+        if (received & 1) {
+            count = ring_read(&StressRing, out, (received % 13) + 1);
+            for (uint16_t idx = 0; idx < count; idx++) {
+                errors += (out[idx] != (uint8_t)(received + idx));
+            }
+        } else {
+            count = ring_read_span(&StressRing, &span);
+            for (uint16_t idx = 0; idx < count; idx++) {
+                errors += (span[idx] != (uint8_t)(received + idx));
+            }
+            ring_consume(&StressRing, count);
+        }
+        received += count;
+    }
+    pthread_join(producer, NULL);
+    elapsed = host_time_ns() - start;
+
+    CHECK(errors == 0);
+    CHECK(received == STRESS_BYTES);
+    CHECK(ring_count(&StressRing) == 0);
+    printf("stress: %u bytes in order, %.1f MB/s, %u wake-ups, %u producer stalls\n",
+           received, received * 1000.0 / elapsed, host_notifications(), ProducerStalls);
+}
+
+int main(void) {
+    test_wrap_and_full();
+    test_stress();
+    return host_test_summary("test_ring_buffer");
+}